@@ -1,8 +1,10 @@
 #pragma once
 
 #include "huffman/src/bit.hpp"
+#include "huffman/src/bit_reader.hpp"
 #include "huffman/src/bit_span.hpp"
 #include "huffman/src/code.hpp"
 #include "huffman/src/decode.hpp"
+#include "huffman/src/decode_table.hpp"
 #include "huffman/src/encoding.hpp"
 #include "huffman/src/table.hpp"
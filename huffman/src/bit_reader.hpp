@@ -0,0 +1,306 @@
+#pragma once
+#include "huffman/src/bit_span.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+namespace starflate::huffman {
+
+/// A bit stream reader that buffers up to 64 bits at a time.
+///
+/// Bits are kept in an integer accumulator that is refilled with unaligned
+/// word loads, so reading a bit field is a shift and a mask instead of a loop
+/// over individual bits.
+///
+/// Once the input is exhausted, refilling appends zero bits. Consuming these
+/// padding bits is not an error at the point it happens; instead `overrun()`
+/// reports it, allowing callers to validate input once per block instead of
+/// once per bit field.
+///
+class bit_reader
+{
+  const std::byte* next_{nullptr};
+  const std::byte* end_{nullptr};
+  std::uint64_t buffer_{};
+  std::size_t padding_{};       // zero bytes appended past the end of input
+  std::uint8_t bit_count_{};    // number of bits in buffer_
+  std::uint8_t end_padding_{};  // bits of the last byte not part of the input
+
+  [[nodiscard]]
+  static auto load_le64(const std::byte* data) -> std::uint64_t
+  {
+    std::uint64_t word{};
+    std::memcpy(&word, data, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big) {
+      word = std::byteswap(word);
+    }
+    return word;
+  }
+
+  /// Signed number of bits remaining, negative if overrun
+  [[nodiscard]]
+  constexpr auto remaining() const -> std::ptrdiff_t
+  {
+    return std::ptrdiff_t{bit_count_} + ((end_ - next_) * CHAR_BIT) -
+           (static_cast<std::ptrdiff_t>(padding_) * CHAR_BIT) -
+           std::ptrdiff_t{end_padding_};
+  }
+
+public:
+  /// Maximum number of bits that can be peeked or popped at once
+  ///
+  static constexpr std::uint8_t max_bits = 56;
+
+  /// Constructs an empty bit_reader
+  ///
+  bit_reader() = default;
+
+  /// Constructs a bit_reader from the given data.
+  ///
+  /// @param data a pointer to the first byte of the data.
+  /// @param bit_size the number of bits in the data.
+  /// @param bit_offset bit offset of data, allowing a non-byte aligned range
+  ///
+  /// @pre offset < CHAR_BIT
+  ///
+  // NOLINTBEGIN(bugprone-easily-swappable-parameters)
+  constexpr bit_reader(
+      const std::byte* data, std::size_t bit_size, std::uint8_t bit_offset = {})
+      // NOLINTEND(bugprone-easily-swappable-parameters)
+      : next_{data},
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        end_{data + ((bit_offset + bit_size + CHAR_BIT - 1) / CHAR_BIT)},
+        end_padding_{static_cast<std::uint8_t>(
+            (CHAR_BIT - ((bit_offset + bit_size) % CHAR_BIT)) % CHAR_BIT)}
+  {
+    assert(
+        bit_offset < CHAR_BIT and
+        "bit offset exceeds number of bits in a "
+        "byte");
+    if (bit_offset != 0) {
+      refill();
+      consume(bit_offset);
+    }
+  }
+
+  /// Constructs a bit_reader over the bits of a bit_span
+  ///
+  constexpr explicit bit_reader(const bit_span& bits)
+      : bit_reader{bits.data_, bits.bit_size_, bits.bit_offset_}
+  {}
+
+  /// Fills the buffer so that at least `max_bits` bits are available
+  ///
+  /// If the input is exhausted, zero bits are appended.
+  ///
+  constexpr auto refill() -> void
+  {
+    if (not std::is_constant_evaluated() and
+        end_ - next_ >= std::ptrdiff_t{sizeof(buffer_)}) {
+      buffer_ |= load_le64(next_) << bit_count_;
+      // the partially loaded byte is loaded again on the next refill
+      std::advance(next_, (63U - bit_count_) / CHAR_BIT);
+      bit_count_ |= max_bits;
+      return;
+    }
+
+    while (bit_count_ < max_bits) {
+      if (next_ != end_) {
+        buffer_ |= std::to_integer<std::uint64_t>(*next_) << bit_count_;
+        std::advance(next_, 1);
+      } else {
+        ++padding_;
+      }
+      bit_count_ += CHAR_BIT;
+    }
+  }
+
+  /// Returns the number of bits in the buffer
+  ///
+  [[nodiscard]]
+  constexpr auto buffered() const -> std::uint8_t
+  {
+    return bit_count_;
+  }
+
+  /// Returns the next n buffered bits without consuming them
+  ///
+  /// The first bit is in the least significant position of the result.
+  ///
+  /// @pre n <= buffered()
+  ///
+  [[nodiscard]]
+  constexpr auto peek(std::uint8_t n) const -> std::uint64_t
+  {
+    assert(n <= bit_count_ and "bit_reader must be refilled before peek");
+    return buffer_ & ((std::uint64_t{1} << n) - 1U);
+  }
+
+  /// Consumes n buffered bits
+  ///
+  /// @pre n <= buffered()
+  ///
+  constexpr auto consume(std::uint8_t n) -> void
+  {
+    assert(n <= bit_count_ and "bit_reader must be refilled before consume");
+    buffer_ >>= n;
+    bit_count_ -= n;
+  }
+
+  /// Removes n bits from the stream and returns them
+  ///
+  /// Refills the buffer if it contains fewer than n bits.
+  ///
+  /// @pre n <= max_bits
+  ///
+  constexpr auto pop(std::uint8_t n) -> std::uint64_t
+  {
+    assert(n <= max_bits);
+    if (bit_count_ < n) {
+      refill();
+    }
+    const auto bits = peek(n);
+    consume(n);
+    return bits;
+  }
+
+  /// Consumes bits until the start is aligned to a byte boundary.
+  ///
+  constexpr auto consume_to_byte_boundary() -> void
+  {
+    consume(bit_count_ % CHAR_BIT);
+  }
+
+  /// Returns whole buffered bytes to the input
+  ///
+  /// Afterwards, fewer than CHAR_BIT bits are buffered: the unconsumed bits of
+  /// a partially consumed byte. Bytes starting at `next_byte()` are unread.
+  ///
+  /// @pre not overrun()
+  /// @pre the input ends on a byte boundary
+  ///
+  constexpr auto unbuffer() -> void
+  {
+    assert(not overrun());
+    assert(end_padding_ == 0 and "input must end on a byte boundary");
+
+    const auto real = std::min(std::ptrdiff_t{bit_count_}, remaining());
+    std::advance(next_, -(real / CHAR_BIT));
+    bit_count_ = static_cast<std::uint8_t>(real % CHAR_BIT);
+    buffer_ &= (std::uint64_t{1} << bit_count_) - 1U;
+    padding_ = 0;
+  }
+
+  /// Replaces the input, keeping buffered bits
+  ///
+  /// Bits buffered from the previous input are read first, followed by the
+  /// bits of `data`. Bytes of the previous input that have not been buffered
+  /// are dropped.
+  ///
+  /// @pre not overrun()
+  /// @pre the previous input ends on a byte boundary
+  ///
+  constexpr auto set_input(const std::byte* data, std::size_t size) -> void
+  {
+    assert(not overrun());
+    assert(end_padding_ == 0 and "input must end on a byte boundary");
+
+    // drop zero bits appended past the end of the previous input, and any
+    // bits of a partially loaded byte
+    bit_count_ = static_cast<std::uint8_t>(
+        std::min(std::ptrdiff_t{bit_count_}, remaining()));
+    buffer_ &= (std::uint64_t{1} << bit_count_) - 1U;
+    padding_ = 0;
+
+    next_ = data;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    end_ = data + size;
+  }
+
+  /// Returns a pointer to the next byte that has not been buffered
+  ///
+  [[nodiscard]]
+  constexpr auto next_byte() const -> const std::byte*
+  {
+    return next_;
+  }
+
+  /// Returns the number of bytes of input that have not been buffered
+  ///
+  /// If at least `sizeof(std::uint64_t)` bytes remain, `refill` buffers at
+  /// least `max_bits` bits of input without appending zero bits.
+  ///
+  [[nodiscard]]
+  constexpr auto unbuffered_bytes() const -> std::size_t
+  {
+    return static_cast<std::size_t>(end_ - next_);
+  }
+
+  /// Skips n bytes of unbuffered input
+  ///
+  /// @pre buffered() == 0
+  /// @pre n <= size() / CHAR_BIT
+  ///
+  constexpr auto skip_bytes(std::size_t n) -> void
+  {
+    assert(bit_count_ == 0 and "bit_reader must not buffer bits to skip bytes");
+    assert(n <= size() / CHAR_BIT);
+    std::advance(next_, n);
+  }
+
+  /// Returns the number of bits remaining in the input
+  ///
+  [[nodiscard]]
+  constexpr auto size() const -> std::size_t
+  {
+    const auto n = remaining();
+    return n < 0 ? std::size_t{} : static_cast<std::size_t>(n);
+  }
+
+  /// Returns `true` if no bits remain in the input
+  ///
+  [[nodiscard]]
+  constexpr auto empty() const -> bool
+  {
+    return remaining() <= 0;
+  }
+
+  /// Returns `true` if more bits were consumed than the input contains
+  ///
+  [[nodiscard]]
+  constexpr auto overrun() const -> bool
+  {
+    return remaining() < 0;
+  }
+
+  /// Returns the remaining input as a `bit_span`
+  ///
+  /// @pre not overrun()
+  ///
+  [[nodiscard]]
+  constexpr auto bits() const -> bit_span
+  {
+    assert(not overrun());
+
+    // bits between the start of the stream and next_
+    const auto behind = std::ptrdiff_t{bit_count_} -
+                        (static_cast<std::ptrdiff_t>(padding_) * CHAR_BIT);
+    const auto behind_bytes = (behind + CHAR_BIT - 1) / CHAR_BIT;
+    const auto offset = (behind_bytes * CHAR_BIT) - behind;
+
+    return {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        next_ - behind_bytes,
+        size(),
+        static_cast<std::uint8_t>(offset)};
+  }
+};
+
+}  // namespace starflate::huffman
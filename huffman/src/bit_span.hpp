@@ -2,6 +2,7 @@
 #include "huffman/src/bit.hpp"
 #include "huffman/src/detail/iterator_interface.hpp"
 
+#include <algorithm>
 #include <bit>
 #include <bitset>
 #include <cassert>
@@ -14,9 +15,14 @@
 #include <ranges>
 
 namespace starflate::huffman {
+
+class bit_reader;
+
 /// A non-owning span of bits. Allows for iteration over the individual bits.
 class bit_span : public std::ranges::view_interface<bit_span>
 {
+  friend class bit_reader;
+
   const std::byte* data_{nullptr};
   std::size_t bit_size_{};
   std::uint8_t bit_offset_{};  // always less than CHAR_BIT
@@ -138,6 +144,31 @@ public:
     return res;
   }
 
+  /// Returns the next n bits without consuming them.
+  ///
+  /// The first bit is in the least significant position of the result. If
+  /// fewer than n bits remain, the missing high bits are zero.
+  ///
+  /// @pre n <= 56
+  ///
+  [[nodiscard]]
+  constexpr auto peek(std::uint8_t n) const -> std::uint64_t
+  {
+    assert(n <= 56 and "bit_span can peek at most 56 bits");
+
+    const auto n_bits = std::min(std::size_t{n}, bit_size_);
+    const auto n_bytes = (bit_offset_ + n_bits + CHAR_BIT - 1) / CHAR_BIT;
+
+    auto res = std::uint64_t{};
+    for (auto i = std::size_t{}; i != n_bytes; ++i) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      res |= std::to_integer<std::uint64_t>(data_[i]) << (i * CHAR_BIT);
+    }
+    res >>= bit_offset_;
+
+    return res & ((std::uint64_t{1} << n_bits) - 1U);
+  }
+
   constexpr auto pop_8() -> std::uint8_t { return pop<std::uint8_t>(); }
 
   constexpr auto pop_16() -> std::uint16_t { return pop<std::uint16_t>(); }
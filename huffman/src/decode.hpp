@@ -1,6 +1,8 @@
 #pragma once
+#include "huffman/src/bit_reader.hpp"
 #include "huffman/src/bit_span.hpp"
 #include "huffman/src/code.hpp"
+#include "huffman/src/decode_table.hpp"
 #include "huffman/src/table.hpp"
 #include "huffman/src/utility.hpp"
 
@@ -36,6 +38,34 @@ decode(const table<Symbol, Extent>& code_table, bit_span bits, O output) -> O
   return output;
 }
 
+/// Decodes a bit stream using a decode table.
+///
+/// If a code from \p bits is not found in \p code_table, the
+/// decoding returns immediately without reading remaining \p bits.
+///
+/// @param code_table The decode table to use for decoding.
+/// @param bits The bit stream to decode.
+/// @param output The output iterator to write the decoded symbols to.
+///
+/// @returns The output iterator after writing the decoded symbols.
+template <symbol Symbol, std::size_t Capacity, std::output_iterator<Symbol> O>
+constexpr auto decode(
+    const decode_table<Symbol, Capacity>& code_table,
+    bit_span bits,
+    O output) -> O
+{
+  while (!bits.empty()) {
+    auto result = decode_one(code_table, bits);
+    if (not result.has_value()) {
+      break;
+    }
+    *output = result.symbol();
+    output++;
+    bits.consume(result.encoded_size());
+  }
+  return output;
+}
+
 template <symbol Symbol>
 class decode_result
 {
@@ -101,4 +131,68 @@ decode_one(const table<Symbol, Extent>& code_table, bit_span bits)
   return {Symbol{}, decode_result<Symbol>::kInvalidEncodedSize};
 }
 
+/// Decodes a single symbol from \p bits using \p code_table.
+///
+/// Looks up the next `code_table.max_bitsize()` bits of \p bits, requiring
+/// one table load for codes no longer than `code_table.primary_bitsize()` and
+/// two table loads otherwise.
+///
+/// @param code_table The decode table to use for decoding.
+/// @param bits The bit stream to decode.
+///
+/// @returns The decoded symbol and how many bits its code was.
+///          If no symbol was found, result.encoded_size == 0.
+/// @tparam Symbol The type of the symbols in the decode table.
+/// @tparam Capacity The capacity of the decode table.
+template <symbol Symbol, std::size_t Capacity>
+constexpr auto
+decode_one(const decode_table<Symbol, Capacity>& code_table, bit_span bits)
+    -> decode_result<Symbol>
+{
+  if (code_table.empty()) {
+    return {Symbol{}, decode_result<Symbol>::kInvalidEncodedSize};
+  }
+
+  const auto& entry = code_table.find(bits.peek(code_table.max_bitsize()));
+
+  if (entry.bitsize > std::ranges::size(bits)) {
+    return {Symbol{}, decode_result<Symbol>::kInvalidEncodedSize};
+  }
+  return {entry.symbol, entry.bitsize};
+}
+
+/// Decodes a single symbol from \p bits using \p code_table.
+///
+/// Refills \p bits if it buffers fewer than `code_table.max_bitsize()` bits,
+/// then looks up the buffered bits. Does not consume the decoded code.
+///
+/// @param code_table The decode table to use for decoding.
+/// @param bits The bit stream to decode.
+///
+/// @returns The decoded symbol and how many bits its code was.
+///          If no symbol was found, result.encoded_size == 0.
+/// @tparam Symbol The type of the symbols in the decode table.
+/// @tparam Capacity The capacity of the decode table.
+template <symbol Symbol, std::size_t Capacity>
+constexpr auto
+decode_one(const decode_table<Symbol, Capacity>& code_table, bit_reader& bits)
+    -> decode_result<Symbol>
+{
+  assert(code_table.max_bitsize() <= bit_reader::max_bits);
+
+  if (code_table.empty()) {
+    return {Symbol{}, decode_result<Symbol>::kInvalidEncodedSize};
+  }
+  if (bits.buffered() < code_table.max_bitsize()) {
+    bits.refill();
+  }
+
+  const auto& entry = code_table.find(bits.peek(code_table.max_bitsize()));
+
+  if (entry.bitsize > bits.size()) {
+    return {Symbol{}, decode_result<Symbol>::kInvalidEncodedSize};
+  }
+  return {entry.symbol, entry.bitsize};
+}
+
 }  // namespace starflate::huffman
@@ -0,0 +1,363 @@
+#pragma once
+
+#include "huffman/src/detail/static_vector.hpp"
+#include "huffman/src/table.hpp"
+#include "huffman/src/utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace starflate::huffman {
+
+namespace detail {
+
+/// Reverses the lowest `n` bits of `value`
+///
+/// Codes are stored most significant bit first, but appear in a bit stream
+/// least significant bit first. Lookup tables are indexed by the bit stream.
+///
+constexpr auto reverse_bits(std::size_t value, std::uint8_t n) -> std::size_t
+{
+  if (n == 0) {
+    return 0;
+  }
+  // reverse all bits, swapping bits, pairs, nibbles and then bytes
+  auto bits = std::uint64_t{value};
+  bits = ((bits >> 1U) & 0x5555'5555'5555'5555U) |
+         ((bits & 0x5555'5555'5555'5555U) << 1U);
+  bits = ((bits >> 2U) & 0x3333'3333'3333'3333U) |
+         ((bits & 0x3333'3333'3333'3333U) << 2U);
+  bits = ((bits >> 4U) & 0x0F0F'0F0F'0F0F'0F0FU) |
+         ((bits & 0x0F0F'0F0F'0F0F'0F0FU) << 4U);
+  constexpr auto digits = std::numeric_limits<std::uint64_t>::digits;
+  return std::byteswap(bits) >> (digits - n);
+}
+
+template <class Entry, std::size_t Capacity>
+using decode_table_storage_t = std::conditional_t<
+    Capacity == std::dynamic_extent,
+    std::vector<Entry>,
+    static_vector<Entry, Capacity>>;
+
+}  // namespace detail
+
+/// Huffman decode table
+/// @tparam Symbol symbol type
+/// @tparam Capacity upper bound for the number of entries
+///
+/// A decode-optimized form of `table`. A primary lookup table is indexed by
+/// the next `primary_bitsize()` bits of a bit stream. Entries for codes longer
+/// than that link to a secondary table indexed by the bits that follow, so
+/// decoding a symbol costs one or two table loads.
+///
+/// If `Capacity` is `std::dynamic_extent`, `std::vector` is used to store the
+/// entries. Otherwise, a fixed capacity array is used.
+///
+template <symbol Symbol, std::size_t Capacity = std::dynamic_extent>
+class decode_table
+{
+public:
+  /// Symbol type
+  ///
+  using symbol_type = Symbol;
+
+  /// A lookup table entry
+  ///
+  /// An entry is one of:
+  /// * a leaf, where `bitsize` is the size of the code for `symbol`;
+  /// * a link, where `subtable_bitsize` is the number of bits used to index
+  ///   the secondary table starting at `subtable`;
+  /// * invalid, where both `bitsize` and `subtable_bitsize` are zero. This
+  ///   only occurs for tables with incomplete codes.
+  ///
+  struct entry
+  {
+    symbol_type symbol{};
+    std::uint32_t subtable{};
+    std::uint8_t bitsize{};
+    std::uint8_t subtable_bitsize{};
+
+    [[nodiscard]]
+    constexpr auto is_link() const -> bool
+    {
+      return subtable_bitsize != std::uint8_t{};
+    }
+
+    [[nodiscard]]
+    friend constexpr auto
+    operator==(const entry&, const entry&) -> bool = default;
+  };
+
+  /// Default bitsize used to index the primary table
+  ///
+  static constexpr std::uint8_t default_primary_bitsize = 9;
+
+  /// Maximum bitsize of a code of a table constructed from code bitsizes
+  ///
+  static constexpr std::uint8_t max_code_bitsize = 15;
+
+private:
+  detail::decode_table_storage_t<entry, Capacity> entries_{};
+  std::uint8_t primary_bitsize_{};
+  std::uint8_t max_bitsize_{};
+
+  /// Returns the index in the primary table of a code longer than
+  /// `primary_bitsize()`
+  ///
+  [[nodiscard]]
+  constexpr auto primary_index(std::size_t value, std::uint8_t bitsize) const
+      -> std::size_t
+  {
+    return detail::reverse_bits(
+        value >> (bitsize - primary_bitsize_), primary_bitsize_);
+  }
+
+  /// Extends the secondary table of a code longer than `primary_bitsize()`
+  /// to fit it
+  ///
+  constexpr auto extend_subtable(std::size_t value, std::uint8_t bitsize)
+      -> void
+  {
+    auto& link = entries_[primary_index(value, bitsize)];
+    link.subtable_bitsize = std::max(
+        link.subtable_bitsize,
+        static_cast<std::uint8_t>(bitsize - primary_bitsize_));
+  }
+
+  /// Allocates the secondary tables after the primary table, once each has
+  /// been extended to fit its codes
+  ///
+  constexpr auto allocate_subtables() -> void
+  {
+    const auto primary_size = std::size_t{1} << primary_bitsize_;
+    auto size = primary_size;
+    for (auto i = std::size_t{}; i != primary_size; ++i) {
+      if (auto& link = entries_[i]; link.is_link()) {
+        link.subtable = static_cast<std::uint32_t>(size);
+        size += std::size_t{1} << link.subtable_bitsize;
+      }
+    }
+    entries_.resize(size);
+  }
+
+  /// Fills the entries of a code, replicating it over all indices it prefixes
+  ///
+  constexpr auto
+  insert(symbol_type symbol, std::size_t value, std::uint8_t bitsize) -> void
+  {
+    const auto leaf = entry{.symbol = symbol, .bitsize = bitsize};
+
+    if (bitsize <= primary_bitsize_) {
+      const auto primary_size = std::size_t{1} << primary_bitsize_;
+      const auto first = detail::reverse_bits(value, bitsize);
+      for (auto i = first; i < primary_size; i += 1UZ << bitsize) {
+        entries_[i] = leaf;
+      }
+      return;
+    }
+
+    const auto& link = entries_[primary_index(value, bitsize)];
+    const auto suffix_bitsize =
+        static_cast<std::uint8_t>(bitsize - primary_bitsize_);
+    const auto suffix = value & ((1UZ << suffix_bitsize) - 1UZ);
+    const auto subtable_size = 1UZ << link.subtable_bitsize;
+    const auto subtable = std::size_t{link.subtable};
+
+    for (auto i = detail::reverse_bits(suffix, suffix_bitsize);
+         i < subtable_size;
+         i += 1UZ << suffix_bitsize) {
+      entries_[subtable + i] = leaf;
+    }
+  }
+
+public:
+  /// Constructs an empty decode table
+  ///
+  decode_table() = default;
+
+  /// Constructs a decode table from a code table
+  /// @param code_table code table in DEFLATE canonical form
+  /// @param primary_bitsize maximum number of bits used to index the primary
+  ///     table
+  /// @pre `Capacity` is large enough to hold all entries
+  ///
+  template <std::size_t Extent>
+  constexpr explicit decode_table(
+      const table<symbol_type, Extent>& code_table,
+      std::uint8_t primary_bitsize = default_primary_bitsize)
+  {
+    if (code_table.begin() == code_table.end()) {
+      return;
+    }
+
+    // codes are ordered by bitsize
+    max_bitsize_ = std::prev(code_table.end())->bitsize();
+    primary_bitsize_ = std::min(primary_bitsize, max_bitsize_);
+    entries_.resize(std::size_t{1} << primary_bitsize_);
+
+    for (const auto& elem : code_table) {
+      if (elem.bitsize() > primary_bitsize_) {
+        extend_subtable(elem.value(), elem.bitsize());
+      }
+    }
+    allocate_subtables();
+    for (const auto& elem : code_table) {
+      insert(elem.symbol, elem.value(), elem.bitsize());
+    }
+  }
+
+  /// Constructs a decode table from the bitsize of the code of each symbol
+  /// @param bitsizes bitsize of the code of each symbol, indexed by symbol,
+  ///     or zero if a symbol has no code
+  /// @param primary_bitsize maximum number of bits used to index the primary
+  ///     table
+  /// @pre the code is not oversubscribed and each bitsize is at most
+  ///     `max_code_bitsize`
+  /// @pre `Capacity` is large enough to hold all entries
+  ///
+  /// Codes are assigned in DEFLATE canonical form by counting the symbols of
+  /// each bitsize, RFC 3.2.2, without constructing or sorting a `table`.
+  ///
+  constexpr decode_table(
+      code_bitsizes_tag,
+      std::span<const std::uint8_t> bitsizes,
+      std::uint8_t primary_bitsize = default_primary_bitsize)
+  {
+    auto counts = std::array<std::size_t, max_code_bitsize + 1>{};
+    for (const auto bitsize : bitsizes) {
+      assert(bitsize <= max_code_bitsize);
+      ++counts[bitsize];
+    }
+    counts[0] = 0;
+
+    max_bitsize_ = max_code_bitsize;
+    while (max_bitsize_ != 0 and counts[max_bitsize_] == 0) {
+      --max_bitsize_;
+    }
+    if (max_bitsize_ == 0) {
+      return;
+    }
+    primary_bitsize_ = std::min(primary_bitsize, max_bitsize_);
+    entries_.resize(std::size_t{1} << primary_bitsize_);
+
+    // the first code of each bitsize
+    auto next_code = std::array<std::size_t, max_code_bitsize + 1>{};
+    for (auto bitsize = 1UZ; bitsize <= max_bitsize_; ++bitsize) {
+      next_code[bitsize] = (next_code[bitsize - 1] + counts[bitsize - 1])
+                           << 1U;
+    }
+    assert(
+        next_code[max_bitsize_] + counts[max_bitsize_] <=
+            (1UZ << max_bitsize_) and
+        "the code is oversubscribed");
+
+    // codes of the same bitsize are consecutive, so each secondary table is
+    // extended once per bitsize of its codes
+    for (auto bitsize = static_cast<std::uint8_t>(primary_bitsize_ + 1);
+         bitsize <= max_bitsize_;
+         ++bitsize) {
+      if (counts[bitsize] == 0) {
+        continue;
+      }
+      const auto shift = bitsize - primary_bitsize_;
+      const auto first = next_code[bitsize] >> shift;
+      const auto last = (next_code[bitsize] + counts[bitsize] - 1) >> shift;
+      for (auto prefix = first; prefix <= last; ++prefix) {
+        extend_subtable(prefix << shift, bitsize);
+      }
+    }
+    allocate_subtables();
+
+    for (auto i = std::size_t{}; i != bitsizes.size(); ++i) {
+      if (const auto bitsize = bitsizes[i]; bitsize != 0) {
+        insert(static_cast<symbol_type>(i), next_code[bitsize]++, bitsize);
+      }
+    }
+  }
+
+  /// Number of bits used to index the primary table
+  ///
+  [[nodiscard]]
+  constexpr auto primary_bitsize() const -> std::uint8_t
+  {
+    return primary_bitsize_;
+  }
+
+  /// Bitsize of the longest code in the table
+  ///
+  [[nodiscard]]
+  constexpr auto max_bitsize() const -> std::uint8_t
+  {
+    return max_bitsize_;
+  }
+
+  /// Number of entries, including secondary tables
+  ///
+  [[nodiscard]]
+  constexpr auto size() const -> std::size_t
+  {
+    return entries_.size();
+  }
+
+  /// Returns `true` if the table contains no codes
+  ///
+  [[nodiscard]]
+  constexpr auto empty() const -> bool
+  {
+    return entries_.empty();
+  }
+
+  /// Returns all entries
+  ///
+  /// The primary table is followed by the secondary tables.
+  ///
+  [[nodiscard]]
+  constexpr auto entries() const -> std::span<const entry>
+  {
+    return {entries_.data(), entries_.size()};
+  }
+
+  /// Finds the entry for the code at the start of `bits`
+  /// @param bits next bits of a bit stream, with the first bit in the least
+  ///     significant position
+  /// @pre `not empty()`
+  ///
+  /// @return the leaf entry for the code that prefixes `bits`, or an invalid
+  ///     entry if there is none. The returned entry may be longer than the
+  ///     number of valid bits in `bits`; callers must check this.
+  ///
+  [[nodiscard]]
+  constexpr auto find(std::uint64_t bits) const -> const entry&
+  {
+    assert(not empty());
+
+    const auto primary_mask = (std::uint64_t{1} << primary_bitsize_) - 1U;
+    const auto& primary = entries_[bits & primary_mask];
+    if (not primary.is_link()) {
+      return primary;
+    }
+
+    const auto subtable_mask =
+        (std::uint64_t{1} << primary.subtable_bitsize) - 1U;
+    const auto index = (bits >> primary_bitsize_) & subtable_mask;
+    return entries_[primary.subtable + index];
+  }
+};
+
+template <symbol Symbol, std::size_t Extent>
+decode_table(const table<Symbol, Extent>&) -> decode_table<Symbol>;
+
+template <symbol Symbol, std::size_t Extent>
+decode_table(const table<Symbol, Extent>&, std::uint8_t)
+    -> decode_table<Symbol>;
+
+}  // namespace starflate::huffman
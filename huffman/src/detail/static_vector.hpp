@@ -32,6 +32,7 @@ public:
   using base_type::cbegin;
   using base_type::data;
   using base_type::front;
+  using base_type::operator[];
 
   constexpr auto reserve(size_type new_cap [[maybe_unused]]) -> void
   {
@@ -29,6 +29,15 @@ struct symbol_bitsize_tag
 };
 inline constexpr auto symbol_bitsize = symbol_bitsize_tag{};
 
+/// Disambiguation tag to specify a decode table is constructed with the
+///    bitsize of the code of each symbol
+///
+struct code_bitsizes_tag
+{
+  explicit code_bitsizes_tag() = default;
+};
+inline constexpr auto code_bitsizes = code_bitsizes_tag{};
+
 template <class... Ts>
 constexpr auto byte_array(Ts... values)
 {
@@ -1,14 +1,27 @@
 #include "huffman/huffman.hpp"
 #include "version/version.hpp"
 
+#include <algorithm>
 #include <array>
 #include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 // ignore checks to Google Benchmark headers,
 // NOLINTBEGIN(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
 
 namespace {
 
+namespace huffman = starflate::huffman;
+
 void BM_CodeTable(benchmark::State& state)
 {
   const auto frequencies = std::vector<std::pair<char, std::size_t>>{
@@ -25,8 +38,214 @@ void BM_CodeTable(benchmark::State& state)
 
 BENCHMARK(BM_CodeTable);
 
+using Symbol = std::uint16_t;
+
+/// Distribution of symbol frequencies
+///
+enum class Distribution : std::uint8_t
+{
+  Uniform,
+  Zipf,       // frequency inversely proportional to rank
+  Geometric,  // frequency decreasing by a constant ratio with rank
+};
+
+constexpr auto distributions =
+    std::array<std::pair<Distribution, std::string_view>, 3>{{
+        {Distribution::Uniform, "uniform"},
+        {Distribution::Zipf, "zipf"},
+        {Distribution::Geometric, "geometric"},
+    }};
+
+/// Inputs for each `huffman::table` constructor, describing the same code
+///
+struct Alphabet
+{
+  std::vector<std::pair<Symbol, std::size_t>> frequencies;
+  std::vector<Symbol> data;
+  std::vector<std::pair<huffman::symbol_span<Symbol>, std::uint8_t>> bitsizes;
+  std::vector<std::pair<huffman::code, Symbol>> contents;
+};
+
+/// Makes the inputs for `size` symbols with the given distribution
+///
+/// Frequencies are the counts of symbols in data of 64 symbols per symbol in
+/// the alphabet, in which each symbol occurs at least once.
+///
+auto make_alphabet(std::size_t size, Distribution distribution) -> Alphabet
+{
+  // NOLINTNEXTLINE(readability-magic-numbers)
+  constexpr auto kGeometricRatio = 0.75;
+  // NOLINTNEXTLINE(readability-magic-numbers)
+  const auto data_size = 64 * size;
+
+  auto weights = std::vector<double>(size);
+  for (auto i = 0UZ; i != size; ++i) {
+    const auto rank = static_cast<double>(i);
+    switch (distribution) {
+      case Distribution::Uniform:
+        weights[i] = 1.0;
+        break;
+      case Distribution::Zipf:
+        weights[i] = 1.0 / (rank + 1.0);
+        break;
+      case Distribution::Geometric:
+        weights[i] = std::pow(kGeometricRatio, rank);
+        break;
+    }
+  }
+  const auto total = std::accumulate(weights.cbegin(), weights.cend(), 0.0);
+
+  auto alphabet = Alphabet{};
+  for (auto i = 0UZ; i != size; ++i) {
+    const auto share =
+        static_cast<double>(data_size - size) * weights[i] / total;
+    alphabet.frequencies.emplace_back(
+        static_cast<Symbol>(i), 1 + static_cast<std::size_t>(share));
+  }
+
+  for (const auto& [symbol, frequency] : alphabet.frequencies) {
+    alphabet.data.insert(alphabet.data.end(), frequency, symbol);
+  }
+  std::ranges::shuffle(alphabet.data, std::mt19937{size});
+
+  const auto table = huffman::table<Symbol>{alphabet.frequencies};
+  for (const auto& encoding : table) {
+    alphabet.contents.emplace_back(
+        static_cast<const huffman::code&>(encoding), encoding.symbol);
+  }
+
+  // consecutive symbols with the same bitsize share a span
+  auto by_symbol = alphabet.contents;
+  std::ranges::sort(by_symbol, {}, [](const auto& entry) {
+    return entry.second;
+  });
+  for (const auto& [code, symbol] : by_symbol) {
+    if (not alphabet.bitsizes.empty() and
+        alphabet.bitsizes.back().second == code.bitsize()) {
+      alphabet.bitsizes.back().first = {
+          alphabet.bitsizes.back().first.front(), symbol};
+    } else {
+      alphabet.bitsizes.emplace_back(symbol, code.bitsize());
+    }
+  }
+  return alphabet;
+}
+
+template <std::size_t Extent>
+void BM_TableFromFrequencies(benchmark::State& state, const Alphabet& alphabet)
+{
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto t = huffman::table<Symbol, Extent>{alphabet.frequencies};
+    benchmark::DoNotOptimize(t);
+  }
+  state.SetItemsProcessed(
+      state.iterations() *
+      static_cast<std::int64_t>(alphabet.frequencies.size()));
+}
+
+template <std::size_t Extent>
+void BM_TableFromData(benchmark::State& state, const Alphabet& alphabet)
+{
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto t = huffman::table<Symbol, Extent>{alphabet.data};
+    benchmark::DoNotOptimize(t);
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(alphabet.data.size()));
+}
+
+template <std::size_t Extent>
+void BM_TableFromSymbolBitsize(
+    benchmark::State& state, const Alphabet& alphabet)
+{
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto t = huffman::table<Symbol, Extent>{
+        huffman::symbol_bitsize, alphabet.bitsizes};
+    benchmark::DoNotOptimize(t);
+  }
+  state.SetItemsProcessed(
+      state.iterations() *
+      static_cast<std::int64_t>(alphabet.contents.size()));
+}
+
+template <std::size_t Extent>
+void BM_TableFromContents(benchmark::State& state, const Alphabet& alphabet)
+{
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto t = huffman::table<Symbol, Extent>{
+        huffman::table_contents, alphabet.contents};
+    benchmark::DoNotOptimize(t);
+  }
+  state.SetItemsProcessed(
+      state.iterations() *
+      static_cast<std::int64_t>(alphabet.contents.size()));
+}
+
+/// Registers benchmarks of each constructor for an alphabet of `Size`
+/// symbols, for tables with a static extent of `Size` and a dynamic extent
+///
+/// Items processed are symbols of the alphabet, or of the data for
+/// `BM_TableFromData`.
+///
+template <std::size_t Size>
+void register_table_benchmarks()
+{
+  for (const auto& [distribution, distribution_name] : distributions) {
+    const auto alphabet = make_alphabet(Size, distribution);
+    const auto suffix =
+        "/" + std::to_string(Size) + "/" + std::string{distribution_name};
+
+    const auto add = [&alphabet, &suffix](
+                         std::string_view name, auto bench_static,
+                         auto bench_dynamic) {
+      benchmark::RegisterBenchmark(
+          (std::string{name} + "/static" + suffix).c_str(),
+          bench_static,
+          alphabet);
+      benchmark::RegisterBenchmark(
+          (std::string{name} + "/dynamic" + suffix).c_str(),
+          bench_dynamic,
+          alphabet);
+    };
+    add("BM_TableFromFrequencies",
+        BM_TableFromFrequencies<Size>,
+        BM_TableFromFrequencies<std::dynamic_extent>);
+    add("BM_TableFromData",
+        BM_TableFromData<Size>,
+        BM_TableFromData<std::dynamic_extent>);
+    add("BM_TableFromSymbolBitsize",
+        BM_TableFromSymbolBitsize<Size>,
+        BM_TableFromSymbolBitsize<std::dynamic_extent>);
+    add("BM_TableFromContents",
+        BM_TableFromContents<Size>,
+        BM_TableFromContents<std::dynamic_extent>);
+  }
+}
+
 }  // namespace
 
-BENCHMARK_MAIN();
+int main(int argc, char** argv)
+{
+  // code length, distance and literal/length alphabets of DEFLATE, and a
+  // large alphabet
+  // NOLINTBEGIN(readability-magic-numbers)
+  register_table_benchmarks<19>();
+  register_table_benchmarks<30>();
+  register_table_benchmarks<288>();
+  register_table_benchmarks<4096>();
+  // NOLINTEND(readability-magic-numbers)
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
 
 // NOLINTEND(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
@@ -0,0 +1,204 @@
+#include "huffman/huffman.hpp"
+#include "huffman/src/utility.hpp"
+
+#include <boost/ut.hpp>
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// Reads n bits from `bits` one at a time, first bit least significant
+auto pop_slow(::starflate::huffman::bit_span& bits, std::uint8_t n)
+    -> std::uint64_t
+{
+  auto res = std::uint64_t{};
+  for (auto i = std::uint8_t{}; i != n; ++i) {
+    res |= std::uint64_t{static_cast<bool>(bits[i])} << i;
+  }
+  bits.consume(n);
+  return res;
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+auto main() -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::test;
+
+  namespace huffman = ::starflate::huffman;
+
+  test("default constructible") = [] {
+    constexpr auto reader = huffman::bit_reader{};
+
+    static_assert(reader.empty());
+    static_assert(reader.size() == 0);
+    static_assert(not reader.overrun());
+  };
+
+  test("pop in constant expression") = [] {
+    static constexpr auto data = huffman::byte_array(0b1010'1100, 0xff, 0x01);
+
+    constexpr auto popped = [] {
+      auto reader = huffman::bit_reader{huffman::bit_span{data}};
+      const auto a = reader.pop(3);
+      const auto b = reader.pop(7);
+      const auto c = reader.pop(14);
+      return std::array{a, b, c};
+    }();
+
+    static_assert(popped[0] == 0b100);
+    static_assert(popped[1] == 0b111'0101);
+    static_assert(popped[2] == 0b00'0000'0111'1111);
+  };
+
+  test("pop matches bit_span for varying field widths") = [] {
+    auto data = std::vector<std::byte>(97);
+    for (auto i = 0UZ; i != data.size(); ++i) {
+      data[i] = static_cast<std::byte>((i * 151U) ^ (i >> 2U));
+    }
+
+    for (auto offset = std::uint8_t{}; offset != CHAR_BIT; ++offset) {
+      const auto bit_size = (data.size() * CHAR_BIT) - offset;
+      auto expected = huffman::bit_span{data.data(), bit_size, offset};
+      auto reader = huffman::bit_reader{data.data(), bit_size, offset};
+
+      auto width = std::uint8_t{1};
+      while (reader.size() >= width) {
+        expect(eq(static_cast<std::size_t>(expected.size()), reader.size()));
+        expect(eq(pop_slow(expected, width), reader.pop(width)));
+        width = static_cast<std::uint8_t>(
+            (width % huffman::bit_reader::max_bits) + 1U);
+      }
+      expect(not reader.overrun());
+    }
+  };
+
+  test("reading past the end yields zeros and sets overrun") = [] {
+    static constexpr auto data = huffman::byte_array(0xff, 0xff);
+    auto reader = huffman::bit_reader{huffman::bit_span{data}};
+
+    expect(eq(0x3fffU, reader.pop(14)));
+    expect(eq(2UZ, reader.size()));
+    expect(not reader.overrun());
+
+    expect(eq(0b0011U, reader.pop(4)));
+    expect(reader.overrun());
+    expect(reader.empty());
+    expect(eq(0UZ, reader.size()));
+  };
+
+  test("bit_size that is not a multiple of CHAR_BIT") = [] {
+    static constexpr auto data = huffman::byte_array(0b1111'0000, 0b1111'1111);
+    auto reader = huffman::bit_reader{data.data(), 10, 2};
+
+    expect(eq(10UZ, reader.size()));
+    expect(eq(0b11'1111'1100U, reader.pop(10)));
+    expect(reader.empty());
+    expect(not reader.overrun());
+  };
+
+  test("bits returns the remaining input") = [] {
+    static constexpr auto data =
+        huffman::byte_array(0b1010'1010, 0b1100'1100, 0xab, 0xcd);
+    auto reader = huffman::bit_reader{huffman::bit_span{data}};
+
+    reader.pop(5);
+    const auto remaining = reader.bits();
+    auto expected = huffman::bit_span{data};
+    expected.consume(5);
+
+    expect(std::ranges::equal(expected, remaining));
+
+    reader.consume_to_byte_boundary();
+    expect(eq(24UZ, reader.size()));
+    expect(reader.bits().byte_data() == &data[1]);
+  };
+
+  test("input provided in chunks") = [] {
+    static constexpr auto data =
+        huffman::byte_array(0b1010'1010, 0b1100'1100, 0xab, 0xcd, 0xef);
+    auto expected = huffman::bit_span{data};
+
+    auto reader = huffman::bit_reader{};
+    reader.set_input(data.data(), 2);
+    expect(eq(pop_slow(expected, 11), reader.pop(11)));
+    expect(eq(5UZ, reader.size()));
+
+    // all buffered bits are kept across inputs
+    reader.set_input(&data[2], 1);
+    expect(eq(13UZ, reader.size()));
+    expect(eq(pop_slow(expected, 7), reader.pop(7)));
+
+    // unbuffer returns whole bytes that have not been consumed
+    reader.set_input(&data[3], 2);
+    reader.refill();
+    reader.unbuffer();
+    expect(eq(6U, reader.buffered()));
+    expect(reader.next_byte() == &data[3]);
+    expect(eq(22UZ, reader.size()));
+    expect(eq(pop_slow(expected, 22), reader.pop(22)));
+    expect(reader.empty());
+  };
+
+  test("fast refill after a slow refill and set_input") = [] {
+    auto data = std::array<std::byte, 14 + 64>{};
+    for (auto i = 0UZ; i != data.size(); ++i) {
+      data[i] = static_cast<std::byte>((i * 37U) + 11U);
+    }
+    auto expected = huffman::bit_span{data};
+
+    auto reader = huffman::bit_reader{data.data(), 14 * CHAR_BIT};
+    reader.refill();
+    expect(eq(pop_slow(expected, 48), reader.pop(48)));
+    // fewer than 8 bytes remain, so the slow path refills
+    reader.refill();
+    expect(reader.buffered() < 64U);
+
+    // provide the rest of the input, including any bytes not yet buffered
+    const auto* next = reader.next_byte();
+    reader.set_input(
+        next, static_cast<std::size_t>(data.data() + data.size() - next));
+    reader.refill();
+    expect(reader.buffered() < 64U);
+    while (not reader.empty()) {
+      expect(eq(pop_slow(expected, 32), reader.pop(32)));
+    }
+    expect(not reader.overrun());
+  };
+
+  test("decode_one") = [] {
+    using namespace huffman::literals;
+
+    static constexpr auto code_table = huffman::table{
+        huffman::table_contents,
+        {std::pair{0_c, 'e'},
+         {10_c, 'i'},
+         {110_c, 'n'},
+         {1110_c, 'q'},
+         {11110_c, '\4'},
+         {11111_c, 'x'}}};
+    const auto table = huffman::decode_table{code_table, 2};
+
+    static constexpr auto encoded = huffman::byte_array(0b1111'1011);
+    auto reader = huffman::bit_reader{huffman::bit_span{encoded}};
+
+    const auto n = huffman::decode_one(table, reader);
+    expect(n.has_value() and n.symbol() == 'n');
+    reader.consume(n.encoded_size());
+
+    const auto x = huffman::decode_one(table, reader);
+    expect(x.has_value() and x.symbol() == 'x');
+    reader.consume(x.encoded_size());
+
+    // not enough bits remain for any code
+    expect(not huffman::decode_one(table, reader).has_value());
+  };
+}
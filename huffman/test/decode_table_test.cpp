@@ -0,0 +1,243 @@
+#include "huffman/huffman.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr auto eot = '\4';
+
+constexpr auto code_table = [] {
+  using namespace ::starflate::huffman::literals;
+
+  // clang-format off
+  return ::starflate::huffman::table{
+      ::starflate::huffman::table_contents,
+      {
+          std::pair{0_c, 'e'},
+                   {10_c, 'i'},
+                   {110_c, 'n'},
+                   {1110_c, 'q'},
+                   {11110_c, eot},
+                   {11111_c, 'x'},
+      }};
+  // clang-format on
+}();
+
+// RFC 3.2.6: static literal/length table
+constexpr auto fixed_len_table =  // clang-format off
+  ::starflate::huffman::table<std::uint16_t, 288>{
+    ::starflate::huffman::symbol_bitsize,
+    {{{  0, 143}, 8},
+     {{144, 255}, 9},
+     {{256, 279}, 7},
+     {{280, 287}, 8}}};
+// clang-format on
+
+/// Checks that `decode_one` returns the same result with a decode table as it
+/// does with a code table, for every bit pattern of `n_bits` bits.
+template <class Table, class DecodeTable>
+auto decodes_same(
+    const Table& table, const DecodeTable& decode_table, std::uint8_t n_bits)
+    -> bool
+{
+  namespace huffman = ::starflate::huffman;
+
+  for (auto value = 0UZ; value != (1UZ << n_bits); ++value) {
+    auto bytes = std::array<std::byte, sizeof(value)>{};
+    for (auto i = 0UZ; i != bytes.size(); ++i) {
+      bytes[i] = static_cast<std::byte>(value >> (i * CHAR_BIT));
+    }
+    const auto bits = huffman::bit_span{bytes.data(), n_bits};
+
+    const auto expected = huffman::decode_one(table, bits);
+    const auto actual = huffman::decode_one(decode_table, bits);
+
+    if (expected.has_value() != actual.has_value()) {
+      return false;
+    }
+    if (expected.has_value() and
+        (expected.symbol() != actual.symbol() or
+         expected.encoded_size() != actual.encoded_size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE(readability-function-cognitive-complexity)
+auto main() -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::test;
+
+  namespace huffman = ::starflate::huffman;
+
+  test("empty") = [] {
+    constexpr auto table = huffman::decode_table<char, 1>{};
+    static_assert(table.empty());
+
+    constexpr auto encoded = std::array{std::byte{}};
+    expect(not huffman::decode_one(table, encoded).has_value());
+  };
+
+  test("primary table only") = [] {
+    static constexpr auto table = huffman::decode_table<char, 32>{code_table};
+
+    static_assert(table.primary_bitsize() == 5);
+    static_assert(table.max_bitsize() == 5);
+    static_assert(table.size() == 32);
+
+    expect(decodes_same(code_table, table, 5));
+    expect(decodes_same(code_table, table, 3));
+  };
+
+  test("secondary tables") = [] {
+    static constexpr auto table =
+        huffman::decode_table<char, 16>{code_table, 2};
+
+    static_assert(table.primary_bitsize() == 2);
+    // `11` prefixes the codes for `n`, `q`, `eot` and `x`
+    static_assert(table.size() == 4 + 8);
+    static_assert(table.entries().size() == table.size());
+    static_assert(table.entries()[0b11].is_link());
+    static_assert(table.entries()[0b11].subtable == 4);
+
+    expect(decodes_same(code_table, table, 5));
+    expect(decodes_same(code_table, table, 4));
+    expect(decodes_same(code_table, table, 1));
+  };
+
+  test("decodes `exeneeeexniqneiein`") = [] {
+    static constexpr auto expected = std::array{
+        'e', 'x', 'e', 'n', 'e', 'e', 'e', 'e', 'x', 'n',
+        'i', 'q', 'n', 'e', 'i', 'e', 'i', 'n', 'i', eot};
+
+    constexpr auto decoded = [] {
+      constexpr auto encoded = std::array{
+          std::byte{0b1011'1110},
+          std::byte{0b1100'0001},
+          std::byte{0b0101'1111},
+          std::byte{0b0011'0111},
+          std::byte{0b0110'1001},
+          std::byte{0b0011'1101}};
+
+      const auto table = huffman::decode_table<char, 16>{code_table, 3};
+
+      auto buf = std::array<char, expected.size()>{};
+
+      auto it [[maybe_unused]]
+      = huffman::decode(
+          table,
+          huffman::bit_span{encoded.data(), (encoded.size() * CHAR_BIT) - 1},
+          buf.begin());
+
+      assert(it == buf.end());
+      return buf;
+    }();
+
+    expect(eq(expected, decoded));
+  };
+
+  test("code longer than remaining bits is not decoded") = [] {
+    const auto table = huffman::decode_table{code_table};
+
+    constexpr auto encoded = std::array{std::byte{0b1111}};
+
+    expect(not huffman::decode_one(table, huffman::bit_span{encoded.data(), 4})
+                   .has_value());
+    expect(huffman::decode_one(table, huffman::bit_span{encoded.data(), 5})
+               .has_value());
+  };
+
+  test("incomplete code") = [] {
+    using namespace huffman::literals;
+
+    static constexpr auto incomplete = huffman::table{
+        huffman::table_contents, {std::pair{0_c, 'a'}, {10_c, 'b'}}};
+    const auto table = huffman::decode_table{incomplete};
+
+    expect(decodes_same(incomplete, table, 2));
+
+    constexpr auto encoded = std::array{std::byte{0b11}};
+    expect(not huffman::decode_one(table, encoded).has_value());
+  };
+
+  test("DEFLATE fixed literal/length table") = [] {
+    const auto table = huffman::decode_table{fixed_len_table, 7};
+
+    expect(eq(7, table.primary_bitsize()));
+    expect(eq(9, table.max_bitsize()));
+    expect(decodes_same(fixed_len_table, table, 9));
+
+    const auto default_table = huffman::decode_table{fixed_len_table};
+    expect(eq(9, default_table.primary_bitsize()));
+    expect(eq(512UZ, default_table.size()));
+    expect(decodes_same(fixed_len_table, default_table, 9));
+  };
+
+  test("table with dynamic extent") = [] {
+    const auto table = huffman::table{
+        huffman::symbol_bitsize,
+        std::vector<std::pair<huffman::symbol_span<std::uint16_t>, std::uint8_t>>{
+            {{0, 1}, 2}, {{2, 4}, 3}, {{5, 8}, 6}, {{9, 16}, 7}}};
+    const auto decode_table = huffman::decode_table{table, 4};
+
+    expect(decodes_same(table, decode_table, 8));
+  };
+
+  test("table from code bitsizes") = [] {
+    static constexpr auto fixed_len_bitsizes = [] {
+      auto bitsizes = std::array<std::uint8_t, 288>{};
+      for (const auto& elem : fixed_len_table) {
+        bitsizes[elem.symbol] = elem.bitsize();
+      }
+      return bitsizes;
+    }();
+
+    for (const auto primary_bitsize : {9, 7, 4}) {
+      const auto bitsize = static_cast<std::uint8_t>(primary_bitsize);
+      const auto expected =
+          huffman::decode_table<std::uint16_t, 1024>{fixed_len_table, bitsize};
+      const auto actual = huffman::decode_table<std::uint16_t, 1024>{
+          huffman::code_bitsizes, fixed_len_bitsizes, bitsize};
+      expect(eq(expected.primary_bitsize(), actual.primary_bitsize()));
+      expect(eq(expected.max_bitsize(), actual.max_bitsize()));
+      expect(std::ranges::equal(expected.entries(), actual.entries()))
+          << "primary bitsize " << primary_bitsize;
+      expect(decodes_same(fixed_len_table, actual, 9));
+    }
+
+    // symbols without codes, and codes longer than the primary table
+    constexpr auto bitsizes = std::array<std::uint8_t, 12>{
+        3, 0, 3, 5, 5, 0, 2, 6, 6, 4, 6, 6};
+    constexpr auto table = huffman::decode_table<std::uint16_t, 32>{
+        huffman::code_bitsizes, bitsizes, 3};
+    static_assert(table.max_bitsize() == 6);
+    const auto code_table = huffman::table{
+        huffman::symbol_bitsize,
+        std::vector<std::pair<huffman::symbol_span<std::uint16_t>, std::uint8_t>>{
+            {{0}, 3},
+            {{2}, 3},
+            {{3, 4}, 5},
+            {{6}, 2},
+            {{7, 8}, 6},
+            {{9}, 4},
+            {{10, 11}, 6}}};
+    expect(decodes_same(code_table, table, 6));
+
+    constexpr auto empty = huffman::decode_table<std::uint16_t, 1>{
+        huffman::code_bitsizes, std::array<std::uint8_t, 3>{}};
+    static_assert(empty.empty());
+  };
+}
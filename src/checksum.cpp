@@ -0,0 +1,511 @@
+#include "checksum.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace starflate {
+namespace {
+
+// reversed CRC-32 polynomial x^32 + x^26 + x^23 + ... + x^2 + x + 1
+constexpr std::uint32_t crc32_polynomial = 0xEDB88320;
+
+constexpr std::size_t crc32_slices = 8;
+
+// crc32_tables[0] contains the CRC-32 of each byte value. crc32_tables[k]
+// contains the CRC-32 of each byte value followed by k zero bytes, allowing
+// eight bytes to be processed at once.
+constexpr auto crc32_tables = [] {
+  auto tables =
+      std::array<std::array<std::uint32_t, 1U << CHAR_BIT>, crc32_slices>{};
+  for (auto i = std::uint32_t{}; i != tables[0].size(); ++i) {
+    auto crc = i;
+    for (auto bit = 0; bit != CHAR_BIT; ++bit) {
+      crc = (crc >> 1U) ^ ((crc & 1U) != 0 ? crc32_polynomial : 0U);
+    }
+    tables[0][i] = crc;
+  }
+  for (auto k = 1UZ; k != tables.size(); ++k) {
+    for (auto i = 0UZ; i != tables[k].size(); ++i) {
+      const auto prev = tables[k - 1][i];
+      tables[k][i] = (prev >> CHAR_BIT) ^ tables[0][prev & 0xFFU];
+    }
+  }
+  return tables;
+}();
+
+/// Multiplies two polynomials modulo the CRC-32 polynomial, bit-reflected
+///
+constexpr auto multiply_mod_polynomial(std::uint32_t a, std::uint32_t b)
+    -> std::uint32_t
+{
+  constexpr auto kTopBit = std::uint32_t{1} << 31U;
+  auto product = std::uint32_t{};
+  for (auto bit = kTopBit; bit != 0; bit >>= 1U) {
+    if ((a & bit) != 0) {
+      product ^= b;
+    }
+    b = (b >> 1U) ^ ((b & 1U) != 0 ? crc32_polynomial : 0U);
+  }
+  return product;
+}
+
+// x^(2^k) modulo the CRC-32 polynomial, bit-reflected, for each k
+constexpr auto crc32_x_pow_2k = [] {
+  auto powers = std::array<std::uint32_t, sizeof(std::uint64_t) * CHAR_BIT>{};
+  auto power = std::uint32_t{1} << 30U;  // x^1
+  for (auto& p : powers) {
+    p = power;
+    power = multiply_mod_polynomial(power, power);
+  }
+  return powers;
+}();
+
+// largest prime smaller than 65536
+constexpr std::uint32_t adler32_modulus = 65521;
+
+// Largest n such that 255 * n * (n + 1) / 2 + (n + 1) * (adler32_modulus - 1)
+// fits in 32 bits. The sums of up to this many bytes are reduced at once.
+constexpr std::size_t adler32_max_run = 5552;
+
+constexpr auto adler32_half_bits = 16U;
+constexpr auto adler32_half_mask = std::uint32_t{0xFFFF};
+
+auto load_le64(const std::byte* data) -> std::uint64_t
+{
+  std::uint64_t word{};
+  std::memcpy(&word, data, sizeof(word));
+  if constexpr (std::endian::native == std::endian::big) {
+    word = std::byteswap(word);
+  }
+  return word;
+}
+
+/// Computes a CRC-32 eight bytes at a time with table lookups
+///
+auto crc32_portable(std::span<const std::byte> data, std::uint32_t crc)
+    -> std::uint32_t
+{
+  // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+  crc = ~crc;
+  while (data.size() >= sizeof(std::uint64_t)) {
+    const auto word = load_le64(data.data()) ^ crc;
+    auto next = std::uint32_t{};
+    for (auto k = 0UZ; k != crc32_slices; ++k) {
+      next ^= crc32_tables[crc32_slices - 1 - k]
+                          [(word >> (k * CHAR_BIT)) & 0xFFU];
+    }
+    crc = next;
+    data = data.subspan(sizeof(std::uint64_t));
+  }
+  for (const auto byte : data) {
+    const auto index = (crc ^ std::to_integer<std::uint32_t>(byte)) & 0xFFU;
+    crc = (crc >> CHAR_BIT) ^ crc32_tables[0][index];
+  }
+  return ~crc;
+  // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+}
+
+/// Computes an Adler-32 one byte at a time, reducing the sums once per run
+///
+auto adler32_portable(std::span<const std::byte> data, std::uint32_t adler)
+    -> std::uint32_t
+{
+  auto a = adler & adler32_half_mask;
+  auto b = adler >> adler32_half_bits;
+  while (not data.empty()) {
+    const auto run = data.first(std::min(data.size(), adler32_max_run));
+    for (const auto byte : run) {
+      a += std::to_integer<std::uint32_t>(byte);
+      b += a;
+    }
+    a %= adler32_modulus;
+    b %= adler32_modulus;
+    data = data.subspan(run.size());
+  }
+  return (b << adler32_half_bits) | a;
+}
+
+#if defined(__x86_64__)
+
+// Constants for folding with carry-less multiplication, from "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Gopal et
+// al.). Each is x^n mod P, bit-reflected and shifted left by one. Folding
+// moves data d bits further along the message by multiplying its low and high
+// 64 bits by x^(d + 32) and x^(d - 32) mod P.
+constexpr auto fold_1024_lo = 0x1'E88E'F372LL;  // x^(1024 + 32) mod P
+constexpr auto fold_1024_hi = 0x1'4A7F'E880LL;  // x^(1024 - 32) mod P
+constexpr auto fold_512_lo = 0x1'5444'2BD4LL;   // x^(512 + 32) mod P
+constexpr auto fold_512_hi = 0x1'C6E4'1596LL;   // x^(512 - 32) mod P
+constexpr auto fold_128_lo = 0x1'7519'97D0LL;   // x^(128 + 32) mod P
+constexpr auto fold_128_hi = 0x0'CCAA'009ELL;   // x^(128 - 32) mod P
+constexpr auto fold_64 = 0x1'63CD'6124LL;       // x^64 mod P
+// P and floor(x^64 / P), for Barrett reduction
+constexpr auto barrett_polynomial = 0x1'DB71'0641LL;
+constexpr auto barrett_quotient = 0x1'F701'1641LL;
+
+constexpr std::size_t m128_size = sizeof(__m128i);
+constexpr std::size_t m256_size = sizeof(__m256i);
+
+auto load_m128(std::span<const std::byte> data) -> __m128i
+{
+  __m128i value;
+  std::memcpy(&value, data.data(), sizeof(value));
+  return value;
+}
+
+[[gnu::target("avx")]]
+auto load_m256(std::span<const std::byte> data) -> __m256i
+{
+  __m256i value;
+  std::memcpy(&value, data.data(), sizeof(value));
+  return value;
+}
+
+/// Multiplies the low and high halves of `x` by the low and high halves of
+/// `k` and adds the products.
+[[gnu::target("pclmul")]]
+auto fold(__m128i x, __m128i k) -> __m128i
+{
+  return _mm_xor_si128(
+      _mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+[[gnu::target("avx2,vpclmulqdq")]]
+auto fold(__m256i x, __m256i k) -> __m256i
+{
+  return _mm256_xor_si256(
+      _mm256_clmulepi64_epi128(x, k, 0x00),
+      _mm256_clmulepi64_epi128(x, k, 0x11));
+}
+
+/// Folds the whole 16 byte blocks of `data` into `x`
+///
+/// @return `x` and the remaining bytes of `data`
+[[gnu::target("pclmul")]]
+auto fold_blocks(__m128i x, std::span<const std::byte>& data) -> __m128i
+{
+  const auto k128 = _mm_set_epi64x(fold_128_hi, fold_128_lo);
+  while (data.size() >= m128_size) {
+    x = _mm_xor_si128(fold(x, k128), load_m128(data));
+    data = data.subspan(m128_size);
+  }
+  return x;
+}
+
+/// Reduces 128 bits of folded data to a CRC-32 register value
+[[gnu::target("pclmul,sse4.1")]]
+auto reduce(__m128i x) -> std::uint32_t
+{
+  const auto low_32_mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  // 128 bits to 64 bits
+  const auto k128 = _mm_set_epi64x(fold_128_hi, fold_128_lo);
+  x = _mm_xor_si128(_mm_srli_si128(x, 8), _mm_clmulepi64_si128(x, k128, 0x10));
+  const auto k64 = _mm_set_epi64x(0, fold_64);
+  x = _mm_xor_si128(
+      _mm_srli_si128(x, 4),
+      _mm_clmulepi64_si128(_mm_and_si128(x, low_32_mask), k64, 0x00));
+
+  // Barrett reduction to 32 bits
+  const auto barrett = _mm_set_epi64x(barrett_quotient, barrett_polynomial);
+  auto t = _mm_clmulepi64_si128(_mm_and_si128(x, low_32_mask), barrett, 0x10);
+  t = _mm_clmulepi64_si128(_mm_and_si128(t, low_32_mask), barrett, 0x00);
+  return static_cast<std::uint32_t>(_mm_extract_epi32(_mm_xor_si128(x, t), 1));
+}
+
+/// Computes a CRC-32 by folding 64 bytes at a time with PCLMULQDQ
+///
+[[gnu::target("pclmul,sse4.1")]]
+auto crc32_pclmul(std::span<const std::byte> data, std::uint32_t crc)
+    -> std::uint32_t
+{
+  constexpr auto kLanes = 4UZ;
+  constexpr auto kStride = kLanes * m128_size;
+  if (data.size() < kStride) {
+    return crc32_portable(data, crc);
+  }
+
+  // std::array would drop the alignment attributes of __m128i
+  // NOLINTNEXTLINE(*-avoid-c-arrays)
+  __m128i x[kLanes]{};
+  for (auto i = 0UZ; i != kLanes; ++i) {
+    x[i] = load_m128(data.subspan(i * m128_size));
+  }
+  x[0] = _mm_xor_si128(x[0], _mm_cvtsi32_si128(static_cast<int>(~crc)));
+  data = data.subspan(kStride);
+
+  const auto k512 = _mm_set_epi64x(fold_512_hi, fold_512_lo);
+  while (data.size() >= kStride) {
+    for (auto i = 0UZ; i != kLanes; ++i) {
+      x[i] = _mm_xor_si128(
+          fold(x[i], k512), load_m128(data.subspan(i * m128_size)));
+    }
+    data = data.subspan(kStride);
+  }
+
+  const auto k128 = _mm_set_epi64x(fold_128_hi, fold_128_lo);
+  auto folded = x[0];
+  for (auto i = 1UZ; i != kLanes; ++i) {
+    folded = _mm_xor_si128(fold(folded, k128), x[i]);
+  }
+  folded = fold_blocks(folded, data);
+  return crc32_portable(data, ~reduce(folded));
+}
+
+/// Computes a CRC-32 by folding 128 bytes at a time with VPCLMULQDQ
+///
+[[gnu::target("avx2,pclmul,vpclmulqdq,sse4.1")]]
+auto crc32_vpclmul(std::span<const std::byte> data, std::uint32_t crc)
+    -> std::uint32_t
+{
+  constexpr auto kLanes = 4UZ;
+  constexpr auto kStride = kLanes * m256_size;
+  if (data.size() < kStride) {
+    return crc32_pclmul(data, crc);
+  }
+
+  // std::array would drop the alignment attributes of __m256i
+  // NOLINTNEXTLINE(*-avoid-c-arrays)
+  __m256i x[kLanes]{};
+  for (auto i = 0UZ; i != kLanes; ++i) {
+    x[i] = load_m256(data.subspan(i * m256_size));
+  }
+  x[0] = _mm256_xor_si256(
+      x[0], _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, static_cast<int>(~crc)));
+  data = data.subspan(kStride);
+
+  const auto k1024 = _mm256_set_epi64x(
+      fold_1024_hi, fold_1024_lo, fold_1024_hi, fold_1024_lo);
+  while (data.size() >= kStride) {
+    for (auto i = 0UZ; i != kLanes; ++i) {
+      x[i] = _mm256_xor_si256(
+          fold(x[i], k1024), load_m256(data.subspan(i * m256_size)));
+    }
+    data = data.subspan(kStride);
+  }
+
+  // fold the 128 bit halves of each lane, in message order
+  const auto k128 = _mm_set_epi64x(fold_128_hi, fold_128_lo);
+  auto folded = _mm256_castsi256_si128(x[0]);
+  folded = _mm_xor_si128(fold(folded, k128), _mm256_extracti128_si256(x[0], 1));
+  for (auto i = 1UZ; i != kLanes; ++i) {
+    folded = _mm_xor_si128(fold(folded, k128), _mm256_castsi256_si128(x[i]));
+    folded =
+        _mm_xor_si128(fold(folded, k128), _mm256_extracti128_si256(x[i], 1));
+  }
+  folded = fold_blocks(folded, data);
+  return crc32_portable(data, ~reduce(folded));
+}
+
+// Weights of the bytes of a 32 byte block in the sum b, which adds the sum a
+// after each byte.
+constexpr auto adler32_taps = [] {
+  auto taps = std::array<std::int8_t, 2 * m128_size>{};
+  for (auto i = 0UZ; i != taps.size(); ++i) {
+    taps[i] = static_cast<std::int8_t>(taps.size() - i);
+  }
+  return taps;
+}();
+
+[[gnu::target("sse4.1")]]
+auto horizontal_sum(__m128i x) -> std::uint32_t
+{
+  x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+  x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+  return static_cast<std::uint32_t>(_mm_cvtsi128_si32(x));
+}
+
+[[gnu::target("avx2")]]
+auto horizontal_sum(__m256i x) -> std::uint32_t
+{
+  return horizontal_sum(_mm_add_epi32(
+      _mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+}
+
+/// Adds the sums of a run of 32 byte blocks to an Adler-32
+///
+/// @param prefix_sums sum of the bytes preceding each block in the run
+/// @param byte_sums sum of the bytes in the run
+/// @param weighted_sums sum of the bytes in the run, each weighted by its
+///     distance from the end of its block
+///
+auto add_adler32_run(
+    std::uint32_t adler,
+    std::size_t run_size,
+    std::uint32_t prefix_sums,
+    std::uint32_t byte_sums,
+    std::uint32_t weighted_sums) -> std::uint32_t
+{
+  constexpr auto kBlockSize = 32U;
+  const auto a = std::uint64_t{adler & adler32_half_mask};
+  const auto b = std::uint64_t{adler >> adler32_half_bits} + (a * run_size) +
+                 (std::uint64_t{prefix_sums} * kBlockSize) + weighted_sums;
+  return static_cast<std::uint32_t>(
+      ((b % adler32_modulus) << adler32_half_bits) |
+      ((a + byte_sums) % adler32_modulus));
+}
+
+/// Computes an Adler-32 32 bytes at a time with SSSE3 dot products
+///
+[[gnu::target("ssse3,sse4.1")]]
+auto adler32_ssse3(std::span<const std::byte> data, std::uint32_t adler)
+    -> std::uint32_t
+{
+  constexpr auto kBlockSize = 2 * m128_size;
+  const auto taps = std::as_bytes(std::span{adler32_taps});
+  const auto taps_hi = load_m128(taps);
+  const auto taps_lo = load_m128(taps.subspan(m128_size));
+  const auto ones = _mm_set1_epi16(1);
+  const auto zero = _mm_setzero_si128();
+
+  while (data.size() >= kBlockSize) {
+    const auto run = data.first(
+        std::min(data.size(), adler32_max_run) / kBlockSize * kBlockSize);
+    auto prefix_sums = zero;
+    auto byte_sums = zero;
+    auto weighted_sums = zero;
+    for (auto block = run; not block.empty();
+         block = block.subspan(kBlockSize)) {
+      const auto hi = load_m128(block);
+      const auto lo = load_m128(block.subspan(m128_size));
+      prefix_sums = _mm_add_epi32(prefix_sums, byte_sums);
+      byte_sums = _mm_add_epi32(byte_sums, _mm_sad_epu8(hi, zero));
+      byte_sums = _mm_add_epi32(byte_sums, _mm_sad_epu8(lo, zero));
+      weighted_sums = _mm_add_epi32(
+          weighted_sums, _mm_madd_epi16(_mm_maddubs_epi16(hi, taps_hi), ones));
+      weighted_sums = _mm_add_epi32(
+          weighted_sums, _mm_madd_epi16(_mm_maddubs_epi16(lo, taps_lo), ones));
+    }
+    adler = add_adler32_run(
+        adler,
+        run.size(),
+        horizontal_sum(prefix_sums),
+        horizontal_sum(byte_sums),
+        horizontal_sum(weighted_sums));
+    data = data.subspan(run.size());
+  }
+  return adler32_portable(data, adler);
+}
+
+/// Computes an Adler-32 32 bytes at a time with AVX2 dot products
+///
+[[gnu::target("avx2")]]
+auto adler32_avx2(std::span<const std::byte> data, std::uint32_t adler)
+    -> std::uint32_t
+{
+  constexpr auto kBlockSize = m256_size;
+  const auto taps = load_m256(std::as_bytes(std::span{adler32_taps}));
+  const auto ones = _mm256_set1_epi16(1);
+  const auto zero = _mm256_setzero_si256();
+
+  while (data.size() >= kBlockSize) {
+    const auto run = data.first(
+        std::min(data.size(), adler32_max_run) / kBlockSize * kBlockSize);
+    auto prefix_sums = zero;
+    auto byte_sums = zero;
+    auto weighted_sums = zero;
+    for (auto block = run; not block.empty();
+         block = block.subspan(kBlockSize)) {
+      const auto bytes = load_m256(block);
+      prefix_sums = _mm256_add_epi32(prefix_sums, byte_sums);
+      byte_sums = _mm256_add_epi32(byte_sums, _mm256_sad_epu8(bytes, zero));
+      weighted_sums = _mm256_add_epi32(
+          weighted_sums,
+          _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, taps), ones));
+    }
+    adler = add_adler32_run(
+        adler,
+        run.size(),
+        horizontal_sum(prefix_sums),
+        horizontal_sum(byte_sums),
+        horizontal_sum(weighted_sums));
+    data = data.subspan(run.size());
+  }
+  return adler32_portable(data, adler);
+}
+
+#endif  // defined(__x86_64__)
+
+}  // namespace
+
+namespace detail {
+
+auto crc32_kernels() -> std::span<const ChecksumKernel>
+{
+  static const auto kernels = [] {
+    auto supported = std::vector<ChecksumKernel>{
+        {.name = "portable", .checksum = crc32_portable}};
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("pclmul") and
+        __builtin_cpu_supports("sse4.1")) {
+      supported.push_back({.name = "pclmul", .checksum = crc32_pclmul});
+      if (__builtin_cpu_supports("vpclmulqdq") and
+          __builtin_cpu_supports("avx2")) {
+        supported.push_back({.name = "vpclmulqdq", .checksum = crc32_vpclmul});
+      }
+    }
+#endif
+    return supported;
+  }();
+  return kernels;
+}
+
+auto adler32_kernels() -> std::span<const ChecksumKernel>
+{
+  static const auto kernels = [] {
+    auto supported = std::vector<ChecksumKernel>{
+        {.name = "portable", .checksum = adler32_portable}};
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("ssse3") and __builtin_cpu_supports("sse4.1")) {
+      supported.push_back({.name = "ssse3", .checksum = adler32_ssse3});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      supported.push_back({.name = "avx2", .checksum = adler32_avx2});
+    }
+#endif
+    return supported;
+  }();
+  return kernels;
+}
+
+}  // namespace detail
+
+auto crc32(std::span<const std::byte> data, std::uint32_t crc)
+    -> std::uint32_t
+{
+  static const auto checksum = detail::crc32_kernels().back().checksum;
+  return checksum(data, crc);
+}
+
+auto adler32(std::span<const std::byte> data, std::uint32_t adler)
+    -> std::uint32_t
+{
+  static const auto checksum = detail::adler32_kernels().back().checksum;
+  return checksum(data, adler);
+}
+
+auto crc32_combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t size2)
+    -> std::uint32_t
+{
+  // Appending size2 bytes multiplies the CRC of the first piece by
+  // x^(8 * size2), as for zlib. The CRCs' inversions cancel out.
+  auto shift = std::uint32_t{1} << 31U;  // x^0
+  const auto bits = size2 * CHAR_BIT;
+  for (auto k = 0UZ; k != crc32_x_pow_2k.size(); ++k) {
+    if (((bits >> k) & 1U) != 0) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      shift = multiply_mod_polynomial(crc32_x_pow_2k[k], shift);
+    }
+  }
+  return multiply_mod_polynomial(shift, crc1) ^ crc2;
+}
+
+}  // namespace starflate
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace starflate {
+
+/// Computes the CRC-32 of `data`, as used by gzip, RFC 1952 8.
+///
+/// Uses carry-less multiplication if the CPU supports it.
+///
+/// @param data The bytes to checksum.
+/// @param crc The CRC-32 of the bytes preceding `data`, so that a checksum can
+///     be computed in parts.
+/// @return The CRC-32 of the bytes preceding `data`, followed by `data`.
+///
+auto crc32(std::span<const std::byte> data, std::uint32_t crc = 0)
+    -> std::uint32_t;
+
+/// Computes the Adler-32 checksum of `data`, as used by zlib, RFC 1950 2.2.
+///
+/// Uses SIMD instructions if the CPU supports them.
+///
+/// @param data The bytes to checksum.
+/// @param adler The Adler-32 of the bytes preceding `data`, so that a checksum
+///     can be computed in parts.
+/// @return The Adler-32 of the bytes preceding `data`, followed by `data`.
+///
+auto adler32(std::span<const std::byte> data, std::uint32_t adler = 1)
+    -> std::uint32_t;
+
+/// Combines the CRC-32s of two consecutive pieces of data
+///
+/// Allows the pieces to be checksummed independently, e.g. in parallel.
+///
+/// @param crc1 The CRC-32 of the first piece.
+/// @param crc2 The CRC-32 of the second piece.
+/// @param size2 The size of the second piece.
+/// @return The CRC-32 of the first piece followed by the second.
+///
+auto crc32_combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t size2)
+    -> std::uint32_t;
+
+namespace detail {
+
+/// An implementation of `crc32` or `adler32`
+///
+struct ChecksumKernel
+{
+  std::string_view name;
+  auto (*checksum)(std::span<const std::byte> data, std::uint32_t initial)
+      -> std::uint32_t;
+};
+
+/// Returns the implementations of `crc32` supported by the CPU
+///
+/// The first is portable and the last is the one used by `crc32`.
+///
+auto crc32_kernels() -> std::span<const ChecksumKernel>;
+
+/// Returns the implementations of `adler32` supported by the CPU
+///
+/// The first is portable and the last is the one used by `adler32`.
+///
+auto adler32_kernels() -> std::span<const ChecksumKernel>;
+
+}  // namespace detail
+}  // namespace starflate
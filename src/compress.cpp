@@ -0,0 +1,1235 @@
+#include "compress.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace starflate {
+namespace {
+
+// RFC 3.2.5
+constexpr std::size_t min_match = 3;
+constexpr std::size_t max_match = 258;
+// Matches are restricted to distances below the window size so that the
+// hash chain entry of a match candidate is never overwritten by the current
+// position.
+constexpr std::size_t max_distance = 32767;
+constexpr std::size_t window_size = max_history_size;
+constexpr std::size_t window_mask = window_size - 1;
+
+constexpr std::size_t max_stored_size = 65535;
+
+constexpr std::uint16_t end_of_block = 256;
+constexpr std::size_t lit_or_len_symbols = 286;
+constexpr std::size_t fixed_lit_or_len_symbols = 288;
+constexpr std::size_t distance_symbols = 30;
+constexpr std::size_t code_length_symbols = 19;
+constexpr std::uint8_t max_code_bitsize = 15;
+constexpr std::uint8_t max_code_length_bitsize = 7;
+
+// Distance of a 3 byte match above which it is likely cheaper to emit
+// literals, as for zlib
+constexpr std::size_t too_far = 4096;
+
+constexpr unsigned hash_bits = 15;
+constexpr std::size_t hash_size = std::size_t{1} << hash_bits;
+
+// Number of symbols after which a block is emitted. Every block but the last
+// covers at least this many bytes.
+constexpr std::size_t max_block_symbols = std::size_t{1} << 14U;
+
+// Input is compressed in segments of at most this many bytes, so that
+// positions within a segment fit in 32 bits.
+constexpr std::size_t max_segment_size = std::size_t{1} << 30U;
+
+enum class BlockType : std::uint8_t
+{
+  NoCompression,
+  FixedHuffman,
+  DynamicHuffman,
+};
+
+/// Parameters of a compression level, as for zlib
+///
+struct LevelParams
+{
+  // a match at least this long shortens the search for a longer one
+  std::uint16_t good_length;
+  // with lazy matching, a match at least this long is emitted immediately.
+  // Otherwise, the positions within a match at most this long are inserted
+  // into the hash chains.
+  std::uint16_t max_lazy;
+  // a match at least this long ends the search
+  std::uint16_t nice_length;
+  // maximum number of hash chain entries searched
+  std::uint16_t max_chain;
+  bool lazy;
+};
+
+constexpr auto level_params =
+    std::array<LevelParams, std::size_t{max_compress_level} + 1>{
+        {{.good_length = 0,
+          .max_lazy = 0,
+          .nice_length = 0,
+          .max_chain = 0,
+          .lazy = false},
+         {.good_length = 4,
+          .max_lazy = 4,
+          .nice_length = 8,
+          .max_chain = 4,
+          .lazy = false},
+         {.good_length = 4,
+          .max_lazy = 5,
+          .nice_length = 16,
+          .max_chain = 8,
+          .lazy = false},
+         {.good_length = 4,
+          .max_lazy = 6,
+          .nice_length = 32,
+          .max_chain = 32,
+          .lazy = false},
+         {.good_length = 4,
+          .max_lazy = 4,
+          .nice_length = 16,
+          .max_chain = 16,
+          .lazy = true},
+         {.good_length = 8,
+          .max_lazy = 16,
+          .nice_length = 32,
+          .max_chain = 32,
+          .lazy = true},
+         {.good_length = 8,
+          .max_lazy = 16,
+          .nice_length = 128,
+          .max_chain = 128,
+          .lazy = true},
+         {.good_length = 8,
+          .max_lazy = 32,
+          .nice_length = 128,
+          .max_chain = 256,
+          .lazy = true},
+         {.good_length = 32,
+          .max_lazy = 128,
+          .nice_length = 258,
+          .max_chain = 1024,
+          .lazy = true},
+         {.good_length = 32,
+          .max_lazy = 258,
+          .nice_length = 258,
+          .max_chain = 4096,
+          .lazy = true}}};
+
+struct CodeInfo
+{
+  std::uint8_t extra_bits;
+  std::uint16_t base;
+};
+
+// RFC 3.2.5: lengths 3 to 257 are coded with 0 extra bits for the first 8
+// codes and one more extra bit every 4 codes after that. Length 258 has its
+// own code.
+constexpr auto length_infos = [] {
+  constexpr auto kGroup = 4U;
+  auto infos = std::array<CodeInfo, 29>{};
+  auto base = std::uint16_t{min_match};
+  for (auto i = 0U; i != infos.size() - 1; ++i) {
+    const auto extra = i < 2 * kGroup ? 0U : (i / kGroup) - 1U;
+    infos[i] = {.extra_bits = static_cast<std::uint8_t>(extra), .base = base};
+    base = static_cast<std::uint16_t>(base + (1U << extra));
+  }
+  infos.back() = {.extra_bits = 0, .base = max_match};
+  return infos;
+}();
+
+// RFC 3.2.5: distances are coded with 0 extra bits for the first 4 codes and
+// one more extra bit every 2 codes after that.
+constexpr auto distance_infos = [] {
+  constexpr auto kGroup = 2U;
+  auto infos = std::array<CodeInfo, distance_symbols>{};
+  auto base = 1U;
+  for (auto i = 0U; i != infos.size(); ++i) {
+    const auto extra = i < 2 * kGroup ? 0U : (i / kGroup) - 1U;
+    infos[i] = {
+        .extra_bits = static_cast<std::uint8_t>(extra),
+        .base = static_cast<std::uint16_t>(base)};
+    base += 1U << extra;
+  }
+  return infos;
+}();
+
+// index into `length_infos` of each match length
+constexpr auto length_code_indices = [] {
+  auto indices = std::array<std::uint8_t, max_match + 1>{};
+  for (auto i = 0UZ; i != length_infos.size(); ++i) {
+    const auto& info = length_infos[i];
+    const auto end = std::min(
+        std::size_t{info.base} + (std::size_t{1} << info.extra_bits),
+        max_match + 1);
+    for (auto length = std::size_t{info.base}; length != end; ++length) {
+      indices[length] = static_cast<std::uint8_t>(i);
+    }
+  }
+  return indices;
+}();
+
+// Index into `distance_infos` of each distance, as for zlib. Distances up to
+// 256 are looked up directly, longer ones by their bits above the 7th, as
+// their codes have at least 7 extra bits.
+constexpr std::size_t short_distance_max = 256;
+constexpr unsigned long_distance_shift = 7;
+
+constexpr auto distance_code_indices = [] {
+  struct
+  {
+    std::array<std::uint8_t, short_distance_max> short_distances{};
+    std::array<std::uint8_t, (window_size >> long_distance_shift)>
+        long_distances{};
+  } indices;
+  for (auto i = 0UZ; i != distance_infos.size(); ++i) {
+    const auto& info = distance_infos[i];
+    const auto end =
+        std::size_t{info.base} + (std::size_t{1} << info.extra_bits);
+    for (auto distance = std::size_t{info.base}; distance != end; ++distance) {
+      if (distance <= short_distance_max) {
+        indices.short_distances[distance - 1] = static_cast<std::uint8_t>(i);
+      } else {
+        indices.long_distances[(distance - 1) >> long_distance_shift] =
+            static_cast<std::uint8_t>(i);
+      }
+    }
+  }
+  return indices;
+}();
+
+auto distance_code_index(std::size_t distance) -> std::size_t
+{
+  assert(distance != 0 and distance <= window_size);
+  // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+  return distance <= short_distance_max
+             ? distance_code_indices.short_distances[distance - 1]
+             : distance_code_indices
+                   .long_distances[(distance - 1) >> long_distance_shift];
+  // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+}
+
+// RFC 3.2.7: order in which code length code bitsizes are stored
+constexpr auto code_length_order =
+    std::array<std::uint8_t, code_length_symbols>{
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// RFC 3.2.7: code length symbols that repeat a code length
+constexpr std::uint8_t repeat_previous = 16;
+constexpr std::uint8_t repeat_zero = 17;
+constexpr std::uint8_t repeat_zero_long = 18;
+
+/// Writes bits to a buffer, least significant bit first, RFC 3.1.1
+///
+class BitWriter
+{
+  static constexpr unsigned flush_bits = 32;
+
+  std::span<std::byte> dst_;
+  std::size_t written_{};
+  std::uint64_t buffer_{};
+  unsigned buffered_{};
+  bool overflow_{};
+
+  auto put_byte(std::byte byte) -> void
+  {
+    if (written_ == dst_.size()) {
+      overflow_ = true;
+      return;
+    }
+    dst_[written_++] = byte;
+  }
+
+public:
+  explicit BitWriter(std::span<std::byte> dst) : dst_{dst} {}
+
+  /// Writes the low `n` bits of `bits`
+  ///
+  /// @pre n <= 32
+  ///
+  auto put(std::uint32_t bits, unsigned n) -> void
+  {
+    assert(n <= flush_bits and (n == flush_bits or (bits >> n) == 0));
+    buffer_ |= std::uint64_t{bits} << buffered_;
+    buffered_ += n;
+    if (buffered_ < flush_bits) {
+      return;
+    }
+    if (dst_.size() - written_ >= flush_bits / CHAR_BIT) {
+      for (auto i = 0U; i != flush_bits / CHAR_BIT; ++i) {
+        dst_[written_++] = static_cast<std::byte>(buffer_ >> (i * CHAR_BIT));
+      }
+    } else {
+      overflow_ = true;
+    }
+    buffer_ >>= flush_bits;
+    buffered_ -= flush_bits;
+  }
+
+  /// Pads with zero bits to a byte boundary and writes out buffered bits
+  ///
+  auto align() -> void
+  {
+    for (; buffered_ > 0;
+         buffered_ -= std::min(buffered_, unsigned{CHAR_BIT})) {
+      put_byte(static_cast<std::byte>(buffer_));
+      buffer_ >>= CHAR_BIT;
+    }
+  }
+
+  /// Writes whole bytes, after padding to a byte boundary
+  ///
+  auto put_bytes(std::span<const std::byte> bytes) -> void
+  {
+    align();
+    if (dst_.size() - written_ < bytes.size()) {
+      overflow_ = true;
+      return;
+    }
+    std::ranges::copy(bytes, dst_.subspan(written_).begin());
+    written_ += bytes.size();
+  }
+
+  /// Number of bits written
+  ///
+  [[nodiscard]]
+  auto bit_position() const -> std::size_t
+  {
+    return (written_ * CHAR_BIT) + buffered_;
+  }
+
+  /// Number of whole bytes written
+  ///
+  [[nodiscard]]
+  auto written() const -> std::size_t
+  {
+    return written_;
+  }
+
+  /// Returns `true` if the output did not fit in the buffer
+  ///
+  [[nodiscard]]
+  auto overflow() const -> bool
+  {
+    return overflow_;
+  }
+};
+
+/// A Huffman code, with its bits reversed to be written least significant
+/// bit first
+///
+struct Code
+{
+  std::uint16_t bits;
+  std::uint8_t bitsize;
+};
+
+/// Assigns canonical Huffman codes to symbols with the given bitsizes, RFC
+/// 3.2.2
+///
+template <std::size_t N>
+constexpr auto make_codes(const std::array<std::uint8_t, N>& bitsizes)
+    -> std::array<Code, N>
+{
+  auto counts = std::array<std::uint16_t, max_code_bitsize + 1>{};
+  for (const auto bitsize : bitsizes) {
+    ++counts[bitsize];
+  }
+  counts[0] = 0;
+
+  auto next_code = std::array<std::uint16_t, max_code_bitsize + 1>{};
+  auto code = 0U;
+  for (auto bitsize = 1UZ; bitsize != next_code.size(); ++bitsize) {
+    code = (code + counts[bitsize - 1]) << 1U;
+    next_code[bitsize] = static_cast<std::uint16_t>(code);
+  }
+
+  auto codes = std::array<Code, N>{};
+  for (auto symbol = 0UZ; symbol != N; ++symbol) {
+    const auto bitsize = bitsizes[symbol];
+    if (bitsize == 0) {
+      continue;
+    }
+    auto value = next_code[bitsize]++;
+    auto reversed = 0U;
+    for (auto i = 0U; i != bitsize; ++i) {
+      reversed = (reversed << 1U) | (value & 1U);
+      value = static_cast<std::uint16_t>(value >> 1U);
+    }
+    codes[symbol] = {
+        .bits = static_cast<std::uint16_t>(reversed), .bitsize = bitsize};
+  }
+  return codes;
+}
+
+// RFC 3.2.6
+constexpr auto fixed_lit_or_len_bitsizes = [] {
+  constexpr auto kFirst9Bit = 144UZ;
+  constexpr auto kFirst7Bit = 256UZ;
+  constexpr auto kFirst8Bit = 280UZ;
+  auto bitsizes = std::array<std::uint8_t, fixed_lit_or_len_symbols>{};
+  for (auto symbol = 0UZ; symbol != bitsizes.size(); ++symbol) {
+    bitsizes[symbol] = symbol < kFirst9Bit   ? 8
+                       : symbol < kFirst7Bit ? 9
+                       : symbol < kFirst8Bit ? 7
+                                             : 8;
+  }
+  return bitsizes;
+}();
+
+constexpr auto fixed_distance_bitsizes = [] {
+  constexpr std::uint8_t kBitsize = 5;
+  auto bitsizes = std::array<std::uint8_t, distance_symbols>{};
+  bitsizes.fill(kBitsize);
+  return bitsizes;
+}();
+
+constexpr auto fixed_lit_or_len_codes = make_codes(fixed_lit_or_len_bitsizes);
+constexpr auto fixed_distance_codes = make_codes(fixed_distance_bitsizes);
+
+/// Computes Huffman code bitsizes of at most `max_bitsize` for symbols with
+/// the given frequencies
+///
+/// Symbols with a frequency of zero are not assigned a code, except that at
+/// least two symbols are always assigned one, so that the code is complete.
+/// Codes longer than `max_bitsize` are shortened by lengthening shorter
+/// codes, as for zlib.
+///
+template <std::size_t N>
+auto huffman_bitsizes(
+    const std::array<std::uint32_t, N>& frequencies, std::uint8_t max_bitsize)
+    -> std::array<std::uint8_t, N>
+{
+  static_assert(N >= 2);
+
+  // symbols to assign codes to, least frequent first
+  auto leaves = std::array<std::uint16_t, N>{};
+  auto n_leaves = 0UZ;
+  for (auto symbol = 0UZ; symbol != N; ++symbol) {
+    if (frequencies[symbol] != 0) {
+      leaves[n_leaves++] = static_cast<std::uint16_t>(symbol);
+    }
+  }
+  for (auto symbol = 0UZ; n_leaves < 2; ++symbol) {
+    if (frequencies[symbol] == 0) {
+      leaves[n_leaves++] = static_cast<std::uint16_t>(symbol);
+    }
+  }
+  const auto used = std::span{leaves}.first(n_leaves);
+  std::ranges::sort(used, [&frequencies](auto x, auto y) {
+    return std::pair{frequencies[x], x} < std::pair{frequencies[y], y};
+  });
+
+  // Build the Huffman tree with two queues, one of leaves and one of
+  // internal nodes, both in order of increasing weight. Nodes are numbered
+  // with leaves first, and each node records its parent.
+  auto weights = std::array<std::uint64_t, 2 * N>{};
+  auto parents = std::array<std::uint16_t, 2 * N>{};
+  for (auto i = 0UZ; i != n_leaves; ++i) {
+    weights[i] = frequencies[used[i]];
+  }
+  const auto n_nodes = (2 * n_leaves) - 1;
+  auto next_leaf = 0UZ;
+  auto next_internal = n_leaves;
+  for (auto node = n_leaves; node != n_nodes; ++node) {
+    for (auto child = 0; child != 2; ++child) {
+      const auto take_leaf =
+          next_leaf != n_leaves and
+          (next_internal == node or
+           weights[next_leaf] <= weights[next_internal]);
+      const auto smallest = take_leaf ? next_leaf++ : next_internal++;
+      weights[node] += weights[smallest];
+      parents[smallest] = static_cast<std::uint16_t>(node);
+    }
+  }
+
+  // depth of each node, from the root down
+  auto& depths = weights;
+  depths[n_nodes - 1] = 0;
+  for (auto node = n_nodes - 1; node-- != 0;) {
+    depths[node] = depths[parents[node]] + 1;
+  }
+
+  auto counts = std::array<std::size_t, max_code_bitsize + 1>{};
+  for (auto i = 0UZ; i != n_leaves; ++i) {
+    ++counts[std::min(depths[i], std::uint64_t{max_bitsize})];
+  }
+
+  // Sum of 2^-bitsize over all codes, in units of 2^-max_bitsize. It is one
+  // for a complete code.
+  const auto one = std::size_t{1} << max_bitsize;
+  auto kraft_sum = 0UZ;
+  for (auto bitsize = 1U; bitsize <= max_bitsize; ++bitsize) {
+    kraft_sum += counts[bitsize] << (max_bitsize - bitsize);
+  }
+  // lengthen the longest codes shorter than the maximum until the code is
+  // no longer oversubscribed
+  while (kraft_sum > one) {
+    auto bitsize = max_bitsize - 1U;
+    while (counts[bitsize] == 0) {
+      --bitsize;
+    }
+    --counts[bitsize];
+    ++counts[bitsize + 1];
+    kraft_sum -= std::size_t{1} << (max_bitsize - bitsize - 1);
+  }
+  // then shorten the longest codes until it is complete
+  while (kraft_sum < one) {
+    auto bitsize = unsigned{max_bitsize};
+    while (counts[bitsize] == 0) {
+      --bitsize;
+    }
+    --counts[bitsize];
+    ++counts[bitsize - 1];
+    kraft_sum += std::size_t{1} << (max_bitsize - bitsize);
+  }
+
+  // assign the longest codes to the least frequent symbols
+  auto bitsizes = std::array<std::uint8_t, N>{};
+  auto leaf = used.begin();
+  for (auto bitsize = max_bitsize; bitsize != 0; --bitsize) {
+    for (auto i = 0UZ; i != counts[bitsize]; ++i) {
+      bitsizes[*leaf++] = bitsize;
+    }
+  }
+  return bitsizes;
+}
+
+/// A literal, or a match of `length` bytes at `distance` bytes before
+///
+struct Symbol
+{
+  std::uint16_t literal_or_length;
+  // zero for a literal
+  std::uint16_t distance;
+};
+
+/// Symbols of a block and the frequencies of their codes
+///
+struct Block
+{
+  std::vector<Symbol> symbols;
+  std::array<std::uint32_t, lit_or_len_symbols> lit_or_len_frequencies{};
+  std::array<std::uint32_t, distance_symbols> distance_frequencies{};
+  // number of bytes of input the symbols cover
+  std::size_t size{};
+
+  Block()
+  {
+    symbols.reserve(max_block_symbols);
+    clear();
+  }
+
+  auto clear() -> void
+  {
+    symbols.clear();
+    lit_or_len_frequencies.fill(0);
+    distance_frequencies.fill(0);
+    lit_or_len_frequencies[end_of_block] = 1;
+    size = 0;
+  }
+
+  [[nodiscard]]
+  auto full() const -> bool
+  {
+    return symbols.size() == max_block_symbols;
+  }
+
+  auto add_literal(std::byte literal) -> void
+  {
+    const auto value = std::to_integer<std::uint16_t>(literal);
+    symbols.push_back({.literal_or_length = value, .distance = 0});
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    ++lit_or_len_frequencies[value];
+    ++size;
+  }
+
+  auto add_match(std::size_t length, std::size_t distance) -> void
+  {
+    assert(length >= min_match and length <= max_match);
+    symbols.push_back(
+        {.literal_or_length = static_cast<std::uint16_t>(length),
+         .distance = static_cast<std::uint16_t>(distance)});
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+    ++lit_or_len_frequencies[end_of_block + 1U + length_code_indices[length]];
+    ++distance_frequencies[distance_code_index(distance)];
+    // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+    size += length;
+  }
+
+  /// Number of bits needed to encode the symbols with the given code
+  /// bitsizes, excluding the block header
+  ///
+  [[nodiscard]]
+  auto cost(
+      std::span<const std::uint8_t> lit_or_len_bitsizes,
+      std::span<const std::uint8_t> distance_bitsizes) const -> std::size_t
+  {
+    auto bits = 0UZ;
+    for (auto symbol = 0UZ; symbol != lit_or_len_frequencies.size();
+         ++symbol) {
+      auto bitsize = std::size_t{lit_or_len_bitsizes[symbol]};
+      if (symbol > end_of_block) {
+        bitsize += length_infos[symbol - end_of_block - 1].extra_bits;
+      }
+      bits += lit_or_len_frequencies[symbol] * bitsize;
+    }
+    for (auto symbol = 0UZ; symbol != distance_frequencies.size(); ++symbol) {
+      bits += distance_frequencies[symbol] *
+              (std::size_t{distance_bitsizes[symbol]} +
+               distance_infos[symbol].extra_bits);
+    }
+    return bits;
+  }
+};
+
+/// A code length symbol and the value of its extra bits, RFC 3.2.7
+///
+struct CodeLengthToken
+{
+  std::uint8_t symbol;
+  std::uint8_t extra;
+};
+
+// Extra bits of the repeat code length symbols 16, 17 and 18
+constexpr auto code_length_extra_bits = std::array<std::uint8_t, 3>{2, 3, 7};
+constexpr auto code_length_repeat_min = std::array<std::uint8_t, 3>{3, 3, 11};
+constexpr auto code_length_repeat_max = std::array<std::uint8_t, 3>{6, 10, 138};
+
+auto code_length_extra_bitsize(std::uint8_t symbol) -> unsigned
+{
+  if (symbol < repeat_previous) {
+    return 0;
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+  return code_length_extra_bits[symbol - repeat_previous];
+}
+
+/// Dynamic Huffman codes for a block and its encoded header, RFC 3.2.7
+///
+struct DynamicHeader
+{
+  std::array<std::uint8_t, lit_or_len_symbols> lit_or_len_bitsizes{};
+  std::array<std::uint8_t, distance_symbols> distance_bitsizes{};
+  std::array<std::uint8_t, code_length_symbols> code_length_bitsizes{};
+  std::size_t n_lit_or_len{};
+  std::size_t n_distance{};
+  std::size_t n_code_length{};
+  // the code lengths of both codes, run-length encoded
+  std::vector<CodeLengthToken> tokens;
+  // size of the header, excluding the 3 bit block header
+  std::size_t bits{};
+
+  explicit DynamicHeader(const Block& block)
+      : lit_or_len_bitsizes{huffman_bitsizes(
+            block.lit_or_len_frequencies, max_code_bitsize)},
+        distance_bitsizes{
+            huffman_bitsizes(block.distance_frequencies, max_code_bitsize)}
+  {
+    constexpr auto kMinLitOrLen = std::size_t{end_of_block} + 1;
+    constexpr auto kMinCodeLength = 4UZ;
+
+    const auto used = [](std::span<const std::uint8_t> bitsizes,
+                         std::size_t min) {
+      auto n = bitsizes.size();
+      while (n > min and bitsizes[n - 1] == 0) {
+        --n;
+      }
+      return n;
+    };
+    n_lit_or_len = used(lit_or_len_bitsizes, kMinLitOrLen);
+    n_distance = used(distance_bitsizes, 1);
+
+    auto lengths =
+        std::array<std::uint8_t, lit_or_len_symbols + distance_symbols>{};
+    std::ranges::copy(
+        std::span{lit_or_len_bitsizes}.first(n_lit_or_len), lengths.begin());
+    std::ranges::copy(
+        std::span{distance_bitsizes}.first(n_distance),
+        lengths.begin() + static_cast<std::ptrdiff_t>(n_lit_or_len));
+    tokenize(std::span{lengths}.first(n_lit_or_len + n_distance));
+
+    auto frequencies = std::array<std::uint32_t, code_length_symbols>{};
+    for (const auto& token : tokens) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      ++frequencies[token.symbol];
+    }
+    code_length_bitsizes =
+        huffman_bitsizes(frequencies, max_code_length_bitsize);
+
+    auto order = std::array<std::uint8_t, code_length_symbols>{};
+    std::ranges::transform(
+        code_length_order, order.begin(), [this](auto symbol) {
+          // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+          return code_length_bitsizes[symbol];
+        });
+    n_code_length = used(order, kMinCodeLength);
+
+    // HLIT, HDIST, HCLEN and the code length code bitsizes
+    constexpr auto kCountsBits = 5UZ + 5UZ + 4UZ;
+    constexpr auto kCodeLengthBitsizeBits = 3UZ;
+    bits = kCountsBits + (kCodeLengthBitsizeBits * n_code_length);
+    for (const auto& token : tokens) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      bits += code_length_bitsizes[token.symbol] +
+              code_length_extra_bitsize(token.symbol);
+    }
+  }
+
+  /// Run-length encodes code lengths with the repeat symbols 16, 17 and 18
+  ///
+  auto tokenize(std::span<const std::uint8_t> lengths) -> void
+  {
+    const auto add_repeats = [this](std::uint8_t symbol, std::size_t count) {
+      const auto index = symbol - repeat_previous;
+      // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+      const auto min = code_length_repeat_min[index];
+      const auto max = code_length_repeat_max[index];
+      // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+      for (; count >= min; count -= std::min<std::size_t>(count, max)) {
+        const auto n = std::min<std::size_t>(count, max);
+        tokens.push_back(
+            {.symbol = symbol, .extra = static_cast<std::uint8_t>(n - min)});
+      }
+      return count;
+    };
+
+    for (auto i = 0UZ; i != lengths.size();) {
+      const auto length = lengths[i];
+      auto run = 1UZ;
+      while (i + run != lengths.size() and lengths[i + run] == length) {
+        ++run;
+      }
+      i += run;
+
+      if (length == 0) {
+        run = add_repeats(repeat_zero_long, run);
+        run = add_repeats(repeat_zero, run);
+      } else {
+        tokens.push_back({.symbol = length, .extra = 0});
+        run = add_repeats(repeat_previous, run - 1);
+      }
+      tokens.insert(tokens.end(), run, {.symbol = length, .extra = 0});
+    }
+  }
+
+  auto write(BitWriter& out) const -> void
+  {
+    constexpr auto kMinCodeLength = 4U;
+    out.put(static_cast<std::uint32_t>(n_lit_or_len - end_of_block - 1), 5);
+    out.put(static_cast<std::uint32_t>(n_distance - 1), 5);
+    out.put(static_cast<std::uint32_t>(n_code_length - kMinCodeLength), 4);
+    for (const auto symbol :
+         std::span{code_length_order}.first(n_code_length)) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      out.put(code_length_bitsizes[symbol], 3);
+    }
+
+    const auto codes = make_codes(code_length_bitsizes);
+    for (const auto& token : tokens) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      const auto& code = codes[token.symbol];
+      out.put(code.bits, code.bitsize);
+      out.put(token.extra, code_length_extra_bitsize(token.symbol));
+    }
+  }
+};
+
+auto write_block_header(BitWriter& out, bool final, BlockType type) -> void
+{
+  out.put(
+      (std::uint32_t{std::to_underlying(type)} << 1U) | (final ? 1U : 0U), 3);
+}
+
+/// Number of bits needed to write `size` bytes as stored blocks, starting at
+/// bit `position`
+///
+auto stored_cost(std::size_t position, std::size_t size) -> std::size_t
+{
+  constexpr auto kLenBits = 2UZ * 16UZ;
+  constexpr auto kHeaderBits = 3UZ;
+  const auto n_blocks =
+      std::max(1UZ, (size + max_stored_size - 1) / max_stored_size);
+  // the first header may start mid-byte; the rest start on a byte boundary
+  const auto first_header_end = position + kHeaderBits;
+  const auto first_padding =
+      (CHAR_BIT - (first_header_end % CHAR_BIT)) % CHAR_BIT;
+  return kHeaderBits + first_padding +
+         ((n_blocks - 1) * CHAR_BIT) + (n_blocks * kLenBits) +
+         (size * CHAR_BIT);
+}
+
+/// Writes `bytes` as stored blocks, RFC 3.2.4
+///
+auto write_stored(BitWriter& out, std::span<const std::byte> bytes, bool final)
+    -> void
+{
+  constexpr auto kLenBits = 16U;
+  do {
+    const auto part = bytes.first(std::min(bytes.size(), max_stored_size));
+    bytes = bytes.subspan(part.size());
+    write_block_header(out, final and bytes.empty(), BlockType::NoCompression);
+    out.align();
+    const auto len = static_cast<std::uint32_t>(part.size());
+    out.put(len, kLenBits);
+    out.put(~len & 0xFFFFU, kLenBits);
+    out.put_bytes(part);
+  } while (not bytes.empty());
+}
+
+/// Writes the symbols of a block and its end-of-block code
+///
+auto write_symbols(
+    BitWriter& out,
+    const Block& block,
+    std::span<const Code> lit_or_len_codes,
+    std::span<const Code> distance_codes) -> void
+{
+  for (const auto& symbol : block.symbols) {
+    if (symbol.distance == 0) {
+      const auto& code = lit_or_len_codes[symbol.literal_or_length];
+      out.put(code.bits, code.bitsize);
+      continue;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    const auto length_index = length_code_indices[symbol.literal_or_length];
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    const auto& length_info = length_infos[length_index];
+    const auto& length_code =
+        lit_or_len_codes[end_of_block + 1U + length_index];
+    out.put(
+        length_code.bits |
+            (static_cast<std::uint32_t>(
+                 symbol.literal_or_length - length_info.base)
+             << length_code.bitsize),
+        length_code.bitsize + length_info.extra_bits);
+
+    const auto distance_index = distance_code_index(symbol.distance);
+    const auto& distance_info = distance_infos[distance_index];
+    const auto& distance_code = distance_codes[distance_index];
+    out.put(
+        distance_code.bits |
+            (static_cast<std::uint32_t>(symbol.distance - distance_info.base)
+             << distance_code.bitsize),
+        distance_code.bitsize + distance_info.extra_bits);
+  }
+  const auto& code = lit_or_len_codes[end_of_block];
+  out.put(code.bits, code.bitsize);
+}
+
+/// Writes a block as stored, fixed or dynamic Huffman, whichever is smallest
+/// of those allowed by `strategy`
+///
+/// @param bytes The input covered by the block's symbols.
+///
+auto write_block(
+    BitWriter& out,
+    const Block& block,
+    std::span<const std::byte> bytes,
+    bool final,
+    Strategy strategy) -> void
+{
+  assert(bytes.size() == block.size);
+  constexpr auto kHeaderBits = 3UZ;
+
+  if (strategy == Strategy::Fixed) {
+    if (stored_cost(out.bit_position(), bytes.size()) <=
+        kHeaderBits +
+            block.cost(fixed_lit_or_len_bitsizes, fixed_distance_bitsizes)) {
+      write_stored(out, bytes, final);
+    } else {
+      write_block_header(out, final, BlockType::FixedHuffman);
+      write_symbols(out, block, fixed_lit_or_len_codes, fixed_distance_codes);
+    }
+    return;
+  }
+
+  const auto dynamic = DynamicHeader{block};
+  const auto dynamic_cost =
+      kHeaderBits + dynamic.bits +
+      block.cost(dynamic.lit_or_len_bitsizes, dynamic.distance_bitsizes);
+  const auto fixed_cost =
+      kHeaderBits +
+      block.cost(fixed_lit_or_len_bitsizes, fixed_distance_bitsizes);
+
+  if (stored_cost(out.bit_position(), bytes.size()) <=
+      std::min(fixed_cost, dynamic_cost)) {
+    write_stored(out, bytes, final);
+  } else if (fixed_cost <= dynamic_cost) {
+    write_block_header(out, final, BlockType::FixedHuffman);
+    write_symbols(out, block, fixed_lit_or_len_codes, fixed_distance_codes);
+  } else {
+    write_block_header(out, final, BlockType::DynamicHuffman);
+    dynamic.write(out);
+    write_symbols(
+        out,
+        block,
+        make_codes(dynamic.lit_or_len_bitsizes),
+        make_codes(dynamic.distance_bitsizes));
+  }
+}
+
+auto load_u64(std::span<const std::byte> data) -> std::uint64_t
+{
+  std::uint64_t word{};
+  std::memcpy(&word, data.data(), sizeof(word));
+  return word;
+}
+
+auto load_u32(std::span<const std::byte> data) -> std::uint32_t
+{
+  std::uint32_t word{};
+  std::memcpy(&word, data.data(), sizeof(word));
+  return word;
+}
+
+/// Number of equal bytes at the start of `x` and `y`, up to `max`
+///
+/// @pre x.size() >= max and y.size() >= max
+///
+auto common_prefix(
+    std::span<const std::byte> x, std::span<const std::byte> y, std::size_t max)
+    -> std::size_t
+{
+  auto n = 0UZ;
+  for (; n + sizeof(std::uint64_t) <= max; n += sizeof(std::uint64_t)) {
+    const auto diff = load_u64(x.subspan(n)) ^ load_u64(y.subspan(n));
+    if (diff != 0) {
+      const auto equal_bits = std::endian::native == std::endian::little
+                                  ? std::countr_zero(diff)
+                                  : std::countl_zero(diff);
+      return n + (static_cast<std::size_t>(equal_bits) / CHAR_BIT);
+    }
+  }
+  while (n != max and x[n] == y[n]) {
+    ++n;
+  }
+  return n;
+}
+
+struct Match
+{
+  std::size_t length;
+  std::size_t distance;
+};
+
+/// LZ77 compressor for a segment of input, with hash chains, as for zlib
+///
+/// The segment is preceded by up to a window of history, which is searched
+/// for matches but not compressed.
+///
+class Deflater
+{
+  const LevelParams& params_;
+  Strategy strategy_;
+  BitWriter& out_;
+  Block& block_;
+  std::span<const std::byte> data_;
+  std::size_t block_start_;
+
+  // Positions are relative to the start of `data_`. Position 0 is never a
+  // match candidate, so zero marks the end of a chain.
+  //
+  // most recent position with each hash
+  std::vector<std::uint32_t> head_;
+  // previous position with the same hash, for each position in the window
+  std::vector<std::uint32_t> prev_;
+
+  [[nodiscard]]
+  auto hash(std::size_t pos) const -> std::size_t
+  {
+    constexpr auto kMultiplier = 0x9E37'79B1U;
+    constexpr auto kMinMatchMask = (1U << (min_match * CHAR_BIT)) - 1U;
+    auto bytes = std::uint32_t{};
+    if (data_.size() - pos >= sizeof(std::uint32_t)) {
+      bytes = load_u32(data_.subspan(pos));
+      if constexpr (std::endian::native == std::endian::big) {
+        bytes = std::byteswap(bytes);
+      }
+    } else {
+      for (auto i = 0UZ; i != min_match; ++i) {
+        bytes |= std::to_integer<std::uint32_t>(data_[pos + i])
+                 << (i * CHAR_BIT);
+      }
+    }
+    return ((bytes & kMinMatchMask) * kMultiplier) >>
+           (sizeof(std::uint32_t) * CHAR_BIT - hash_bits);
+  }
+
+  /// Inserts `pos` into its hash chain
+  ///
+  /// @return The previous position with the same hash, or 0 if there is
+  ///     none or fewer than `min_match` bytes remain.
+  ///
+  auto insert(std::size_t pos) -> std::size_t
+  {
+    if (data_.size() - pos < min_match) {
+      return 0;
+    }
+    auto& head = head_[hash(pos)];
+    const auto prev = head;
+    prev_[pos & window_mask] = prev;
+    head = static_cast<std::uint32_t>(pos);
+    return prev;
+  }
+
+  /// Finds the longest match for `pos` that is longer than `min_length`,
+  /// starting with `candidate`
+  ///
+  /// @return The match, or a length of `min_length` if none is longer.
+  ///
+  [[nodiscard]]
+  auto longest_match(
+      std::size_t pos, std::size_t candidate, std::size_t min_length) const
+      -> Match
+  {
+    const auto max_length = std::min(max_match, data_.size() - pos);
+    auto best = Match{.length = min_length, .distance = 0};
+    if (best.length >= max_length) {
+      return best;
+    }
+    const auto limit = pos > max_distance ? pos - max_distance : 0;
+    const auto nice_length =
+        std::min<std::size_t>(params_.nice_length, max_length);
+    auto chain = std::size_t{params_.max_chain};
+    if (min_length >= params_.good_length) {
+      chain >>= 2U;
+    }
+
+    const auto current = data_.subspan(pos);
+    for (; candidate > limit and chain != 0;
+         candidate = prev_[candidate & window_mask], --chain) {
+      const auto previous = data_.subspan(candidate);
+      // a longer match must differ from the best one at its last byte
+      if (previous[best.length] != current[best.length]) {
+        continue;
+      }
+      const auto length = common_prefix(previous, current, max_length);
+      if (length > best.length) {
+        best = {.length = length, .distance = pos - candidate};
+        if (length >= nice_length) {
+          break;
+        }
+      }
+    }
+    return best;
+  }
+
+  auto flush_block_if_full() -> void
+  {
+    if (block_.full()) {
+      write_block(
+          out_,
+          block_,
+          data_.subspan(block_start_, block_.size),
+          false,
+          strategy_);
+      block_start_ += block_.size;
+      block_.clear();
+    }
+  }
+
+  auto add_literal(std::size_t pos) -> void
+  {
+    block_.add_literal(data_[pos]);
+    flush_block_if_full();
+  }
+
+  auto add_match(const Match& match) -> void
+  {
+    block_.add_match(match.length, match.distance);
+    flush_block_if_full();
+  }
+
+  /// Emits the first match found at each position
+  ///
+  auto compress_greedy(std::size_t pos) -> void
+  {
+    while (pos != data_.size()) {
+      const auto candidate = insert(pos);
+      const auto match = candidate == 0
+                             ? Match{.length = 0, .distance = 0}
+                             : longest_match(pos, candidate, min_match - 1);
+      if (match.length < min_match) {
+        add_literal(pos++);
+        continue;
+      }
+      add_match(match);
+      const auto end = pos + match.length;
+      if (match.length <= params_.max_lazy) {
+        while (++pos != end) {
+          insert(pos);
+        }
+      }
+      pos = end;
+    }
+  }
+
+  /// Emits a match at a position only if the next position does not have a
+  /// longer one
+  ///
+  auto compress_lazy(std::size_t pos) -> void
+  {
+    auto match = Match{.length = min_match - 1, .distance = 0};
+    // whether the byte before `pos` has yet to be emitted
+    auto pending = false;
+    while (pos != data_.size()) {
+      const auto candidate = insert(pos);
+      const auto prev_match = match;
+      match = {.length = min_match - 1, .distance = 0};
+      if (candidate != 0 and prev_match.length < params_.max_lazy) {
+        match = longest_match(pos, candidate, prev_match.length);
+        if (match.distance == 0) {
+          match.length = min_match - 1;
+        } else if (match.length == min_match and match.distance > too_far) {
+          match = {.length = min_match - 1, .distance = 0};
+        }
+      }
+
+      if (prev_match.length >= min_match and
+          match.length <= prev_match.length) {
+        // the match found at the previous position is at least as long
+        add_match(prev_match);
+        const auto end = pos - 1 + prev_match.length;
+        while (++pos != end) {
+          insert(pos);
+        }
+        pending = false;
+        match = {.length = min_match - 1, .distance = 0};
+      } else {
+        if (pending) {
+          add_literal(pos - 1);
+        }
+        pending = true;
+        ++pos;
+      }
+    }
+    if (pending) {
+      add_literal(pos - 1);
+    }
+  }
+
+public:
+  /// @param data The history followed by the input to compress.
+  /// @param start The offset of the input in `data`.
+  ///
+  Deflater(
+      const LevelParams& params,
+      Strategy strategy,
+      BitWriter& out,
+      Block& block,
+      std::span<const std::byte> data,
+      std::size_t start)
+      : params_{params},
+        strategy_{strategy},
+        out_{out},
+        block_{block},
+        data_{data},
+        block_start_{start},
+        head_(hash_size),
+        prev_(window_size)
+  {
+    assert(start <= window_size and data.size() <= max_segment_size);
+  }
+
+  /// Compresses the input, writing all but the last block
+  ///
+  /// @return The input covered by the last block, which is in `block`.
+  ///
+  auto compress() -> std::span<const std::byte>
+  {
+    const auto start = block_start_;
+    for (auto pos = 0UZ; pos != start; ++pos) {
+      insert(pos);
+    }
+    if (params_.lazy) {
+      compress_lazy(start);
+    } else {
+      compress_greedy(start);
+    }
+    return data_.subspan(block_start_);
+  }
+};
+
+}  // namespace
+
+auto compress_bound(std::size_t src_size) -> std::size_t
+{
+  // Each block is no larger than if it were stored. Every block but the last
+  // covers at least `max_block_symbols` bytes, and a stored block needs at
+  // most 42 bits in addition to its data, plus a byte to end the stream. The
+  // bound on the number of blocks is loose enough to also cover the empty
+  // stored block ending a part compressed with `Flush::Sync`.
+  constexpr auto kStoredOverhead = 6UZ;
+  const auto n_blocks = (src_size / max_block_symbols) + 1 +
+                        (src_size / max_stored_size) + 1 +
+                        (src_size / max_segment_size) + 1;
+  return src_size + (kStoredOverhead * n_blocks) + 1;
+}
+
+auto compress(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    std::uint8_t level,
+    Strategy strategy) -> CompressResult
+{
+  return compress_part(src, 0, dst, level, Flush::Finish, strategy);
+}
+
+auto compress_part(
+    std::span<const std::byte> src,
+    std::size_t history_size,
+    std::span<std::byte> dst,
+    std::uint8_t level,
+    Flush flush,
+    Strategy strategy) -> CompressResult
+{
+  assert(history_size <= src.size());
+  if (level > max_compress_level) {
+    return {.status = CompressStatus::InvalidLevel, .dst_written = 0};
+  }
+
+  const auto final = flush == Flush::Finish;
+  auto out = BitWriter{dst};
+  if (level == 0) {
+    write_stored(out, src.subspan(history_size), final);
+  } else {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    const auto& params = level_params[level];
+    auto block = Block{};
+    auto segment_start = history_size;
+    do {
+      const auto history = std::min(segment_start, window_size);
+      const auto segment_end =
+          std::min(src.size(), segment_start + max_segment_size - history);
+      const auto data = src.subspan(
+          segment_start - history, segment_end - segment_start + history);
+      const auto last =
+          Deflater{params, strategy, out, block, data, history}.compress();
+      write_block(
+          out, block, last, final and segment_end == src.size(), strategy);
+      block.clear();
+      segment_start = segment_end;
+    } while (segment_start != src.size());
+  }
+  if (not final) {
+    write_stored(out, {}, false);
+  }
+  out.align();
+
+  if (out.overflow()) {
+    return {
+        .status = CompressStatus::DstTooSmall, .dst_written = out.written()};
+  }
+  return {.status = CompressStatus::Success, .dst_written = out.written()};
+}
+
+}  // namespace starflate
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace starflate {
+
+enum class CompressStatus : std::uint8_t
+{
+  Success,
+  DstTooSmall,
+  InvalidLevel,
+  InvalidChunkSize,
+};
+
+/// Compression levels, from fastest to smallest output, as for zlib
+///
+/// Level 0 only stores the input. Levels 1 to 3 emit the first match found
+/// at each position. Higher levels use lazy matching, deferring a match when
+/// the next position has a longer one. Each level searches more of the hash
+/// chains than the one before.
+///
+/// @{
+inline constexpr std::uint8_t min_compress_level = 0;
+inline constexpr std::uint8_t max_compress_level = 9;
+inline constexpr std::uint8_t default_compress_level = 6;
+/// @}
+
+/// How the codes of Huffman blocks are chosen, as for zlib
+///
+/// Whatever the strategy, a block is stored if that is smaller.
+///
+enum class Strategy : std::uint8_t
+{
+  /// Fixed or dynamic Huffman codes, whichever is smaller
+  Default,
+  /// Fixed Huffman codes only, as for zlib's Z_FIXED
+  Fixed,
+};
+
+/// Result of compressing into a destination buffer
+///
+struct CompressResult
+{
+  CompressStatus status;
+  std::size_t dst_written;
+};
+
+/// Returns the maximum size of the compressed data for `src_size` bytes
+///
+/// A destination buffer of this size is large enough for any input of this
+/// size at any level, including a part compressed by `compress_part`.
+///
+auto compress_bound(std::size_t src_size) -> std::size_t;
+
+/// Compresses the given source data into a DEFLATE stream, RFC 1951
+///
+/// Each block is emitted as stored, fixed Huffman or dynamic Huffman,
+/// whichever is smallest of those allowed by `strategy`.
+///
+/// @param src The data to compress.
+/// @param dst The destination buffer for the stream.
+/// @param level The compression level, from `min_compress_level` to
+///     `max_compress_level`.
+/// @param strategy How the codes of Huffman blocks are chosen.
+/// @return The number of bytes written to `dst`, with a status of:
+///     * `Success` if all of `src` was compressed.
+///     * `DstTooSmall` if the stream does not fit in `dst`.
+///     * `InvalidLevel` if `level` is out of range.
+///
+auto compress(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    std::uint8_t level = default_compress_level,
+    Strategy strategy = Strategy::Default) -> CompressResult;
+
+/// How `compress_part` ends its output
+///
+enum class Flush : std::uint8_t
+{
+  /// With a final block, ending the stream
+  Finish,
+  /// With an empty stored block, as for zlib's Z_SYNC_FLUSH. The output ends
+  /// on a byte boundary without ending the stream, so the output of the next
+  /// part can be appended to it.
+  Sync,
+};
+
+/// Maximum number of bytes of history that the output of `compress_part` may
+/// refer to, the maximum distance of a back-reference, RFC 3.2.5
+///
+inline constexpr std::size_t max_history_size = 32768;
+
+/// Compresses part of a DEFLATE stream
+///
+/// The output of consecutive parts, all but the last compressed with
+/// `Flush::Sync`, concatenates into a single stream. It depends only on the
+/// input, the history provided, the level and the flush mode, so parts can be
+/// compressed independently and in any order.
+///
+/// @param src The part to compress, preceded by `history_size` bytes of
+///     history. Back-references may refer to the last `max_history_size`
+///     bytes of history, which must be the data preceding the part in the
+///     stream.
+/// @param history_size The number of bytes of history at the start of `src`.
+/// @param dst The destination buffer. `compress_bound` of the size of the part
+///     is large enough.
+/// @param level The compression level, as for `compress`.
+/// @param flush How to end the output.
+/// @param strategy As for `compress`.
+/// @return As for `compress`.
+///
+auto compress_part(
+    std::span<const std::byte> src,
+    std::size_t history_size,
+    std::span<std::byte> dst,
+    std::uint8_t level,
+    Flush flush,
+    Strategy strategy = Strategy::Default) -> CompressResult;
+
+}  // namespace starflate
@@ -1,6 +1,15 @@
 #include "decompress.hpp"
 
+#include "src/huffman_table_cache.hpp"
+
+#include <algorithm>
+#include <climits>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
 
 namespace starflate {
 namespace detail {
@@ -39,6 +48,23 @@ constexpr auto fixed_dist_table = huffman::table<
     std::uint16_t,
     fixed_dist_table_size>{huffman::symbol_bitsize, {{{0, 31}, 5}}};
 
+// Bitsizes used to index the primary lookup tables of decode tables. Longer
+// codes use secondary tables. The capacities of the tables of dynamic blocks
+// in decompress.hpp depend on them.
+constexpr std::uint8_t len_primary_bitsize = 9;
+constexpr std::uint8_t dist_primary_bitsize = 6;
+constexpr std::uint8_t code_length_primary_bitsize = 7;
+
+// The longest fixed codes are 9 and 5 bits, so the decode tables for fixed
+// Huffman blocks consist of only a primary table.
+constexpr auto fixed_len_decode_table =
+    huffman::decode_table<std::uint16_t, std::size_t{1} << len_primary_bitsize>{
+        fixed_len_table, len_primary_bitsize};
+
+constexpr auto fixed_dist_decode_table =
+    huffman::decode_table<std::uint16_t, fixed_dist_table_size>{
+        fixed_dist_table, dist_primary_bitsize};
+
 struct LengthInfo
 {
   std::uint8_t extra_bits;
@@ -47,10 +73,14 @@ struct LengthInfo
 
 constexpr auto lit_or_len_end_of_block = std::uint16_t{256};
 constexpr auto lit_or_len_max = std::uint16_t{285};
-constexpr auto lit_or_len_max_decoded = std::uint16_t{258};
+constexpr auto length_max = std::size_t{258};
+
+// a 15-bit length code, 5 extra length bits, a 15-bit distance code and 13
+// extra distance bits
+constexpr std::uint8_t max_length_distance_bits = 48;
 
 // RFC 3.2.5: Compressed blocks (length and distance codes)
-constexpr auto length_infos = std::array<LengthInfo, 28>{
+constexpr auto length_infos = std::array<LengthInfo, 29>{
     {{.extra_bits = 0, .base = 3},   {.extra_bits = 0, .base = 4},
      {.extra_bits = 0, .base = 5},   {.extra_bits = 0, .base = 6},
      {.extra_bits = 0, .base = 7},   {.extra_bits = 0, .base = 8},
@@ -64,7 +94,8 @@ constexpr auto length_infos = std::array<LengthInfo, 28>{
      {.extra_bits = 4, .base = 67},  {.extra_bits = 4, .base = 83},
      {.extra_bits = 4, .base = 99},  {.extra_bits = 4, .base = 115},
      {.extra_bits = 5, .base = 131}, {.extra_bits = 5, .base = 163},
-     {.extra_bits = 5, .base = 195}, {.extra_bits = 5, .base = 227}}};
+     {.extra_bits = 5, .base = 195}, {.extra_bits = 5, .base = 227},
+     {.extra_bits = 0, .base = 258}}};
 
 constexpr auto distance_infos = std::array<LengthInfo, 30>{
     {{.extra_bits = 0, .base = 1},      {.extra_bits = 0, .base = 2},
@@ -83,311 +114,858 @@ constexpr auto distance_infos = std::array<LengthInfo, 30>{
      {.extra_bits = 12, .base = 8193},  {.extra_bits = 12, .base = 12289},
      {.extra_bits = 13, .base = 16385}, {.extra_bits = 13, .base = 24577}}};
 
+/// Returns the `InflateTable` entry for a literal/length symbol
+///
+constexpr auto lit_or_len_entry(std::uint16_t symbol, std::uint8_t bitsize)
+    -> InflateEntry
+{
+  using enum InflateEntry::Kind;
+  if (symbol < lit_or_len_end_of_block) {
+    return {Literal, symbol, bitsize};
+  }
+  if (symbol == lit_or_len_end_of_block) {
+    return {EndOfBlock, symbol, bitsize};
+  }
+  if (symbol > lit_or_len_max) {
+    return {Invalid, symbol, bitsize};
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+  const auto& info = length_infos[symbol - lit_or_len_end_of_block - 1U];
+  return {Base, info.base, bitsize, info.extra_bits};
+}
+
+/// Returns the `InflateTable` entry for a distance symbol
+///
+constexpr auto distance_entry(std::uint16_t symbol, std::uint8_t bitsize)
+    -> InflateEntry
+{
+  using enum InflateEntry::Kind;
+  if (symbol >= distance_infos.size()) {
+    return {Invalid, symbol, bitsize};
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+  const auto& info = distance_infos[symbol];
+  return {Base, info.base, bitsize, info.extra_bits};
+}
+
+// Generated at compile time, so fixed Huffman blocks build no tables
+constexpr auto fixed_tables = FixedHuffmanTables{
+    .len_table = {fixed_len_decode_table, lit_or_len_entry},
+    .dist_table = {fixed_dist_decode_table, distance_entry}};
+
 /// Removes n bits from the beginning of bits and returns them.
 ///
-/// @pre bits contains at least n bits.
 /// @pre n <= 16 for T = uint16_t, n <= 8 for T = uint8_t
 ///
 /// @returns the n bits removed from the beginning of this.
 /// The bits are in the lower (rightmost) part of the return value.
 ///
 template <class T>
-auto pop_bits(huffman::bit_span& bits, std::uint8_t n) -> T
+auto pop_bits(huffman::bit_reader& bits, std::uint8_t n) -> T
 {
-  if constexpr (std::is_same_v<T, std::uint16_t>) {
-    assert(n <= 16);
-  } else if constexpr (std::is_same_v<T, std::uint8_t>) {
-    assert(n <= 8);
-  } else {
-    static_assert(
-        std::is_same_v<T, std::uint16_t> || std::is_same_v<T, std::uint8_t>,
-        "pop_extra_bits only supports uint8_t and uint16_t");
-  }
-  auto iter = bits.begin();
-  T res{};
-  for (std::uint8_t i{}; i < n; i++) {
-    res |= static_cast<T>(static_cast<T>(static_cast<bool>(*iter)) << i);
-    iter += 1;
-  }
-  bits.consume(n);  // invalidates iter, so must come after the loop
-  return res;
+  static_assert(
+      std::is_same_v<T, std::uint16_t> || std::is_same_v<T, std::uint8_t>,
+      "pop_bits only supports uint8_t and uint16_t");
+  assert(n <= std::numeric_limits<T>::digits);
+  return static_cast<T>(bits.pop(n));
 }
 
-enum class DecodeLitOrLenStatus : std::uint8_t
+/// Returns `n` bits of `bits`, starting at bit `offset`
+///
+auto extract_bits(std::uint64_t bits, std::size_t offset, std::uint8_t n)
+    -> std::uint16_t
 {
-  EndOfBlock,
-  Error,
-};
+  return static_cast<std::uint16_t>(
+      (bits >> offset) & ((std::uint64_t{1} << n) - 1U));
+}
 
-auto decode_lit_or_len(
-    std::uint16_t lit_or_len, huffman::bit_span& src_bits) -> std::
-    expected<std::variant<std::byte, std::uint16_t>, DecodeLitOrLenStatus>
+/// Returns the number of buffered bits that are part of the input
+///
+auto available_bits(const huffman::bit_reader& bits) -> std::size_t
 {
-  if (lit_or_len < detail::lit_or_len_end_of_block) {
-    return static_cast<std::byte>(lit_or_len);
+  return std::min(std::size_t{bits.buffered()}, bits.size());
+}
+
+/// Finds the code at the start of `bits` and its extra bits, of which
+/// `available` bits are input
+///
+/// @return the table entry for the code, `SrcTooSmall` if the code or its
+///     extra bits extend past the available bits, or `invalid` if `bits`
+///     does not start with a valid code.
+///
+template <class Table>
+auto find_code(
+    const Table& table,
+    std::uint64_t bits,
+    std::size_t available,
+    DecompressStatus invalid) -> std::expected<InflateEntry, DecompressStatus>
+{
+  if (table.empty()) {
+    return std::unexpected{invalid};
   }
-  if (lit_or_len == detail::lit_or_len_end_of_block) {
-    return std::unexpected{DecodeLitOrLenStatus::EndOfBlock};
+  const auto entry = table.find(bits);
+  if (entry.bitsize() == 0) {
+    // input that has not been provided yet may complete the code
+    return std::unexpected{
+        available < table.max_bitsize() ? DecompressStatus::SrcTooSmall
+                                         : invalid};
   }
-  if (lit_or_len > detail::lit_or_len_max) {
-    return std::unexpected{DecodeLitOrLenStatus::Error};
+  if (std::size_t{entry.bitsize()} + entry.extra_bits() > available) {
+    return std::unexpected{DecompressStatus::SrcTooSmall};
   }
-  if (lit_or_len == detail::lit_or_len_max) {
-    return detail::lit_or_len_max_decoded;
+  if (entry.kind() == InflateEntry::Kind::Invalid) {
+    return std::unexpected{invalid};
   }
-  const auto len_code =
-      static_cast<size_t>(lit_or_len - detail::lit_or_len_end_of_block - 1);
-  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-  const auto& len_info = detail::length_infos[len_code];
-  const auto extra_len = pop_bits<std::uint16_t>(src_bits, len_info.extra_bits);
-  return static_cast<std::uint16_t>(len_info.base + extra_len);
+  return entry;
 }
 
-auto decompress_literal(
-    std::byte literal, std::span<std::byte> dst, std::ptrdiff_t& dst_written)
-    -> DecompressStatus
+auto next_block(InflateState& state) -> void
 {
-  if (dst.size() - static_cast<std::size_t>(dst_written) < 1) {
-    return DecompressStatus::DstTooSmall;
-  }
-  dst[static_cast<size_t>(dst_written++)] = literal;
-  return DecompressStatus::Success;
+  state.step =
+      state.final ? InflateState::Step::Done : InflateState::Step::Header;
 }
 
-template <std::size_t Extent>
-auto decompress_length_distance(
-    std::uint16_t len,
-    huffman::bit_span& src_bits,
-    std::span<std::byte> dst,
-    std::ptrdiff_t& dst_written,
-    const huffman::table<std::uint16_t, Extent>& dist_table) -> DecompressStatus
+auto inflate_header(InflateState& state) -> DecompressStatus
 {
-  const auto dist_code_huff_decoded = huffman::decode_one(dist_table, src_bits);
-  const auto dist_code = dist_code_huff_decoded.symbol();
-  if (not dist_code_huff_decoded.has_value()) {
-    return DecompressStatus::InvalidDistance;
-  }
-  src_bits.consume(dist_code_huff_decoded.encoded_size());
-  if (dist_code >= detail::distance_infos.size()) {
-    return DecompressStatus::InvalidLitOrLen;
+  using enum BlockType;
+  using Step = InflateState::Step;
+
+  constexpr std::size_t kHeaderBits = 3;
+  if (state.src_bits.size() < kHeaderBits) {
+    return DecompressStatus::SrcTooSmall;
   }
-  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-  const auto& dist_info = detail::distance_infos[dist_code];
-  const std::uint16_t distance =
-      dist_info.base + pop_bits<std::uint16_t>(src_bits, dist_info.extra_bits);
-  if (distance > dst_written) {
-    return DecompressStatus::InvalidDistance;
+  const auto header = read_header(state.src_bits);
+  if (not header) {
+    return header.error();
   }
-  if (dst.size() - static_cast<std::size_t>(dst_written) < len) {
-    return DecompressStatus::DstTooSmall;
+  state.final = header->final;
+  state.type = header->type;
+  switch (header->type) {
+    case NoCompression:
+      state.step = Step::StoredHeader;
+      break;
+    case FixedHuffman:
+      state.step = Step::Block;
+      break;
+    case DynamicHuffman:
+      state.step = Step::DynamicHeader;
+      break;
   }
-  starflate::detail::copy_from_before(distance, dst.begin() + dst_written, len);
-  dst_written += len;
   return DecompressStatus::Success;
 }
 
-template <class... Ts>
-struct overloaded : Ts...
+auto inflate_stored_header(InflateState& state) -> DecompressStatus
 {
-  using Ts::operator()...;
-};
-template <class... Ts>
-overloaded(Ts...) -> overloaded<Ts...>;
-
-template <std::size_t LenExtent, std::size_t DistExtent>
-auto decompress_block_huffman(
-    huffman::bit_span& src_bits,
-    std::span<std::byte> dst,
-    std::ptrdiff_t& dst_written,
-    const huffman::table<std::uint16_t, LenExtent>& len_table,
-    const huffman::table<std::uint16_t, DistExtent>& dist_table)
+  auto& src_bits = state.src_bits;
+
+  // Any bits of input up to the next byte boundary are ignored.
+  src_bits.consume_to_byte_boundary();
+  constexpr std::uint8_t kLenBits = 16;
+  if (src_bits.size() < std::size_t{2 * kLenBits}) {
+    return DecompressStatus::SrcTooSmall;
+  }
+  const auto len = pop_bits<std::uint16_t>(src_bits, kLenBits);
+  const auto nlen = pop_bits<std::uint16_t>(src_bits, kLenBits);
+  if (len != static_cast<std::uint16_t>(~nlen)) {
+    return DecompressStatus::NoCompressionLenMismatch;
+  }
+  state.stored_len = len;
+  state.step = InflateState::Step::Stored;
+  return DecompressStatus::Success;
+}
+
+auto inflate_stored(InflateState& state, InflateOutput& output)
     -> DecompressStatus
 {
-  while (true) {
-    // There are two levels of encoding:
-    // 1. Huffman coding. This is the outer level, which we decode first
-    //    using huffman::decode_one.
-    // 2. The literal/length code. This is the inner level, which we decode
-    //    second using the length_infos and distance_infos arrays.
-    const auto lit_or_len_code_huff_decoded =
-        huffman::decode_one(len_table, src_bits);
-    // If we decide to supoort chunked input, this will no longer be an error.
-    if (not lit_or_len_code_huff_decoded.has_value()) {
-      return DecompressStatus::InvalidLitOrLen;
-    }
-    src_bits.consume(lit_or_len_code_huff_decoded.encoded_size());
-    const auto maybe_lit_or_len =
-        decode_lit_or_len(lit_or_len_code_huff_decoded.symbol(), src_bits);
-    if (not maybe_lit_or_len) {
-      if (maybe_lit_or_len.error() == DecodeLitOrLenStatus::EndOfBlock) {
-        return DecompressStatus::Success;
-      }
-      return DecompressStatus::InvalidLitOrLen;
+  auto& src_bits = state.src_bits;
+
+  // The data starts on a byte boundary, so no bits remain buffered.
+  src_bits.unbuffer();
+  while (state.stored_len != 0) {
+    const auto src_size = src_bits.size() / CHAR_BIT;
+    if (src_size == 0) {
+      return DecompressStatus::SrcTooSmall;
     }
-    const auto status = std::visit(
-        overloaded{
-            [&](std::byte literal) -> DecompressStatus {
-              return decompress_literal(literal, dst, dst_written);
-            },
-            [&](std::uint16_t len) -> DecompressStatus {
-              return decompress_length_distance(
-                  len, src_bits, dst, dst_written, dist_table);
-            }},
-        maybe_lit_or_len.value());
-    if (status != DecompressStatus::Success) {
-      return status;
+    const auto dst = std::span{output.dst}.subspan(output.written);
+    if (dst.empty()) {
+      return DecompressStatus::DstTooSmall;
     }
+    const auto n =
+        std::min({std::size_t{state.stored_len}, src_size, dst.size()});
+    std::copy_n(src_bits.next_byte(), n, dst.begin());
+    src_bits.skip_bytes(n);
+    output.written += n;
+    state.stored_len = static_cast<std::uint16_t>(state.stored_len - n);
   }
+  next_block(state);
   return DecompressStatus::Success;
 }
 
-struct DynamicHuffmanTables
+/// Returns `true` if `bitsizes` describe a complete code, or at most one code
+///
+/// As with zlib, other incomplete codes are rejected, which bounds the size of
+/// their decode tables. Oversubscribed codes are not prefix codes.
+///
+auto valid_code(std::span<const std::uint8_t> bitsizes) -> bool
 {
-  huffman::table<std::uint16_t, std::dynamic_extent> len_table;
-  huffman::table<std::uint16_t, std::dynamic_extent> dist_table;
-};
+  constexpr std::uint8_t kMaxBitsize = 15;
+  auto kraft_sum = std::size_t{};
+  auto n_codes = std::size_t{};
+  for (const auto bitsize : bitsizes) {
+    if (bitsize != 0) {
+      kraft_sum += std::size_t{1} << (kMaxBitsize - bitsize);
+      ++n_codes;
+    }
+  }
+  return kraft_sum == (std::size_t{1} << kMaxBitsize) or n_codes <= 1;
+}
 
 constexpr std::array<std::uint8_t, 19> code_length_symbols = {
     16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
-auto decode_dynamic_huffman_table(
-    huffman::bit_span& src_bits,
-    const huffman::table<std::uint8_t>& code_length_table,
-    std::uint16_t n_codes)
-    -> std::expected<huffman::table<std::uint16_t>, DecompressStatus>
+auto inflate_dynamic_header(InflateState& state) -> DecompressStatus
+{
+  // RFC 3.2.7: Dynamic Huffman codes
+  constexpr std::uint8_t kHLitBits = 5;
+  constexpr std::uint8_t kHDistBits = 5;
+  constexpr std::uint8_t kHCLenBits = 4;
+  if (state.src_bits.size() <
+      std::size_t{kHLitBits + kHDistBits + kHCLenBits}) {
+    return DecompressStatus::SrcTooSmall;
+  }
+
+  const auto h_lit = pop_bits<std::uint8_t>(state.src_bits, kHLitBits);
+  state.n_len_codes = 257 + h_lit;
+
+  const auto h_dist = pop_bits<std::uint8_t>(state.src_bits, kHDistBits);
+  state.n_dist_codes = 1 + h_dist;
+
+  const auto h_c_len = pop_bits<std::uint8_t>(state.src_bits, kHCLenBits);
+  state.n_code_length_codes = 4 + h_c_len;
+
+  state.code_length_bitsizes = {};
+  state.index = 0;
+  state.step = InflateState::Step::CodeLengthCodes;
+  return DecompressStatus::Success;
+}
+
+auto inflate_code_length_codes(InflateState& state) -> DecompressStatus
+{
+  assert(state.n_code_length_codes <= code_length_symbols.size());
+  constexpr std::uint8_t kCodeLengthBits = 3;
+  for (; state.index < state.n_code_length_codes; ++state.index) {
+    if (state.src_bits.size() < kCodeLengthBits) {
+      return DecompressStatus::SrcTooSmall;
+    }
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+    state.code_length_bitsizes[code_length_symbols[state.index]] =
+        pop_bits<std::uint8_t>(state.src_bits, kCodeLengthBits);
+    // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+  }
+
+  if (not valid_code(state.code_length_bitsizes)) {
+    return DecompressStatus::InvalidLitOrLen;
+  }
+  // The primary table is indexed by as many bits as the longest code, so it
+  // is repeated to index the lookup table by 7 bits.
+  const auto table =
+      huffman::decode_table<std::uint8_t, max_code_length_table_size>{
+          huffman::code_bitsizes,
+          state.code_length_bitsizes,
+          code_length_primary_bitsize};
+  const auto entries = table.entries();
+  state.code_length_table = {};
+  for (auto i = 0UZ; i != state.code_length_table.size() and
+                     not entries.empty();
+       ++i) {
+    const auto& entry = entries[i % entries.size()];
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    state.code_length_table[i] = {
+        .symbol = entry.symbol, .bitsize = entry.bitsize};
+  }
+
+  state.index = 0;
+  state.step = InflateState::Step::CodeLengths;
+  return DecompressStatus::Success;
+}
+
+auto inflate_code_lengths(InflateState& state) -> DecompressStatus
 {
   constexpr std::uint8_t kRepeatPrevSymbol = 16;
   constexpr std::uint8_t kRepeat0For3BitsSymbol = 17;
   constexpr std::uint8_t kRepeat0For7BitsSymbol = 18;
-  std::vector<std::uint8_t> code_bitsizes(n_codes);
-  for (std::uint16_t i = 0; i < n_codes; i++) {
-    const auto length_code = huffman::decode_one(code_length_table, src_bits);
-    if (not length_code.has_value()) {
-      return std::unexpected{DecompressStatus::InvalidLitOrLen};
-    }
-    src_bits.consume(length_code.encoded_size());
-    if (length_code.symbol() == 0) {
-      code_bitsizes[i] = 0;
-    } else if (length_code.symbol() < kRepeatPrevSymbol) {
-      code_bitsizes[i] = length_code.symbol();
-    } else if (length_code.symbol() == kRepeatPrevSymbol) {
-      constexpr std::uint8_t kRepeatCountBits = 2;
-      const std::uint8_t repeat_count =
-          pop_bits<std::uint8_t>(src_bits, kRepeatCountBits) + 3;
-      for (std::uint8_t j = 0; j < repeat_count; j++) {
-        code_bitsizes[i + j] = code_bitsizes[i - 1];
-      }
-      i += static_cast<std::uint16_t>(repeat_count - std::uint8_t{1});
-    } else if (length_code.symbol() == kRepeat0For3BitsSymbol) {
-      constexpr std::uint8_t kRepeatCountBits = 3;
-      const std::uint8_t repeat_count =
-          pop_bits<std::uint8_t>(src_bits, kRepeatCountBits) + 3;
-      for (std::uint8_t j = 0; j < repeat_count; j++) {
-        code_bitsizes[i + j] = 0;
-      }
-      i += static_cast<std::uint16_t>(repeat_count - std::uint8_t{1});
-    } else if (length_code.symbol() == kRepeat0For7BitsSymbol) {
-      constexpr std::uint8_t kRepeatCountBits = 7;
-      const std::uint8_t repeat_count =
-          pop_bits<std::uint8_t>(src_bits, kRepeatCountBits) + 11;
-      for (std::uint8_t j = 0; j < repeat_count; j++) {
-        code_bitsizes[i + j] = 0;
+  // a 7-bit code followed by up to 7 repeat count bits
+  constexpr std::uint8_t kMaxCodeLengthBits = 14;
+
+  auto& src_bits = state.src_bits;
+  // Lengths of literal/length codes are followed by lengths of distance
+  // codes. Repeats may cross from one to the other.
+  const std::size_t n_codes = state.n_len_codes + state.n_dist_codes;
+
+  while (state.index < n_codes) {
+    if (src_bits.buffered() < kMaxCodeLengthBits) {
+      src_bits.refill();
+    }
+    const auto available = available_bits(src_bits);
+    const auto bits = src_bits.peek(kMaxCodeLengthBits);
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    const auto length_code = state.code_length_table[extract_bits(
+        bits, 0, code_length_primary_bitsize)];
+    if (length_code.bitsize == 0) {
+      // input that has not been provided yet may complete the code
+      return available < code_length_primary_bitsize
+                 ? DecompressStatus::SrcTooSmall
+                 : DecompressStatus::InvalidLitOrLen;
+    }
+    if (length_code.bitsize > available) {
+      return DecompressStatus::SrcTooSmall;
+    }
+    if (length_code.symbol < kRepeatPrevSymbol) {
+      src_bits.consume(length_code.bitsize);
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      state.code_bitsizes[state.index++] = length_code.symbol;
+      continue;
+    }
+
+    auto bitsize = std::uint8_t{};
+    auto repeat_count_bits = std::uint8_t{};
+    auto repeat_count_base = std::uint8_t{};
+    if (length_code.symbol == kRepeatPrevSymbol) {
+      if (state.index == 0) {
+        return DecompressStatus::InvalidLitOrLen;
       }
-      i += static_cast<std::uint16_t>(repeat_count - std::uint8_t{1});
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      bitsize = state.code_bitsizes[state.index - 1U];
+      repeat_count_bits = 2;
+      repeat_count_base = 3;
+    } else if (length_code.symbol == kRepeat0For3BitsSymbol) {
+      repeat_count_bits = 3;
+      repeat_count_base = 3;
+    } else if (length_code.symbol == kRepeat0For7BitsSymbol) {
+      repeat_count_bits = 7;
+      repeat_count_base = 11;
     } else {
-      return std::unexpected{DecompressStatus::InvalidLitOrLen};
+      return DecompressStatus::InvalidLitOrLen;
+    }
+
+    const auto n_bits =
+        static_cast<std::uint8_t>(length_code.bitsize + repeat_count_bits);
+    if (n_bits > available) {
+      return DecompressStatus::SrcTooSmall;
     }
+    const auto repeat_count =
+        std::size_t{repeat_count_base} +
+        extract_bits(bits, length_code.bitsize, repeat_count_bits);
+    if (repeat_count > n_codes - state.index) {
+      return DecompressStatus::InvalidLitOrLen;
+    }
+    src_bits.consume(n_bits);
+    std::ranges::fill(
+        std::span{state.code_bitsizes}.subspan(state.index, repeat_count),
+        bitsize);
+    state.index = static_cast<std::uint16_t>(state.index + repeat_count);
   }
-  std::vector<std::pair<huffman::symbol_span<std::uint16_t>, std::uint8_t>>
-      symbol_bitsize_pairs{};
-  for (std::uint16_t i = 0; i < n_codes; i++) {
-    if (code_bitsizes[i] == 0) {
-      continue;
+
+  const auto code_bitsizes = std::span{state.code_bitsizes};
+  const auto len_bitsizes = code_bitsizes.first(state.n_len_codes);
+  const auto dist_bitsizes =
+      code_bitsizes.subspan(state.n_len_codes, state.n_dist_codes);
+  if (not valid_code(len_bitsizes) or not valid_code(dist_bitsizes)) {
+    return DecompressStatus::InvalidLitOrLen;
+  }
+  state.cached_tables =
+      state.table_cache != nullptr
+          ? state.table_cache->find(len_bitsizes, dist_bitsizes)
+          : nullptr;
+  if (state.cached_tables == nullptr) {
+    state.tables = DynamicHuffmanTables{
+        .len_table = InflateTable<max_len_table_size>{
+            huffman::decode_table<std::uint16_t, max_len_table_size>{
+                huffman::code_bitsizes, len_bitsizes, len_primary_bitsize},
+            lit_or_len_entry},
+        .dist_table = InflateTable<max_dist_table_size>{
+            huffman::decode_table<std::uint16_t, max_dist_table_size>{
+                huffman::code_bitsizes, dist_bitsizes, dist_primary_bitsize},
+            distance_entry}};
+    if (state.table_cache != nullptr) {
+      state.table_cache->insert(len_bitsizes, dist_bitsizes, state.tables);
     }
-    symbol_bitsize_pairs.emplace_back(
-        huffman::symbol_span<std::uint16_t>{i}, code_bitsizes[i]);
   }
-  return huffman::table<std::uint16_t>{
-      huffman::symbol_bitsize, symbol_bitsize_pairs};
+  state.step = InflateState::Step::Block;
+  return DecompressStatus::Success;
 }
 
-auto decode_dynamic_huffman_tables(huffman::bit_span& src_bits)
-    -> std::expected<DynamicHuffmanTables, DecompressStatus>
+/// Copies as much of the pending match as fits in the output
+///
+auto copy_match(InflateState& state, InflateOutput& output) -> DecompressStatus
 {
-  // RFC 3.2.7: Dynamic Huffman codes
-  constexpr std::uint8_t kHLitBits = 5;
-  const auto h_lit = pop_bits<std::uint8_t>(src_bits, kHLitBits);
-  const std::uint16_t n_len_codes = 257 + h_lit;
+  const auto distance = std::size_t{state.match_distance};
+  const auto n = std::min(
+      std::size_t{state.match_len}, output.dst.size() - output.written);
+  auto dst = std::span{output.dst}.subspan(output.written, n);
 
-  constexpr std::uint8_t kHDistBits = 5;
-  const auto h_dist = pop_bits<std::uint8_t>(src_bits, kHDistBits);
-  const std::uint16_t n_dist_codes = 1 + h_dist;
+  if (distance > output.written) {
+    // the start of the match precedes dst
+    const auto n_history = std::min(n, distance - output.written);
+    std::ranges::copy(
+        output.history.last(distance - output.written).first(n_history),
+        dst.begin());
+    dst = dst.subspan(n_history);
+  }
+  const auto n_from_dst = static_cast<std::uint16_t>(dst.size());
+  if (output.dst.size() - output.written - n >= copy_slack) {
+    copy_from_before_with_slack(state.match_distance, dst.begin(), n_from_dst);
+  } else {
+    copy_from_before(state.match_distance, dst.begin(), n_from_dst);
+  }
 
-  constexpr std::uint8_t kHCLenBits = 4;
-  const auto h_c_len = pop_bits<std::uint8_t>(src_bits, kHCLenBits);
-  const std::uint16_t n_c_len_codes = 4 + h_c_len;
+  output.written += n;
+  state.match_len = static_cast<std::uint16_t>(state.match_len - n);
+  if (state.match_len != 0) {
+    state.step = InflateState::Step::Match;
+    return DecompressStatus::DstTooSmall;
+  }
+  state.step = InflateState::Step::Block;
+  return DecompressStatus::Success;
+}
 
-  assert(n_c_len_codes <= code_length_symbols.size());
-  std::array<std::uint8_t, code_length_symbols.size()> code_length_bitsizes{};
-  constexpr std::uint8_t kCodeLengthBits = 3;
-  for (std::uint16_t i = 0; i < n_c_len_codes; i++) {
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-    code_length_bitsizes[i] = pop_bits<std::uint8_t>(src_bits, kCodeLengthBits);
+/// Decompresses the symbols of a Huffman block while there is enough input
+/// and output space for any symbol
+///
+/// Neither is checked per symbol, and matches are copied in whole words.
+///
+/// @return `Success` at the end of the block or once input or output space
+///     runs low, otherwise an error status.
+///
+template <class LenTable, class DistTable>
+auto inflate_block_fast(
+    InflateState& state,
+    InflateOutput& output,
+    const LenTable& len_table,
+    const DistTable& dist_table) -> DecompressStatus
+{
+  using Kind = InflateEntry::Kind;
+
+  // refill loads a whole word, which has enough bits for any symbol
+  constexpr auto kMinInput = sizeof(std::uint64_t);
+  constexpr auto kMinOutput = length_max + copy_slack;
+
+  if (len_table.empty() or output.dst.size() - output.written < kMinOutput) {
+    return DecompressStatus::Success;
   }
-  std::vector<std::pair<huffman::symbol_span<std::uint8_t>, std::uint8_t>>
-      code_length_symbol_bitsize_pairs{};
-  for (std::size_t i = 0; i < code_length_symbols.size(); i++) {
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-    if (code_length_bitsizes[i] == 0) {
+
+  // Work on copies, which stores to the output cannot alias.
+  auto src_bits = state.src_bits;
+  auto written = output.written;
+  const auto dst = output.dst;
+  const auto written_max = dst.size() - kMinOutput;
+  auto status = DecompressStatus::Success;
+
+  while (written <= written_max and src_bits.unbuffered_bytes() >= kMinInput) {
+    src_bits.refill();
+    const auto bits = src_bits.peek(max_length_distance_bits);
+
+    const auto lit_or_len = len_table.find(bits);
+    if (lit_or_len.kind() == Kind::Literal) {
+      src_bits.consume(lit_or_len.bitsize());
+      dst[written++] = static_cast<std::byte>(lit_or_len.value());
       continue;
     }
-    code_length_symbol_bitsize_pairs.emplace_back(
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-        huffman::symbol_span<std::uint8_t>{code_length_symbols[i]},
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-        code_length_bitsizes[i]);
+    if (lit_or_len.kind() == Kind::EndOfBlock) {
+      src_bits.consume(lit_or_len.bitsize());
+      next_block(state);
+      break;
+    }
+    if (lit_or_len.kind() != Kind::Base) {
+      status = DecompressStatus::InvalidLitOrLen;
+      break;
+    }
+
+    auto n_bits = std::size_t{lit_or_len.bitsize()};
+    const auto len = static_cast<std::uint16_t>(
+        lit_or_len.value() +
+        extract_bits(bits, n_bits, lit_or_len.extra_bits()));
+    n_bits += lit_or_len.extra_bits();
+
+    if (dist_table.empty()) {
+      status = DecompressStatus::InvalidDistance;
+      break;
+    }
+    const auto dist_code = dist_table.find(bits >> n_bits);
+    if (dist_code.kind() != Kind::Base) {
+      status = DecompressStatus::InvalidDistance;
+      break;
+    }
+    n_bits += dist_code.bitsize();
+    const auto distance = static_cast<std::uint16_t>(
+        dist_code.value() +
+        extract_bits(bits, n_bits, dist_code.extra_bits()));
+    n_bits += dist_code.extra_bits();
+    src_bits.consume(static_cast<std::uint8_t>(n_bits));
+
+    if (distance <= written) {
+      copy_from_before_with_slack(
+          distance,
+          dst.begin() + static_cast<std::ptrdiff_t>(written),
+          len);
+      written += len;
+      continue;
+    }
+
+    // the match starts before dst
+    if (distance > written + output.history.size()) {
+      status = DecompressStatus::InvalidDistance;
+      break;
+    }
+    output.written = written;
+    state.match_len = len;
+    state.match_distance = distance;
+    status = copy_match(state, output);
+    written = output.written;
+    if (status != DecompressStatus::Success) {
+      break;
+    }
   }
-  const auto code_length_table = huffman::table<std::uint8_t>{
-      huffman::symbol_bitsize, code_length_symbol_bitsize_pairs};
 
-  auto len_table =
-      decode_dynamic_huffman_table(src_bits, code_length_table, n_len_codes);
-  if (not len_table) {
-    return std::unexpected{len_table.error()};
+  state.src_bits = src_bits;
+  output.written = written;
+  return status;
+}
+
+/// Decompresses the symbols of a Huffman block
+///
+/// Symbols are decompressed by `inflate_block_fast` until input or output
+/// space runs low. The remaining symbols are decompressed one at a time,
+/// checking that each is complete and fits in the output.
+///
+template <class LenTable, class DistTable>
+auto inflate_block(
+    InflateState& state,
+    InflateOutput& output,
+    const LenTable& len_table,
+    const DistTable& dist_table) -> DecompressStatus
+{
+  if (const auto status =
+          inflate_block_fast(state, output, len_table, dist_table);
+      status != DecompressStatus::Success or
+      state.step != InflateState::Step::Block) {
+    return status;
   }
 
-  auto dist_table =
-      decode_dynamic_huffman_table(src_bits, code_length_table, n_dist_codes);
-  if (not dist_table) {
-    return std::unexpected{dist_table.error()};
+  auto& src_bits = state.src_bits;
+  while (true) {
+    if (src_bits.buffered() < max_length_distance_bits) {
+      src_bits.refill();
+    }
+    const auto available = available_bits(src_bits);
+    const auto bits = src_bits.peek(max_length_distance_bits);
+
+    // There are two levels of encoding:
+    // 1. Huffman coding. This is the outer level, which we decode first
+    //    using the decode tables.
+    // 2. The literal/length code. This is the inner level, which the table
+    //    entries decode as well, into a literal or a base length or distance
+    //    plus extra bits.
+    // All bits of a symbol are checked to be available before any are
+    // consumed, so decompression can resume at the symbol once more input
+    // is provided.
+    const auto lit_or_len = find_code(
+        len_table, bits, available, DecompressStatus::InvalidLitOrLen);
+    if (not lit_or_len) {
+      return lit_or_len.error();
+    }
+    if (lit_or_len->kind() == InflateEntry::Kind::Literal) {
+      if (output.written == output.dst.size()) {
+        return DecompressStatus::DstTooSmall;
+      }
+      src_bits.consume(lit_or_len->bitsize());
+      output.dst[output.written++] =
+          static_cast<std::byte>(lit_or_len->value());
+      continue;
+    }
+    if (lit_or_len->kind() == InflateEntry::Kind::EndOfBlock) {
+      src_bits.consume(lit_or_len->bitsize());
+      next_block(state);
+      return DecompressStatus::Success;
+    }
+
+    auto n_bits = std::size_t{lit_or_len->bitsize()};
+    const auto len = static_cast<std::uint16_t>(
+        lit_or_len->value() +
+        extract_bits(bits, n_bits, lit_or_len->extra_bits()));
+    n_bits += lit_or_len->extra_bits();
+
+    const auto dist_code = find_code(
+        dist_table,
+        bits >> n_bits,
+        available - n_bits,
+        DecompressStatus::InvalidDistance);
+    if (not dist_code) {
+      return dist_code.error();
+    }
+    n_bits += dist_code->bitsize();
+    const auto distance = static_cast<std::uint16_t>(
+        dist_code->value() +
+        extract_bits(bits, n_bits, dist_code->extra_bits()));
+    n_bits += dist_code->extra_bits();
+    if (std::size_t{distance} > output.written + output.history.size()) {
+      return DecompressStatus::InvalidDistance;
+    }
+
+    src_bits.consume(static_cast<std::uint8_t>(n_bits));
+    state.match_len = len;
+    state.match_distance = distance;
+    if (const auto status = copy_match(state, output);
+        status != DecompressStatus::Success) {
+      return status;
+    }
   }
+}
 
-  return DynamicHuffmanTables{
-      .len_table = std::move(*len_table), .dist_table = std::move(*dist_table)};
+auto inflate_step(InflateState& state, InflateOutput& output)
+    -> DecompressStatus
+{
+  using Step = InflateState::Step;
+
+  switch (state.step) {
+    case Step::Header:
+      return inflate_header(state);
+    case Step::StoredHeader:
+      return inflate_stored_header(state);
+    case Step::Stored:
+      return inflate_stored(state, output);
+    case Step::DynamicHeader:
+      return inflate_dynamic_header(state);
+    case Step::CodeLengthCodes:
+      return inflate_code_length_codes(state);
+    case Step::CodeLengths:
+      return inflate_code_lengths(state);
+    case Step::Block:
+      if (state.type == BlockType::FixedHuffman) {
+        return inflate_block(
+            state, output, fixed_tables.len_table, fixed_tables.dist_table);
+      }
+      return inflate_block(
+          state,
+          output,
+          state.dynamic_tables().len_table,
+          state.dynamic_tables().dist_table);
+    case Step::Match:
+      return copy_match(state, output);
+    case Step::Done:
+      break;
+  }
+  return DecompressStatus::Success;
 }
+
 }  // namespace
 
-auto read_header(huffman::bit_span& compressed_bits)
+auto read_header(huffman::bit_reader& compressed_bits)
     -> std::expected<BlockHeader, DecompressStatus>
 {
-  if (std::ranges::size(compressed_bits) < 3) {
+  constexpr std::uint8_t kHeaderBits = 3;
+  if (compressed_bits.size() < kHeaderBits) {
     return std::unexpected{DecompressStatus::InvalidBlockHeader};
   }
-  auto type = static_cast<BlockType>(
-      std::uint8_t{static_cast<bool>(compressed_bits[1])} |
-      (std::uint8_t{static_cast<bool>(compressed_bits[2])} << 1));
+  if (compressed_bits.buffered() < kHeaderBits) {
+    compressed_bits.refill();
+  }
+  const auto bits = compressed_bits.peek(kHeaderBits);
+  auto type = static_cast<BlockType>(bits >> 1U);
   if (not valid(type)) {
     return std::unexpected{DecompressStatus::InvalidBlockHeader};
   }
-  const bool final{static_cast<bool>(compressed_bits[0])};
-  compressed_bits.consume(3);
+  const bool final{static_cast<bool>(bits & 1U)};
+  compressed_bits.consume(kHeaderBits);
   return BlockHeader{.final = final, .type = type};
 }
 
+auto read_header(huffman::bit_span& compressed_bits)
+    -> std::expected<BlockHeader, DecompressStatus>
+{
+  auto reader = huffman::bit_reader{compressed_bits};
+  const auto header = read_header(reader);
+  if (header) {
+    compressed_bits = reader.bits();
+  }
+  return header;
+}
+
+auto decode_dynamic_huffman_tables(InflateState& state) -> DecompressStatus
+{
+  using Step = InflateState::Step;
+
+  state.type = BlockType::DynamicHuffman;
+  state.step = Step::DynamicHeader;
+  // the header steps produce no output
+  auto output = InflateOutput{};
+  while (state.step != Step::Block) {
+    if (const auto status = inflate_step(state, output);
+        status != DecompressStatus::Success) {
+      return status;
+    }
+  }
+  return DecompressStatus::Success;
+}
+
+auto fixed_huffman_tables() -> const FixedHuffmanTables&
+{
+  return fixed_tables;
+}
+
+auto inflate(InflateState& state, InflateOutput& output) -> DecompressStatus
+{
+  while (state.step != InflateState::Step::Done) {
+    if (const auto status = inflate_step(state, output);
+        status != DecompressStatus::Success) {
+      return status;
+    }
+  }
+  return DecompressStatus::Success;
+}
+
+auto window_history(std::span<const std::byte> buffer, std::size_t end)
+    -> std::span<const std::byte>
+{
+  return buffer.first(end).last(std::min(end, window_size));
+}
+
+auto slide_window(std::span<std::byte> buffer, std::size_t& end) -> void
+{
+  const auto kept = window_history(buffer, end);
+  std::ranges::copy(kept, buffer.begin());
+  end = kept.size();
+}
+
+auto append_to_window(
+    std::span<std::byte> buffer,
+    std::size_t& end,
+    std::span<const std::byte> output) -> void
+{
+  if (output.size() >= window_size) {
+    std::ranges::copy(output.last(window_size), buffer.begin());
+    end = window_size;
+    return;
+  }
+  if (output.size() > buffer.size() - end) {
+    slide_window(buffer, end);
+  }
+  std::ranges::copy(output, buffer.subspan(end).begin());
+  end += output.size();
+}
+
+auto OutputHistory::view() const -> std::span<const std::byte>
+{
+  return window_history(buffer_, end_);
+}
+
+auto OutputHistory::append(std::span<const std::byte> output) -> void
+{
+  append_to_window(buffer_, end_, output);
+}
+
+auto inflate_to_block_end(InflateState& state, InflateOutput& output)
+    -> DecompressStatus
+{
+  using Step = InflateState::Step;
+
+  do {
+    if (const auto status = inflate_step(state, output);
+        status != DecompressStatus::Success) {
+      return status;
+    }
+  } while (state.step != Step::Header and state.step != Step::Done);
+  return DecompressStatus::Success;
+}
+
+namespace {
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+constexpr std::size_t word_size = sizeof(std::uint64_t);
+
+/// Copies a word from src to dst.
+///
+/// The word is loaded before it is stored, so it may be copied from bytes
+/// that immediately precede dst.
+auto copy_word(const std::byte* src, std::byte* dst) -> void
+{
+  std::uint64_t word{};
+  std::memcpy(&word, src, word_size);
+  std::memcpy(dst, &word, word_size);
+}
+
+/// Copies n bytes from (dst - distance) to dst for distance < word_size,
+/// rounding n up to a multiple of word_size.
+auto replicate_pattern(std::byte* dst, std::size_t distance, std::size_t n)
+    -> void
+{
+  assert(distance != 0 and distance < word_size);
+  if (n == 0) {
+    return;
+  }
+
+  // the first word of the output repeats the pattern of distance bytes
+  std::array<std::byte, word_size> word{};
+  for (auto i = 0UZ; i != word_size; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    word[i] = *(dst - distance + (i % distance));
+  }
+
+  if (word_size % distance == 0) {
+    // distances 1, 2 and 4: every word is the same
+    for (auto i = 0UZ; i < n; i += word_size) {
+      std::memcpy(dst + i, word.data(), word_size);
+    }
+    return;
+  }
+
+  // Other distances: each word is copied from a multiple of distance bytes
+  // earlier that is at least a word earlier, so it is already written.
+  const auto stride = distance * ((word_size + distance - 1) / distance);
+  std::memcpy(dst, word.data(), word_size);
+  for (auto i = word_size; i < n; i += word_size) {
+    copy_word(dst + i - stride, dst + i);
+  }
+}
+
+/// Copies n bytes from (dst - distance) to dst in words of Size bytes,
+/// rounding n up to a multiple of Size.
+template <std::size_t Size>
+auto copy_chunks(std::byte* dst, std::size_t distance, std::size_t n) -> void
+{
+  assert(distance >= Size);
+  for (auto i = 0UZ; i < n; i += Size) {
+    std::memcpy(dst + i, dst + i - distance, Size);
+  }
+}
+
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+}  // namespace
+
 /// Copy n bytes from distance bytes before dst to dst.
 void copy_from_before(
     std::uint16_t distance, std::span<std::byte>::iterator dst, std::uint16_t n)
 {
+  auto* const out = std::to_address(dst);
+  if (distance >= n) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    std::memcpy(out, out - distance, n);
+    return;
+  }
+  if (distance < word_size) {
+    const auto n_words = n - (n % word_size);
+    replicate_pattern(out, distance, n_words);
+    for (auto i = n_words; i != n; ++i) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      out[i] = out[i - distance];
+    }
+    return;
+  }
+
+  // Each copy doubles the length of the repeated pattern.
   std::ptrdiff_t n_signed{n};
   const auto src = dst - distance;
   while (n_signed > 0) {
@@ -397,67 +975,114 @@ void copy_from_before(
   }
 }
 
+void copy_from_before_with_slack(
+    std::uint16_t distance, std::span<std::byte>::iterator dst, std::uint16_t n)
+{
+  auto* const out = std::to_address(dst);
+  constexpr std::size_t kHalfSlack = copy_slack / 2;
+  if (distance >= copy_slack) {
+    copy_chunks<copy_slack>(out, distance, n);
+  } else if (distance >= kHalfSlack) {
+    copy_chunks<kHalfSlack>(out, distance, n);
+  } else if (distance >= word_size) {
+    copy_chunks<word_size>(out, distance, n);
+  } else {
+    replicate_pattern(out, distance, n);
+  }
+}
+
 }  // namespace detail
 
 auto decompress(std::span<const std::byte> src, std::span<std::byte> dst)
     -> DecompressStatus
 {
-  using enum detail::BlockType;
-
-  huffman::bit_span src_bits{src};
-  // will always be > 0, but signed type to minimize conversions.
-  std::ptrdiff_t dst_written{};
-  for (bool was_final = false; not was_final;) {
-    const auto header = detail::read_header(src_bits);
-    if (not header) {
-      return header.error();
-    }
-    was_final = header->final;
-    if (header->type == NoCompression) {  // no compression
-      // Any bits of input up to the next byte boundary are ignored.
-      src_bits.consume_to_byte_boundary();
-      const std::uint16_t len = src_bits.pop_16();
-      const std::uint16_t nlen = src_bits.pop_16();
-      if (len != static_cast<std::uint16_t>(~nlen)) {
-        return DecompressStatus::NoCompressionLenMismatch;
-      }
-      // Surprisingly size() does not return size_t on libstdc++ 13, hence cast.
-      if (static_cast<size_t>(src_bits.size()) <
-          std::size_t{len} * std::size_t{CHAR_BIT}) {
-        return DecompressStatus::SrcTooSmall;
-      }
+  auto state = detail::InflateState{
+      .src_bits = huffman::bit_reader{huffman::bit_span{src}}};
+  auto output = detail::InflateOutput{.dst = dst};
+  const auto status = detail::inflate(state, output);
 
-      if (dst.size() - static_cast<std::size_t>(dst_written) < len) {
-        return DecompressStatus::DstTooSmall;
-      }
+  // src is the entire stream, so a missing block header is invalid.
+  if (status == DecompressStatus::SrcTooSmall and
+      state.step == detail::InflateState::Step::Header) {
+    return DecompressStatus::InvalidBlockHeader;
+  }
+  return status;
+}
 
-      std::copy_n(src_bits.byte_data(), len, dst.begin() + dst_written);
-      src_bits.consume(CHAR_BIT * len);
-      dst_written += len;
-    } else if (header->type == FixedHuffman) {
-      const auto block_status = detail::decompress_block_huffman(
-          src_bits,
-          dst,
-          dst_written,
-          detail::fixed_len_table,
-          detail::fixed_dist_table);
-      if (block_status != DecompressStatus::Success) {
-        return block_status;
-      }
-    } else {
-      const auto maybe_tables = detail::decode_dynamic_huffman_tables(src_bits);
-      if (not maybe_tables) {
-        return maybe_tables.error();
-      }
-      const auto& tables = *maybe_tables;
-      const auto block_status = detail::decompress_block_huffman(
-          src_bits, dst, dst_written, tables.len_table, tables.dist_table);
-      if (block_status != DecompressStatus::Success) {
-        return block_status;
-      }
-    }
+Decompressor::Decompressor(HuffmanTableCache& cache)
+{
+  state_.table_cache = &cache;
+}
+
+auto Decompressor::history() const -> std::span<const std::byte>
+{
+  return detail::window_history(window_, window_end_);
+}
+
+auto Decompressor::inflate(
+    std::span<const std::byte> src, detail::InflateOutput& output)
+    -> DecompressResult
+{
+  auto& src_bits = state_.src_bits;
+  src_bits.set_input(src.data(), src.size());
+
+  const auto status = detail::inflate(state_, output);
+
+  if (status == DecompressStatus::SrcTooSmall) {
+    // All remaining bits are part of the stream. Keep them until the next
+    // call provides the rest.
+    src_bits.refill();
+  } else {
+    // Return unneeded input so the caller can provide it again with the next
+    // call, or use the bytes following the end of the stream.
+    src_bits.unbuffer();
   }
-  return DecompressStatus::Success;
+
+  return {
+      .status = status,
+      .src_consumed =
+          static_cast<std::size_t>(src_bits.next_byte() - src.data()),
+      .dst_written = output.written};
+}
+
+auto Decompressor::decompress(
+    std::span<const std::byte> src, std::span<std::byte> dst)
+    -> DecompressResult
+{
+  auto output = detail::InflateOutput{.dst = dst, .history = history()};
+  const auto result = inflate(src, output);
+
+  detail::append_to_window(window_, window_end_, dst.first(result.dst_written));
+
+  return result;
+}
+
+auto Decompressor::decompress(std::span<const std::byte> src) -> StreamResult
+{
+  const auto window = std::span{window_};
+  if (window.size() - window_end_ < window_size) {
+    detail::slide_window(window, window_end_);
+  }
+
+  auto output = detail::InflateOutput{
+      .dst = window.subspan(
+          window_end_,
+          std::min(window.size() - window_end_, max_stream_output)),
+      .history = history()};
+  const auto result = inflate(src, output);
+
+  const auto written = window.subspan(window_end_, result.dst_written);
+  window_end_ += written.size();
+
+  return {
+      .status = result.status,
+      .src_consumed = result.src_consumed,
+      .output = written};
+}
+
+auto Decompressor::done() const -> bool
+{
+  return state_.step == detail::InflateState::Step::Done;
 }
 
 }  // namespace starflate
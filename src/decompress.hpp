@@ -1,8 +1,12 @@
 #pragma once
 
 #include "huffman/huffman.hpp"
+#include "src/inflate_table.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <ranges>
 #include <span>
@@ -20,8 +24,20 @@ enum class DecompressStatus : std::uint8_t
   SrcTooSmall,
   InvalidLitOrLen,
   InvalidDistance,
+  InvalidGzipHeader,
+  InvalidZlibHeader,
+  DictionaryMismatch,
+  ChecksumMismatch,
+  SizeMismatch,
+  InvalidIndex,
 };
 
+/// Maximum distance of a back-reference, RFC 3.2.5
+///
+inline constexpr std::size_t window_size = 32768;
+
+class HuffmanTableCache;
+
 namespace detail {
 
 enum class BlockType : std::uint8_t
@@ -37,8 +53,247 @@ struct BlockHeader
   BlockType type;
 };
 
+/// Reads a block header, consuming it from \p compressed_bits.
+///
+/// @{
+auto read_header(huffman::bit_reader& compressed_bits)
+    -> std::expected<BlockHeader, DecompressStatus>;
+
 auto read_header(huffman::bit_span& compressed_bits)
     -> std::expected<BlockHeader, DecompressStatus>;
+/// @}
+
+/// Upper bounds on the number of entries of the decode tables of a dynamic
+/// block, including secondary tables
+///
+/// Computed as by zlib's `enough` for complete codes of up to 288
+/// literal/length and 32 distance symbols, with primary tables indexed by 9
+/// and 6 bits. Code length codes are at most 7 bits, so their table is
+/// indexed directly by 7 bits. Codes that are incomplete, other than a single
+/// code, are rejected, so the tables of a block never need more.
+///
+/// @{
+inline constexpr std::size_t max_len_table_size = 854;
+inline constexpr std::size_t max_dist_table_size = 594;
+inline constexpr std::size_t max_code_length_table_size = 128;
+/// @}
+
+/// Entry of the lookup table of the code length code of a dynamic block
+///
+/// A `bitsize` of zero means that no code prefixes the index of the entry.
+///
+struct CodeLengthEntry
+{
+  std::uint8_t symbol;
+  std::uint8_t bitsize;
+};
+
+/// Huffman decode tables for a dynamic block
+///
+/// The tables have a fixed capacity, so that reading a block header does not
+/// allocate.
+///
+struct DynamicHuffmanTables
+{
+  InflateTable<max_len_table_size> len_table;
+  InflateTable<max_dist_table_size> dist_table;
+};
+
+/// Decode tables of fixed Huffman blocks, RFC 3.2.6
+///
+/// No fixed code is longer than 9 bits, so each code is found with a single
+/// load.
+///
+struct FixedHuffmanTables
+{
+  DirectInflateTable<9> len_table;
+  DirectInflateTable<5> dist_table;
+};
+
+/// Decompression state that persists between calls to `inflate`
+///
+/// Each step consumes input only once all of the bits it needs are available,
+/// so decompression can be suspended at any bit position and resumed when
+/// more input or output space is provided.
+///
+struct InflateState
+{
+  enum class Step : std::uint8_t
+  {
+    Header,
+    StoredHeader,
+    Stored,
+    DynamicHeader,
+    CodeLengthCodes,
+    CodeLengths,
+    Block,
+    Match,
+    Done,
+  };
+
+  huffman::bit_reader src_bits{};
+  Step step{Step::Header};
+  bool final{};
+  BlockType type{};
+
+  // remaining bytes of a stored block
+  std::uint16_t stored_len{};
+
+  // remaining bytes of a match that did not fit in dst
+  std::uint16_t match_len{};
+  std::uint16_t match_distance{};
+
+  // dynamic block header, RFC 3.2.7
+  std::uint16_t n_len_codes{};
+  std::uint16_t n_dist_codes{};
+  std::uint16_t n_code_length_codes{};
+  std::uint16_t index{};
+  std::array<std::uint8_t, 19> code_length_bitsizes{};
+  std::array<std::uint8_t, 288 + 32> code_bitsizes{};
+  std::array<CodeLengthEntry, max_code_length_table_size> code_length_table{};
+  DynamicHuffmanTables tables{};
+
+  // optional cache of the tables of dynamic blocks, and the tables of the
+  // current block if they were found in it
+  HuffmanTableCache* table_cache{};
+  const DynamicHuffmanTables* cached_tables{};
+
+  /// Returns the decode tables of the current dynamic block
+  ///
+  [[nodiscard]]
+  auto dynamic_tables() const -> const DynamicHuffmanTables&
+  {
+    return cached_tables != nullptr ? *cached_tables : tables;
+  }
+};
+
+/// Reads the header of a dynamic block from `state.src_bits`, RFC 3.2.7
+///
+/// The block header must already have been consumed. Builds the decode tables
+/// of the block in `state.tables`, or finds them in `state.table_cache`,
+/// leaving the bitsizes of its codes in `state.code_bitsizes`, and sets
+/// `state.step` to decompress the block. The tables are then
+/// `state.dynamic_tables()`.
+///
+/// @return `Success`, `SrcTooSmall` if the header extends past the input, or
+///     `InvalidLitOrLen` if the header is invalid, including if a code is
+///     oversubscribed or is incomplete with more than one symbol.
+///
+auto decode_dynamic_huffman_tables(InflateState& state) -> DecompressStatus;
+
+/// Returns the decode tables of fixed Huffman blocks, RFC 3.2.6
+///
+/// The tables are generated at compile time.
+///
+auto fixed_huffman_tables() -> const FixedHuffmanTables&;
+
+/// Output written by `inflate`
+///
+/// Back-references may refer to bytes written to `dst` and to `history`, the
+/// bytes output immediately before `dst`.
+///
+struct InflateOutput
+{
+  std::span<std::byte> dst;
+  std::size_t written{};
+  std::span<const std::byte> history{};
+};
+
+/// Decompresses from `state.src_bits` into `output`
+///
+/// @return `Success` once the final block is complete, `SrcTooSmall` if more
+///     input is needed, `DstTooSmall` if more output space is needed, or
+///     another status if the input is invalid.
+///
+auto inflate(InflateState& state, InflateOutput& output) -> DecompressStatus;
+
+/// Decompresses from `state.src_bits` into `output` up to the end of the
+/// current block, like `inflate`
+///
+/// Decompression stops at block boundaries, where `state.step` is `Header`,
+/// and the stream can be resumed from the bit offset of `state.src_bits`
+/// with only the last `window_size` bytes of output.
+///
+/// @return `Success` at the end of a block, or another status as for
+///     `inflate`.
+///
+auto inflate_to_block_end(InflateState& state, InflateOutput& output)
+    -> DecompressStatus;
+
+/// Returns the last `window_size` bytes of the first `end` bytes of `buffer`
+///
+/// @pre end <= buffer.size()
+///
+[[nodiscard]]
+auto window_history(std::span<const std::byte> buffer, std::size_t end)
+    -> std::span<const std::byte>;
+
+/// Moves the history of the first `end` bytes of `buffer` to its start
+///
+auto slide_window(std::span<std::byte> buffer, std::size_t& end) -> void;
+
+/// Appends output following the first `end` bytes of `buffer`, sliding the
+/// history to the start of `buffer` first if the output does not fit
+///
+/// Of output longer than `window_size`, only the last `window_size` bytes are
+/// kept.
+///
+/// @pre buffer.size() >= window_size
+///
+auto append_to_window(
+    std::span<std::byte> buffer,
+    std::size_t& end,
+    std::span<const std::byte> output) -> void;
+
+/// The last `window_size` bytes of output, for back-references from output
+/// written to another buffer
+///
+class OutputHistory
+{
+  std::array<std::byte, 2 * window_size> buffer_{};
+  std::size_t end_{};
+
+public:
+  /// Returns the history, to use as `InflateOutput::history`
+  ///
+  [[nodiscard]]
+  auto view() const -> std::span<const std::byte>;
+
+  /// Appends output following the history
+  ///
+  auto append(std::span<const std::byte> output) -> void;
+};
+
+/// Number of bytes of output `inflate_in_parts` decompresses at a time
+///
+inline constexpr std::size_t output_part_size = std::size_t{1} << 16U;
+
+/// Decompresses from `state.src_bits` into `output`, like `inflate`
+///
+/// Output is decompressed into successively larger prefixes of `output.dst`,
+/// and each part is passed to `consume` right after it is written, while it
+/// is still in cache. This allows checksumming the output without a separate
+/// pass over it.
+///
+/// @param consume Invocable with a `std::span<const std::byte>` of output.
+///
+template <class F>
+auto inflate_in_parts(InflateState& state, InflateOutput& output, F consume)
+    -> DecompressStatus
+{
+  const auto dst = output.dst;
+  auto status = DecompressStatus::Success;
+  do {
+    const auto begin = output.written;
+    output.dst = dst.first(std::min(dst.size(), begin + output_part_size));
+    status = inflate(state, output);
+    consume(std::span<const std::byte>{
+        dst.subspan(begin, output.written - begin)});
+  } while (status == DecompressStatus::DstTooSmall and
+           output.dst.size() != dst.size());
+  output.dst = dst;
+  return status;
+}
 
 /// Copies n bytes from (dst - distance) to dst, handling overlap by repeating.
 ///
@@ -52,12 +307,30 @@ void copy_from_before(
     std::uint16_t distance,
     std::span<std::byte>::iterator dst,
     std::uint16_t n);
+
+/// Number of bytes past the end of a copy that
+/// `copy_from_before_with_slack` may overwrite
+///
+inline constexpr std::size_t copy_slack = 32;
+
+/// Copies n bytes from (dst - distance) to dst, like `copy_from_before`.
+///
+/// Copies in whole 8, 16 or 32 byte words, so it may overwrite up to
+/// `copy_slack` bytes following dst + n.
+///
+/// @pre dst - distance is valid.
+/// @pre [dst + n, dst + n + copy_slack) is valid.
+void copy_from_before_with_slack(
+    std::uint16_t distance,
+    std::span<std::byte>::iterator dst,
+    std::uint16_t n);
 }  // namespace detail
 
 /// Decompresses the given source data into the destination buffer.
 ///
 /// @param src The source data to decompress.
-/// @param dst The destination buffer to store the decompressed data.
+/// @param dst The destination buffer to store the decompressed data. Bytes
+///     following the decompressed data may be overwritten.
 /// @return A status code indicating the result of the decompression.
 ///
 auto decompress(std::span<const std::byte> src, std::span<std::byte> dst)
@@ -70,4 +343,110 @@ auto decompress(const R& src, std::span<std::byte> dst)
   return decompress(std::span{src.data(), src.size()}, dst);
 }
 
+/// Result of decompressing into a destination buffer
+///
+struct DecompressResult
+{
+  DecompressStatus status;
+  std::size_t src_consumed;
+  std::size_t dst_written;
+};
+
+/// Result of `Decompressor::decompress` without a destination buffer
+///
+struct StreamResult
+{
+  DecompressStatus status;
+  std::size_t src_consumed;
+  /// Decompressed data, valid until the next call to `decompress`
+  std::span<const std::byte> output;
+};
+
+/// Resumable decompressor for a stream provided in chunks
+///
+/// Each call to `decompress` consumes as much of `src` as possible and
+/// produces as much output as there is space for. Decompression is suspended
+/// when either runs out, at any bit position in the stream, and is resumed by
+/// the next call.
+///
+/// The partially consumed byte at a suspension point is counted as consumed;
+/// its remaining bits are kept by the decompressor. Unconsumed bytes of `src`
+/// must be provided again on the next call.
+///
+/// Back-references may refer to output of earlier calls, so the decompressor
+/// keeps the last `window_size` bytes of output in an internal buffer. Output
+/// can either be copied to a caller provided buffer, which may be reused
+/// between calls, or decompressed directly into the internal buffer and
+/// handed to the caller in chunks of up to `max_stream_output` bytes. Either
+/// way, memory use is bounded regardless of the size of the stream.
+///
+class Decompressor
+{
+public:
+  /// Maximum size of the output of a call to `decompress` without a
+  /// destination buffer
+  ///
+  static constexpr std::size_t max_stream_output = 3 * window_size;
+
+private:
+  detail::InflateState state_{};
+  // Output is appended to the buffer after the history it may refer to. When
+  // there is less than `window_size` of space left, the history slides back
+  // to the start.
+  std::array<std::byte, window_size + max_stream_output> window_{};
+  std::size_t window_end_{};
+
+  [[nodiscard]]
+  auto history() const -> std::span<const std::byte>;
+  auto inflate(std::span<const std::byte> src, detail::InflateOutput& output)
+      -> DecompressResult;
+
+public:
+  /// Constructs a decompressor for a stream
+  ///
+  Decompressor() = default;
+
+  /// Constructs a decompressor that reuses the decode tables of dynamic
+  /// blocks found in `cache`, and adds the tables it builds
+  ///
+  explicit Decompressor(HuffmanTableCache& cache);
+
+  /// Decompresses the next part of the stream into a buffer
+  ///
+  /// @param src The next input of the stream, starting with the first byte
+  ///     not consumed by the previous call.
+  /// @param dst The buffer to write decompressed data to. Bytes following
+  ///     the data written may be overwritten.
+  /// @return The number of bytes consumed from `src` and written to `dst`,
+  ///     with a status of:
+  ///     * `Success` if the end of the final block was reached. Bytes after
+  ///       the end of the stream are not consumed.
+  ///     * `SrcTooSmall` if all of `src` was consumed before the end of the
+  ///       stream. Call again with more input.
+  ///     * `DstTooSmall` if `dst` is full. Call again with more output space.
+  ///     * another status if the stream is invalid.
+  ///
+  auto decompress(std::span<const std::byte> src, std::span<std::byte> dst)
+      -> DecompressResult;
+
+  /// Decompresses the next part of the stream into the internal buffer
+  ///
+  /// Avoids copying output when it is consumed in chunks, e.g. written to a
+  /// file.
+  ///
+  /// @param src The next input of the stream, starting with the first byte
+  ///     not consumed by the previous call.
+  /// @return The number of bytes consumed from `src` and the decompressed
+  ///     data, with a status as for `decompress(src, dst)`. `DstTooSmall`
+  ///     indicates that the internal buffer is full. The output must be used
+  ///     before calling `decompress` again.
+  ///
+  auto decompress(std::span<const std::byte> src) -> StreamResult;
+
+  /// Returns `true` if the end of the stream has been reached
+  ///
+  [[nodiscard]]
+  auto done() const -> bool;
+};
+
 }  // namespace starflate
@@ -0,0 +1,170 @@
+#include "gzip.hpp"
+
+#include "src/checksum.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+namespace starflate {
+namespace {
+
+constexpr auto gzip_id1 = std::byte{0x1F};
+constexpr auto gzip_id2 = std::byte{0x8B};
+constexpr auto gzip_cm_deflate = std::byte{8};
+constexpr std::uint8_t gzip_reserved_flags = 0xE0;
+
+constexpr std::size_t gzip_fixed_header_size = 10;
+// CRC32 and ISIZE
+constexpr std::size_t gzip_trailer_size = 8;
+
+/// Reads a little-endian integer from the start of `bytes`
+///
+template <class T>
+auto load_le(std::span<const std::byte> bytes) -> T
+{
+  assert(bytes.size() >= sizeof(T));
+  auto value = T{};
+  for (auto i = 0UZ; i != sizeof(T); ++i) {
+    value |= static_cast<T>(std::to_integer<T>(bytes[i]) << (i * CHAR_BIT));
+  }
+  return value;
+}
+
+/// Reads a zero-terminated field, consuming it and its terminator from `src`
+///
+auto read_zero_terminated(std::span<const std::byte>& src)
+    -> std::expected<std::span<const std::byte>, DecompressStatus>
+{
+  const auto end = std::ranges::find(src, std::byte{});
+  if (end == src.end()) {
+    return std::unexpected{DecompressStatus::SrcTooSmall};
+  }
+  const auto field = std::span{src.begin(), end};
+  src = src.subspan(field.size() + 1);
+  return field;
+}
+
+}  // namespace
+
+auto read_gzip_header(std::span<const std::byte> src)
+    -> std::expected<GzipHeader, DecompressStatus>
+{
+  if (src.size() < gzip_fixed_header_size) {
+    return std::unexpected{DecompressStatus::SrcTooSmall};
+  }
+  if (src[0] != gzip_id1 or src[1] != gzip_id2 or src[2] != gzip_cm_deflate) {
+    return std::unexpected{DecompressStatus::InvalidGzipHeader};
+  }
+  const auto flags = std::to_integer<std::uint8_t>(src[3]);
+  if ((flags & gzip_reserved_flags) != 0) {
+    return std::unexpected{DecompressStatus::InvalidGzipHeader};
+  }
+
+  auto header = GzipHeader{
+      .flags = flags,
+      .mtime = load_le<std::uint32_t>(src.subspan(4)),
+      .extra_flags = std::to_integer<std::uint8_t>(src[8]),
+      .os = std::to_integer<std::uint8_t>(src[9]),
+      .extra = {},
+      .name = {},
+      .comment = {},
+      .size = {}};
+  auto rest = src.subspan(gzip_fixed_header_size);
+
+  if ((flags & GzipHeader::Extra) != 0) {
+    if (rest.size() < sizeof(std::uint16_t)) {
+      return std::unexpected{DecompressStatus::SrcTooSmall};
+    }
+    const auto xlen = std::size_t{load_le<std::uint16_t>(rest)};
+    rest = rest.subspan(sizeof(std::uint16_t));
+    if (rest.size() < xlen) {
+      return std::unexpected{DecompressStatus::SrcTooSmall};
+    }
+    header.extra = rest.first(xlen);
+    rest = rest.subspan(xlen);
+  }
+  if ((flags & GzipHeader::Name) != 0) {
+    const auto name = read_zero_terminated(rest);
+    if (not name) {
+      return std::unexpected{name.error()};
+    }
+    header.name = *name;
+  }
+  if ((flags & GzipHeader::Comment) != 0) {
+    const auto comment = read_zero_terminated(rest);
+    if (not comment) {
+      return std::unexpected{comment.error()};
+    }
+    header.comment = *comment;
+  }
+  if ((flags & GzipHeader::HeaderCrc) != 0) {
+    if (rest.size() < sizeof(std::uint16_t)) {
+      return std::unexpected{DecompressStatus::SrcTooSmall};
+    }
+    // the two least significant bytes of the CRC-32 of the preceding bytes
+    constexpr auto kCrc16Mask = std::uint32_t{0xFFFF};
+    const auto crc16 = load_le<std::uint16_t>(rest);
+    if ((crc32(src.first(src.size() - rest.size())) & kCrc16Mask) != crc16) {
+      return std::unexpected{DecompressStatus::InvalidGzipHeader};
+    }
+    rest = rest.subspan(sizeof(std::uint16_t));
+  }
+
+  header.size = src.size() - rest.size();
+  return header;
+}
+
+auto decompress_gzip(std::span<const std::byte> src, std::span<std::byte> dst)
+    -> DecompressResult
+{
+  const auto header = read_gzip_header(src);
+  if (not header) {
+    return {.status = header.error(), .src_consumed = 0, .dst_written = 0};
+  }
+
+  const auto compressed = src.subspan(header->size);
+  auto state = detail::InflateState{
+      .src_bits = huffman::bit_reader{huffman::bit_span{compressed}}};
+  auto output = detail::InflateOutput{.dst = dst};
+
+  auto crc = std::uint32_t{};
+  auto status = detail::inflate_in_parts(
+      state, output, [&crc](std::span<const std::byte> part) {
+        crc = crc32(part, crc);
+      });
+  if (status != DecompressStatus::Success) {
+    return {.status = status, .src_consumed = 0, .dst_written = output.written};
+  }
+
+  // the trailer starts at the byte following the compressed data
+  state.src_bits.unbuffer();
+  const auto trailer_offset =
+      static_cast<std::size_t>(state.src_bits.next_byte() - src.data());
+  if (src.size() - trailer_offset < gzip_trailer_size) {
+    return {
+        .status = DecompressStatus::SrcTooSmall,
+        .src_consumed = 0,
+        .dst_written = output.written};
+  }
+  const auto trailer = src.subspan(trailer_offset, gzip_trailer_size);
+
+  status = DecompressStatus::Success;
+  if (load_le<std::uint32_t>(trailer) != crc) {
+    status = DecompressStatus::ChecksumMismatch;
+  } else if (
+      load_le<std::uint32_t>(trailer.subspan(sizeof(std::uint32_t))) !=
+      static_cast<std::uint32_t>(output.written)) {
+    // ISIZE is the size modulo 2^32
+    status = DecompressStatus::SizeMismatch;
+  }
+  return {
+      .status = status,
+      .src_consumed =
+          status == DecompressStatus::Success
+              ? trailer_offset + gzip_trailer_size
+              : 0,
+      .dst_written = output.written};
+}
+
+}  // namespace starflate
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "src/decompress.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+
+namespace starflate {
+
+/// Header of a gzip member, RFC 1952 2.3
+///
+/// Optional fields that are not present are empty. Fields refer to the bytes
+/// of the member they were read from.
+///
+struct GzipHeader
+{
+  /// Flags of the optional fields, RFC 1952 2.3.1
+  enum Flag : std::uint8_t
+  {
+    Text = 1U << 0U,       // FTEXT
+    HeaderCrc = 1U << 1U,  // FHCRC
+    Extra = 1U << 2U,      // FEXTRA
+    Name = 1U << 3U,       // FNAME
+    Comment = 1U << 4U,    // FCOMMENT
+  };
+
+  std::uint8_t flags;
+  std::uint32_t mtime;
+  std::uint8_t extra_flags;
+  std::uint8_t os;
+  /// FEXTRA subfields
+  std::span<const std::byte> extra;
+  /// FNAME, without the terminating zero
+  std::span<const std::byte> name;
+  /// FCOMMENT, without the terminating zero
+  std::span<const std::byte> comment;
+  /// Number of bytes in the header, i.e. the offset of the compressed data
+  std::size_t size;
+};
+
+/// Reads the header of a gzip member
+///
+/// @param src The member, starting with its first byte.
+/// @return The header, or a status of:
+///     * `SrcTooSmall` if `src` ends before the end of the header.
+///     * `InvalidGzipHeader` if the header is not that of a gzip member
+///       compressed with DEFLATE, uses reserved flags, or does not match its
+///       header CRC.
+///
+auto read_gzip_header(std::span<const std::byte> src)
+    -> std::expected<GzipHeader, DecompressStatus>;
+
+/// Decompresses a gzip member, RFC 1952
+///
+/// The CRC-32 and size of the output are verified against the trailer of the
+/// member. The output is checksummed while it is decompressed, a part at a
+/// time while that part is still in cache, instead of in a separate pass.
+///
+/// A gzip file may consist of several members; the next member starts at
+/// `src_consumed`.
+///
+/// @param src The member, starting with its first byte. Bytes following the
+///     member are not read.
+/// @param dst The destination buffer. Bytes following the decompressed data
+///     may be overwritten.
+/// @return The size of the member, i.e. the offset of the next member in
+///     `src`, and the number of bytes written to `dst`, with a status of:
+///     * `Success` if the member was decompressed and verified.
+///     * `ChecksumMismatch` or `SizeMismatch` if the output does not match the
+///       trailer.
+///     * another status as for `read_gzip_header` and `decompress`.
+///     `src_consumed` is zero unless the status is `Success`.
+///
+auto decompress_gzip(std::span<const std::byte> src, std::span<std::byte> dst)
+    -> DecompressResult;
+
+}  // namespace starflate
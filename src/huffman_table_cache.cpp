@@ -0,0 +1,113 @@
+#include "huffman_table_cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+
+namespace starflate {
+namespace {
+
+/// Returns the FNV-1a hash of the bitsizes of the codes of a dynamic block
+///
+auto hash_bitsizes(
+    std::span<const std::uint8_t> len_bitsizes,
+    std::span<const std::uint8_t> dist_bitsizes) -> std::uint64_t
+{
+  constexpr auto kPrime = std::uint64_t{0x100'0000'01B3};
+  auto hash = std::uint64_t{0xCBF2'9CE4'8422'2325};
+  const auto add = [&hash](std::uint64_t value) {
+    hash = (hash ^ value) * kPrime;
+  };
+
+  add(len_bitsizes.size());
+  add(dist_bitsizes.size());
+  for (const auto bitsize : len_bitsizes) {
+    add(bitsize);
+  }
+  for (const auto bitsize : dist_bitsizes) {
+    add(bitsize);
+  }
+  return hash;
+}
+
+}  // namespace
+
+HuffmanTableCache::HuffmanTableCache(std::size_t size)
+    : slots_(std::bit_ceil(std::max(size, 1UZ)))
+{}
+
+HuffmanTableCache::~HuffmanTableCache()
+{
+  for (auto& slot : slots_) {
+    delete slot.load(std::memory_order_relaxed);
+  }
+}
+
+auto HuffmanTableCache::find(
+    std::span<const std::uint8_t> len_bitsizes,
+    std::span<const std::uint8_t> dist_bitsizes) const
+    -> const detail::DynamicHuffmanTables*
+{
+  const auto hash = hash_bitsizes(len_bitsizes, dist_bitsizes);
+  // acquire the tables written before the entry was published
+  const auto* entry =
+      slots_[hash & (slots_.size() - 1)].load(std::memory_order_acquire);
+  if (entry == nullptr or entry->hash != hash or
+      entry->n_len_codes != len_bitsizes.size() or
+      entry->n_dist_codes != dist_bitsizes.size()) {
+    return nullptr;
+  }
+  const auto code_bitsizes = std::span{entry->code_bitsizes};
+  if (not std::ranges::equal(
+          code_bitsizes.first(len_bitsizes.size()), len_bitsizes) or
+      not std::ranges::equal(
+          code_bitsizes.subspan(len_bitsizes.size(), dist_bitsizes.size()),
+          dist_bitsizes)) {
+    return nullptr;
+  }
+  return &entry->tables;
+}
+
+auto HuffmanTableCache::insert(
+    std::span<const std::uint8_t> len_bitsizes,
+    std::span<const std::uint8_t> dist_bitsizes,
+    const detail::DynamicHuffmanTables& tables) -> void
+{
+  const auto hash = hash_bitsizes(len_bitsizes, dist_bitsizes);
+  auto& slot = slots_[hash & (slots_.size() - 1)];
+  if (slot.load(std::memory_order_relaxed) != nullptr) {
+    return;
+  }
+
+  auto entry = std::make_unique<Entry>(
+      hash,
+      static_cast<std::uint16_t>(len_bitsizes.size()),
+      static_cast<std::uint16_t>(dist_bitsizes.size()),
+      std::array<std::uint8_t, 288 + 32>{},
+      tables);
+  std::ranges::copy(len_bitsizes, entry->code_bitsizes.begin());
+  std::ranges::copy(
+      dist_bitsizes,
+      std::span{entry->code_bitsizes}.subspan(len_bitsizes.size()).begin());
+
+  // another thread may have taken the slot since, in which case this entry
+  // is dropped
+  const Entry* expected = nullptr;
+  if (slot.compare_exchange_strong(
+          expected,
+          entry.get(),
+          std::memory_order_release,
+          std::memory_order_relaxed)) {
+    static_cast<void>(entry.release());
+  }
+}
+
+auto HuffmanTableCache::size() const -> std::size_t
+{
+  return static_cast<std::size_t>(
+      std::ranges::count_if(slots_, [](const auto& slot) {
+        return slot.load(std::memory_order_relaxed) != nullptr;
+      }));
+}
+
+}  // namespace starflate
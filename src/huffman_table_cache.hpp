@@ -0,0 +1,89 @@
+#pragma once
+
+#include "src/decompress.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace starflate {
+
+/// Cache of the decode tables of dynamic blocks, keyed by their code lengths
+///
+/// Many streams repeat the same dynamic block header, e.g. streams of similar
+/// payloads. A decompressor given a cache looks up the code lengths of each
+/// dynamic block header and reuses the tables built for an earlier block with
+/// the same header, instead of building them again.
+///
+/// The cache may be shared between threads. Lookups and insertions are
+/// lock-free. Each code lengths hash to a single slot, which keeps the first
+/// tables inserted into it until the cache is destroyed, so tables found are
+/// never modified or freed while in use. Tables for other code lengths that
+/// hash to a taken slot are not cached.
+///
+/// The cache must outlive the decompressors using it.
+///
+class HuffmanTableCache
+{
+public:
+  /// Default number of slots, each of which can hold a few KiB of tables
+  ///
+  static constexpr std::size_t default_size = 64;
+
+private:
+  struct Entry
+  {
+    std::uint64_t hash;
+    std::uint16_t n_len_codes;
+    std::uint16_t n_dist_codes;
+    std::array<std::uint8_t, 288 + 32> code_bitsizes;
+    detail::DynamicHuffmanTables tables;
+  };
+
+  std::vector<std::atomic<const Entry*>> slots_;
+
+public:
+  /// Constructs an empty cache
+  ///
+  /// @param size The number of slots, rounded up to a power of two.
+  ///
+  explicit HuffmanTableCache(std::size_t size = default_size);
+
+  HuffmanTableCache(const HuffmanTableCache&) = delete;
+  auto operator=(const HuffmanTableCache&) -> HuffmanTableCache& = delete;
+  ~HuffmanTableCache();
+
+  /// Finds the tables of the codes with the given bitsizes
+  ///
+  /// @param len_bitsizes The bitsizes of the literal/length codes.
+  /// @param dist_bitsizes The bitsizes of the distance codes.
+  /// @return The tables, valid until the cache is destroyed, or `nullptr` if
+  ///     they are not cached.
+  ///
+  [[nodiscard]]
+  auto find(
+      std::span<const std::uint8_t> len_bitsizes,
+      std::span<const std::uint8_t> dist_bitsizes) const
+      -> const detail::DynamicHuffmanTables*;
+
+  /// Caches the tables of the codes with the given bitsizes
+  ///
+  /// Does nothing if the slot for the bitsizes is taken.
+  ///
+  /// @pre `tables` were built from the bitsizes.
+  ///
+  auto insert(
+      std::span<const std::uint8_t> len_bitsizes,
+      std::span<const std::uint8_t> dist_bitsizes,
+      const detail::DynamicHuffmanTables& tables) -> void;
+
+  /// Returns the number of cached tables
+  ///
+  [[nodiscard]]
+  auto size() const -> std::size_t;
+};
+
+}  // namespace starflate
@@ -0,0 +1,282 @@
+#include "index.hpp"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+
+namespace starflate {
+namespace {
+
+constexpr std::array<std::byte, 8> index_magic = {
+    std::byte{'s'},
+    std::byte{'f'},
+    std::byte{'i'},
+    std::byte{'n'},
+    std::byte{'d'},
+    std::byte{'e'},
+    std::byte{'x'},
+    std::byte{1}};
+
+// checkpoint bit offset and output offset
+constexpr std::size_t checkpoint_header_size = 2 * sizeof(std::uint64_t);
+
+/// Returns the size of the window of a checkpoint at `dst_offset`
+///
+auto window_size_at(std::size_t dst_offset) -> std::size_t
+{
+  return std::min(dst_offset, window_size);
+}
+
+auto store_le64(std::uint64_t value, std::vector<std::byte>& dst) -> void
+{
+  for (auto i = 0UZ; i != sizeof(value); ++i) {
+    dst.push_back(static_cast<std::byte>(value >> (i * CHAR_BIT)));
+  }
+}
+
+/// Reads a little-endian integer, consuming it from `src`
+///
+auto load_le64(std::span<const std::byte>& src) -> std::optional<std::size_t>
+{
+  auto value = std::uint64_t{};
+  if (src.size() < sizeof(value)) {
+    return std::nullopt;
+  }
+  for (auto i = 0UZ; i != sizeof(value); ++i) {
+    value |= std::to_integer<std::uint64_t>(src[i]) << (i * CHAR_BIT);
+  }
+  src = src.subspan(sizeof(value));
+  return value;
+}
+
+/// Output decompressed through a buffer that keeps the window
+///
+/// Output is appended after the window. When the buffer is full, the window
+/// slides back to the start.
+///
+struct WindowBuffer
+{
+  std::vector<std::byte> buffer =
+      std::vector<std::byte>(window_size + detail::output_part_size);
+  std::size_t end{};
+
+  /// Returns output space for up to `n` bytes, following the window
+  ///
+  auto output(std::size_t n) -> detail::InflateOutput
+  {
+    if (end == buffer.size()) {
+      std::ranges::copy(window(), buffer.begin());
+      end = window_size;
+    }
+    return {
+        .dst = std::span{buffer}.first(end + std::min(n, buffer.size() - end)),
+        .written = end};
+  }
+
+  [[nodiscard]]
+  auto window() const -> std::span<const std::byte>
+  {
+    return std::span{buffer}.first(end).last(window_size_at(end));
+  }
+};
+
+}  // namespace
+
+namespace detail {
+
+auto resume_at(std::span<const std::byte> src, const Checkpoint& checkpoint)
+    -> InflateState
+{
+  const auto bit = checkpoint.src_bit;
+  return {
+      .src_bits = huffman::bit_reader{
+          src.subspan(bit / CHAR_BIT).data(),
+          (src.size() * CHAR_BIT) - bit,
+          static_cast<std::uint8_t>(bit % CHAR_BIT)}};
+}
+
+auto valid(const Index& index) -> bool
+{
+  const auto& checkpoints = index.checkpoints;
+  if (checkpoints.empty() or checkpoints.front().src_bit != 0 or
+      checkpoints.front().dst_offset != 0) {
+    return false;
+  }
+  const auto in_order = [](const Checkpoint& lhs, const Checkpoint& rhs) {
+    return lhs.src_bit < rhs.src_bit and lhs.dst_offset <= rhs.dst_offset;
+  };
+  for (auto i = 1UZ; i != checkpoints.size(); ++i) {
+    if (not in_order(checkpoints[i - 1], checkpoints[i])) {
+      return false;
+    }
+  }
+  return checkpoints.back().src_bit / CHAR_BIT < index.src_size and
+         checkpoints.back().dst_offset <= index.dst_size and
+         std::ranges::all_of(checkpoints, [](const Checkpoint& checkpoint) {
+           return checkpoint.window.size() ==
+                  window_size_at(checkpoint.dst_offset);
+         });
+}
+
+}  // namespace detail
+
+auto build_index(std::span<const std::byte> src, std::size_t spacing)
+    -> std::expected<Index, DecompressStatus>
+{
+  using Step = detail::InflateState::Step;
+
+  auto index = Index{
+      .src_size = 0,
+      .dst_size = 0,
+      .checkpoints = {{.src_bit = 0, .dst_offset = 0, .window = {}}}};
+  auto state = detail::InflateState{
+      .src_bits = huffman::bit_reader{huffman::bit_span{src}}};
+  auto buffer = WindowBuffer{};
+
+  while (state.step != Step::Done) {
+    auto output = buffer.output(detail::output_part_size);
+    const auto status = detail::inflate_to_block_end(state, output);
+    index.dst_size += output.written - buffer.end;
+    buffer.end = output.written;
+    if (status == DecompressStatus::DstTooSmall) {
+      continue;
+    }
+    if (status != DecompressStatus::Success) {
+      // src is the entire stream, so a missing block header is invalid.
+      return std::unexpected{
+          status == DecompressStatus::SrcTooSmall and state.step == Step::Header
+              ? DecompressStatus::InvalidBlockHeader
+              : status};
+    }
+
+    if (state.step == Step::Header and
+        index.dst_size - index.checkpoints.back().dst_offset >= spacing) {
+      const auto window = buffer.window();
+      index.checkpoints.push_back(
+          {.src_bit = (src.size() * CHAR_BIT) - state.src_bits.size(),
+           .dst_offset = index.dst_size,
+           .window = std::vector(window.begin(), window.end())});
+    }
+  }
+
+  state.src_bits.unbuffer();
+  index.src_size =
+      static_cast<std::size_t>(state.src_bits.next_byte() - src.data());
+  return index;
+}
+
+auto read_at(
+    std::span<const std::byte> src,
+    const Index& index,
+    std::size_t offset,
+    std::span<std::byte> dst) -> std::expected<std::size_t, DecompressStatus>
+{
+  if (src.size() < index.src_size) {
+    return std::unexpected{DecompressStatus::SrcTooSmall};
+  }
+  if (not detail::valid(index)) {
+    return std::unexpected{DecompressStatus::InvalidIndex};
+  }
+  if (offset >= index.dst_size) {
+    return 0;
+  }
+  dst = dst.first(std::min(dst.size(), index.dst_size - offset));
+
+  // the last checkpoint at or before offset
+  const auto checkpoint = std::prev(std::ranges::upper_bound(
+      index.checkpoints, offset, {}, &Checkpoint::dst_offset));
+  auto state = detail::resume_at(src.first(index.src_size), *checkpoint);
+
+  // decompress and discard the output preceding offset
+  auto buffer = WindowBuffer{};
+  std::ranges::copy(checkpoint->window, buffer.buffer.begin());
+  buffer.end = checkpoint->window.size();
+  for (auto skip = offset - checkpoint->dst_offset; skip != 0;) {
+    auto output = buffer.output(skip);
+    const auto status = detail::inflate(state, output);
+    skip -= output.written - buffer.end;
+    buffer.end = output.written;
+    if (status == DecompressStatus::Success and skip != 0) {
+      return std::unexpected{DecompressStatus::InvalidIndex};
+    }
+    if (status != DecompressStatus::Success and
+        status != DecompressStatus::DstTooSmall) {
+      return std::unexpected{status};
+    }
+  }
+
+  auto output =
+      detail::InflateOutput{.dst = dst, .history = buffer.window()};
+  const auto status = detail::inflate(state, output);
+  if (status != DecompressStatus::Success and
+      status != DecompressStatus::DstTooSmall) {
+    return std::unexpected{status};
+  }
+  return output.written;
+}
+
+auto serialize_index(const Index& index) -> std::vector<std::byte>
+{
+  auto dst = std::vector<std::byte>(index_magic.begin(), index_magic.end());
+  store_le64(index.src_size, dst);
+  store_le64(index.dst_size, dst);
+  store_le64(index.checkpoints.size(), dst);
+  for (const auto& checkpoint : index.checkpoints) {
+    store_le64(checkpoint.src_bit, dst);
+    store_le64(checkpoint.dst_offset, dst);
+    dst.insert(dst.end(), checkpoint.window.begin(), checkpoint.window.end());
+  }
+  return dst;
+}
+
+auto deserialize_index(std::span<const std::byte> src)
+    -> std::expected<Index, DecompressStatus>
+{
+  constexpr auto invalid = std::unexpected{DecompressStatus::InvalidIndex};
+
+  if (src.size() < index_magic.size() or
+      not std::ranges::equal(src.first(index_magic.size()), index_magic)) {
+    return invalid;
+  }
+  src = src.subspan(index_magic.size());
+
+  const auto src_size = load_le64(src);
+  const auto dst_size = load_le64(src);
+  const auto n_checkpoints = load_le64(src);
+  // each checkpoint takes at least its offsets, which bounds the allocation
+  if (not src_size or not dst_size or not n_checkpoints or
+      *n_checkpoints == 0 or
+      *n_checkpoints > src.size() / checkpoint_header_size) {
+    return invalid;
+  }
+
+  auto index = Index{
+      .src_size = *src_size, .dst_size = *dst_size, .checkpoints = {}};
+  index.checkpoints.reserve(*n_checkpoints);
+  for (auto i = 0UZ; i != *n_checkpoints; ++i) {
+    const auto src_bit = load_le64(src);
+    const auto dst_offset = load_le64(src);
+    if (not src_bit or not dst_offset) {
+      return invalid;
+    }
+    const auto size = window_size_at(*dst_offset);
+    if (src.size() < size) {
+      return invalid;
+    }
+    const auto window = src.first(size);
+    index.checkpoints.push_back(
+        {.src_bit = *src_bit,
+         .dst_offset = *dst_offset,
+         .window = std::vector(window.begin(), window.end())});
+    src = src.subspan(size);
+  }
+  if (not src.empty() or not detail::valid(index)) {
+    return invalid;
+  }
+  return index;
+}
+
+}  // namespace starflate
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "src/decompress.hpp"
+
+#include <cstddef>
+#include <expected>
+#include <span>
+#include <vector>
+
+namespace starflate {
+
+/// A point from which a DEFLATE stream can be decompressed without
+/// decompressing the data before it
+///
+struct Checkpoint
+{
+  /// Offset of a block header in the stream, in bits
+  std::size_t src_bit;
+  /// Offset of the output of the block
+  std::size_t dst_offset;
+  /// The last `window_size` bytes of output preceding `dst_offset`, or all of
+  /// them if there are fewer
+  std::vector<std::byte> window;
+
+  auto operator==(const Checkpoint&) const -> bool = default;
+};
+
+/// Checkpoints for random access into a DEFLATE stream, as for zran.c
+///
+struct Index
+{
+  /// Size of the stream
+  std::size_t src_size;
+  /// Size of the output of the stream
+  std::size_t dst_size;
+  /// Checkpoints in order of offset, starting with the start of the stream
+  std::vector<Checkpoint> checkpoints;
+
+  auto operator==(const Index&) const -> bool = default;
+};
+
+/// Default minimum distance between checkpoints in the output
+///
+inline constexpr std::size_t default_checkpoint_spacing = std::size_t{1}
+                                                          << 20U;
+
+/// Builds an index of a DEFLATE stream by decompressing it
+///
+/// A checkpoint is recorded at the first block boundary at least `spacing`
+/// bytes of output after the one before it. Decoding can only resume at a
+/// block boundary, so checkpoints are further apart in streams of large
+/// blocks. Each checkpoint stores its window, so smaller spacings make
+/// `read_at` faster at the cost of a larger index.
+///
+/// The output is decompressed through a buffer of a few windows, so memory
+/// use does not depend on the size of the stream.
+///
+/// @param src The stream. Bytes following the stream are not read.
+/// @param spacing The minimum distance between checkpoints in the output.
+/// @return The index, or a status as for `decompress`.
+///
+auto build_index(
+    std::span<const std::byte> src,
+    std::size_t spacing = default_checkpoint_spacing)
+    -> std::expected<Index, DecompressStatus>;
+
+/// Decompresses part of the output of a DEFLATE stream
+///
+/// Decompression resumes from the last checkpoint at or before `offset`, so
+/// at most about `spacing` bytes of output are decompressed and discarded.
+///
+/// @param src The stream `index` was built from.
+/// @param index The index of the stream.
+/// @param offset The offset in the output of the first byte to read.
+/// @param dst The destination buffer. Its size is the number of bytes to
+///     read.
+/// @return The number of bytes written to `dst`, fewer than its size only if
+///     the output ends first, or a status of:
+///     * `SrcTooSmall` if `src` is smaller than the stream.
+///     * `InvalidIndex` if `index` is not valid or does not match the stream.
+///     * another status as for `decompress`.
+///
+auto read_at(
+    std::span<const std::byte> src,
+    const Index& index,
+    std::size_t offset,
+    std::span<std::byte> dst) -> std::expected<std::size_t, DecompressStatus>;
+
+/// Serializes an index
+///
+/// The format is the magic bytes `sfindex` and a version byte, followed by
+/// the sizes of the stream and of its output and the number of checkpoints,
+/// then the bit offset and output offset of each checkpoint followed by its
+/// window. Numbers are 64-bit little endian. The size of each window follows
+/// from its offset.
+///
+auto serialize_index(const Index& index) -> std::vector<std::byte>;
+
+/// Reads an index serialized by `serialize_index`
+///
+/// @return The index, or a status of `InvalidIndex` if `src` is not a valid
+///     serialized index.
+///
+auto deserialize_index(std::span<const std::byte> src)
+    -> std::expected<Index, DecompressStatus>;
+
+namespace detail {
+
+/// Returns `true` if the checkpoints of `index` start at the start of the
+/// stream, are in order and within the stream, and have windows of the
+/// right size
+///
+/// Does not check that they match the stream.
+///
+auto valid(const Index& index) -> bool;
+
+/// Returns the state to decompress a stream from a checkpoint
+///
+/// @param src The stream, up to its end.
+/// @pre `checkpoint.src_bit` is within `src`.
+///
+auto resume_at(std::span<const std::byte> src, const Checkpoint& checkpoint)
+    -> InflateState;
+
+}  // namespace detail
+
+}  // namespace starflate
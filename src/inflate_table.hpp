@@ -0,0 +1,248 @@
+#pragma once
+
+#include "huffman/huffman.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+namespace starflate::detail {
+
+/// An entry of an `InflateTable`
+///
+/// Packed into 32 bits:
+///
+/// bits   field
+/// =====  =========================================================
+/// 0-3    code bitsize, or bitsize of the secondary table of a link
+/// 4-7    number of extra bits
+/// 8-15   kind
+/// 16-31  literal, base length or distance, or secondary table offset
+///
+class InflateEntry
+{
+public:
+  enum class Kind : std::uint8_t
+  {
+    Invalid,
+    Literal,
+    EndOfBlock,
+    Base,  // base length or distance, followed by extra bits
+    Link,  // secondary table
+  };
+
+private:
+  std::uint32_t bits_{};
+
+public:
+  InflateEntry() = default;
+
+  constexpr InflateEntry(
+      Kind kind,
+      std::uint16_t value,
+      std::uint8_t bitsize,
+      std::uint8_t extra_bits = 0)
+      : bits_{
+            std::uint32_t{bitsize} | (std::uint32_t{extra_bits} << 4U) |
+            (std::uint32_t{static_cast<std::uint8_t>(kind)} << 8U) |
+            (std::uint32_t{value} << 16U)}
+  {
+    assert(bitsize < 16 and extra_bits < 16);
+  }
+
+  [[nodiscard]]
+  constexpr auto bitsize() const -> std::uint8_t
+  {
+    return static_cast<std::uint8_t>(bits_ & 0xFU);
+  }
+
+  [[nodiscard]]
+  constexpr auto extra_bits() const -> std::uint8_t
+  {
+    return static_cast<std::uint8_t>((bits_ >> 4U) & 0xFU);
+  }
+
+  [[nodiscard]]
+  constexpr auto kind() const -> Kind
+  {
+    return static_cast<Kind>((bits_ >> 8U) & 0xFFU);
+  }
+
+  [[nodiscard]]
+  constexpr auto value() const -> std::uint16_t
+  {
+    return static_cast<std::uint16_t>(bits_ >> 16U);
+  }
+};
+
+/// Decode table for DEFLATE literal/length or distance codes
+/// @tparam Capacity upper bound for the number of entries
+///
+/// Has the same layout as `huffman::decode_table`, but each entry is packed
+/// into 32 bits and holds the meaning of its symbol instead of the symbol:
+/// a literal, or the base and number of extra bits of a length or distance.
+/// A single load provides everything needed to consume a code and its extra
+/// bits.
+///
+template <std::size_t Capacity = std::dynamic_extent>
+class InflateTable
+{
+public:
+  using Entry = InflateEntry;
+  using Kind = InflateEntry::Kind;
+
+private:
+  huffman::detail::decode_table_storage_t<Entry, Capacity> entries_{};
+  std::uint8_t primary_bitsize_{};
+  std::uint8_t max_bitsize_{};
+
+public:
+  /// Constructs an empty table
+  ///
+  InflateTable() = default;
+
+  /// Constructs a table from a decode table
+  /// @param table decode table for literal/length or distance codes
+  /// @param symbol_entry function returning the leaf entry for a symbol and
+  ///     the bitsize of its code
+  ///
+  template <std::size_t TableCapacity, class F>
+  constexpr InflateTable(
+      const huffman::decode_table<std::uint16_t, TableCapacity>& table,
+      F symbol_entry)
+      : primary_bitsize_{table.primary_bitsize()},
+        max_bitsize_{table.max_bitsize()}
+  {
+    assert(table.size() <= std::numeric_limits<std::uint16_t>::max());
+    entries_.resize(table.size());
+
+    auto i = std::size_t{};
+    for (const auto& entry : table.entries()) {
+      if (entry.is_link()) {
+        entries_[i] = Entry{
+            Kind::Link,
+            static_cast<std::uint16_t>(entry.subtable),
+            entry.subtable_bitsize};
+      } else if (entry.bitsize != 0) {
+        entries_[i] = symbol_entry(entry.symbol, entry.bitsize);
+      }
+      ++i;
+    }
+  }
+
+  /// Bitsize of the longest code in the table
+  ///
+  [[nodiscard]]
+  constexpr auto max_bitsize() const -> std::uint8_t
+  {
+    return max_bitsize_;
+  }
+
+  /// Returns `true` if the table contains no codes
+  ///
+  [[nodiscard]]
+  constexpr auto empty() const -> bool
+  {
+    return entries_.empty();
+  }
+
+  /// Finds the entry for the code at the start of `bits`
+  /// @param bits next bits of a bit stream, with the first bit in the least
+  ///     significant position
+  /// @pre `not empty()`
+  ///
+  /// @return the leaf entry for the code that prefixes `bits`, or an entry of
+  ///     kind `Invalid` with a bitsize of zero if there is none. The returned
+  ///     entry may be longer than the number of valid bits in `bits`; callers
+  ///     must check this.
+  ///
+  [[nodiscard]]
+  constexpr auto find(std::uint64_t bits) const -> Entry
+  {
+    assert(not empty());
+
+    const auto primary_mask = (std::uint64_t{1} << primary_bitsize_) - 1U;
+    const auto primary = entries_[bits & primary_mask];
+    if (primary.kind() != Kind::Link) {
+      return primary;
+    }
+
+    const auto subtable_mask = (std::uint64_t{1} << primary.bitsize()) - 1U;
+    const auto index = (bits >> primary_bitsize_) & subtable_mask;
+    return entries_[primary.value() + index];
+  }
+};
+
+/// Decode table for codes no longer than `Bitsize`, without secondary tables
+/// @tparam Bitsize number of bits indexing the table
+///
+/// Every code is found with a single load at an index of a fixed number of
+/// bits. Meant for the fixed Huffman codes, whose tables are generated at
+/// compile time.
+///
+template <std::uint8_t Bitsize>
+class DirectInflateTable
+{
+public:
+  using Entry = InflateEntry;
+
+private:
+  static constexpr auto mask = (std::uint64_t{1} << Bitsize) - 1U;
+
+  std::array<Entry, std::size_t{1} << Bitsize> entries_{};
+
+public:
+  /// Constructs a table from a decode table
+  /// @param table decode table for literal/length or distance codes
+  /// @param symbol_entry function returning the leaf entry for a symbol and
+  ///     the bitsize of its code
+  /// @pre `table` has no codes longer than `Bitsize`
+  ///
+  template <std::size_t TableCapacity, class F>
+  constexpr DirectInflateTable(
+      const huffman::decode_table<std::uint16_t, TableCapacity>& table,
+      F symbol_entry)
+  {
+    assert(table.max_bitsize() <= Bitsize);
+    assert(table.primary_bitsize() >= table.max_bitsize());
+
+    // a shorter primary table repeats for each value of the bits past it
+    const auto entries = table.entries();
+    for (auto i = std::size_t{}; i != entries_.size(); ++i) {
+      const auto& entry = entries[i % entries.size()];
+      if (entry.bitsize != 0) {
+        entries_[i] = symbol_entry(entry.symbol, entry.bitsize);
+      }
+    }
+  }
+
+  /// Bitsize of the longest code the table can hold
+  ///
+  [[nodiscard]]
+  static constexpr auto max_bitsize() -> std::uint8_t
+  {
+    return Bitsize;
+  }
+
+  /// Returns `false`, as the table is built from a nonempty code
+  ///
+  [[nodiscard]]
+  static constexpr auto empty() -> bool
+  {
+    return false;
+  }
+
+  /// Finds the entry for the code at the start of `bits`
+  /// @see InflateTable::find
+  ///
+  [[nodiscard]]
+  constexpr auto find(std::uint64_t bits) const -> Entry
+  {
+    return entries_[bits & mask];
+  }
+};
+
+}  // namespace starflate::detail
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "src/decompress.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace starflate {
+
+/// Destination of the output of `decompress`
+///
+/// Output is written to the spaces returned by `sink.next(n)`, which is
+/// called once before decompressing and whenever the last space is full, and
+/// returns an empty space if there is no more. `sink.finish(n)` is called
+/// once decompression ends, whether or not it succeeded.
+///
+/// If `Sink::contiguous`, each space starts with all of the output so far,
+/// e.g. a buffer that grows, and `n` is the size of the output. Otherwise
+/// each space is a new part of the output and `n` is the number of bytes
+/// written to the last one. The decompressor then keeps the window itself,
+/// so parts may be of any size.
+///
+template <class Sink>
+concept OutputSink = requires(Sink& sink, std::size_t n) {
+  { Sink::contiguous } -> std::convertible_to<bool>;
+  { sink.next(n) } -> std::same_as<std::span<std::byte>>;
+  { sink.finish(n) } -> std::same_as<void>;
+};
+
+/// Output to a buffer of a fixed size
+///
+class SpanSink
+{
+  std::span<std::byte> dst_;
+
+public:
+  static constexpr bool contiguous = true;
+
+  explicit SpanSink(std::span<std::byte> dst) : dst_{dst} {}
+
+  [[nodiscard]]
+  auto next(std::size_t) const -> std::span<std::byte>
+  {
+    return dst_;
+  }
+
+  auto finish(std::size_t) const -> void {}
+};
+
+/// Output to a vector, which grows as needed
+///
+/// The output replaces the contents of the vector. The vector is resized to
+/// its capacity, or to `min_size` if smaller, and doubles in size whenever it
+/// is full, so that output is copied a constant number of times on average.
+/// Once decompression ends, the vector is resized to the size of the output.
+/// Reserving the expected size avoids growing at all.
+///
+class VectorSink
+{
+  std::vector<std::byte>* dst_;
+
+public:
+  static constexpr bool contiguous = true;
+  static constexpr std::size_t min_size = 4096;
+
+  explicit VectorSink(std::vector<std::byte>& dst) : dst_{&dst} {}
+
+  auto next(std::size_t n) -> std::span<std::byte>
+  {
+    dst_->resize(n == 0 ? std::max(dst_->capacity(), min_size) : 2 * n);
+    return *dst_;
+  }
+
+  auto finish(std::size_t size) -> void { dst_->resize(size); }
+};
+
+/// Output to a list of buffers, in order, like `readv`
+///
+class ScatterSink
+{
+  std::span<const std::span<std::byte>> parts_;
+  std::size_t next_{};
+
+public:
+  static constexpr bool contiguous = false;
+
+  explicit ScatterSink(std::span<const std::span<std::byte>> parts)
+      : parts_{parts}
+  {}
+
+  auto next(std::size_t) -> std::span<std::byte>
+  {
+    // an empty space would end the output
+    while (next_ != parts_.size() and parts_[next_].empty()) {
+      ++next_;
+    }
+    return next_ == parts_.size() ? std::span<std::byte>{}
+                                  : parts_[next_++];
+  }
+
+  auto finish(std::size_t) const -> void {}
+};
+
+/// Output passed to a function in parts of up to `part_size` bytes
+///
+/// @tparam F Invocable with a `std::span<const std::byte>` of output.
+///
+template <class F>
+class CallbackSink
+{
+  F consume_;
+  std::vector<std::byte> buffer_;
+
+  auto flush(std::size_t n) -> void
+  {
+    if (n != 0) {
+      std::invoke(consume_, std::span<const std::byte>{buffer_}.first(n));
+    }
+  }
+
+public:
+  static constexpr bool contiguous = false;
+  static constexpr std::size_t part_size = detail::output_part_size;
+
+  explicit CallbackSink(F consume)
+      : consume_{std::move(consume)}, buffer_(part_size)
+  {}
+
+  auto next(std::size_t n) -> std::span<std::byte>
+  {
+    flush(n);
+    return buffer_;
+  }
+
+  auto finish(std::size_t n) -> void { flush(n); }
+};
+
+/// Decompresses a DEFLATE stream into an output sink
+///
+/// The loop driving the decompressor is specialized for each kind of sink:
+/// contiguous sinks are decompressed into directly, with the output so far as
+/// the window, while other sinks are decompressed into part by part, keeping
+/// the window between parts.
+///
+/// @param src The stream. Bytes following the stream are not read.
+/// @param sink The destination.
+/// @return The size of the stream and the number of bytes of output, with a
+///     status as for `decompress`. `DstTooSmall` means the sink ran out of
+///     space, after `dst_written` bytes. `src_consumed` is zero unless the
+///     status is `Success`.
+///
+template <class Sink>
+  requires OutputSink<std::remove_cvref_t<Sink>>
+auto decompress(std::span<const std::byte> src, Sink&& sink) -> DecompressResult
+{
+  auto state = detail::InflateState{
+      .src_bits = huffman::bit_reader{huffman::bit_span{src}}};
+  auto status = DecompressStatus::Success;
+  auto dst_written = 0UZ;
+
+  if constexpr (std::remove_cvref_t<Sink>::contiguous) {
+    auto output = detail::InflateOutput{.dst = sink.next(0)};
+    while (true) {
+      status = detail::inflate(state, output);
+      if (status != DecompressStatus::DstTooSmall) {
+        break;
+      }
+      const auto dst = sink.next(output.written);
+      if (dst.size() <= output.written) {
+        break;
+      }
+      output.dst = dst;
+    }
+    dst_written = output.written;
+    sink.finish(output.written);
+  } else {
+    auto history = detail::OutputHistory{};
+    auto output = detail::InflateOutput{.dst = sink.next(0)};
+    while (true) {
+      status = detail::inflate(state, output);
+      dst_written += output.written;
+      if (status != DecompressStatus::DstTooSmall) {
+        break;
+      }
+      history.append(output.dst.first(output.written));
+      const auto dst = sink.next(output.written);
+      output = {.dst = dst, .written = 0, .history = history.view()};
+      if (dst.empty()) {
+        break;
+      }
+    }
+    sink.finish(output.written);
+  }
+
+  if (status != DecompressStatus::Success) {
+    // src is the entire stream, so a missing block header is invalid.
+    if (status == DecompressStatus::SrcTooSmall and
+        state.step == detail::InflateState::Step::Header) {
+      status = DecompressStatus::InvalidBlockHeader;
+    }
+    return {.status = status, .src_consumed = 0, .dst_written = dst_written};
+  }
+  state.src_bits.unbuffer();
+  return {
+      .status = status,
+      .src_consumed =
+          static_cast<std::size_t>(state.src_bits.next_byte() - src.data()),
+      .dst_written = dst_written};
+}
+
+}  // namespace starflate
@@ -0,0 +1,220 @@
+#include "parallel_compress.hpp"
+
+#include "src/checksum.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace starflate {
+namespace {
+
+// ID1, ID2, CM = deflate, no flags, no modification time, no extra flags and
+// an unknown OS, RFC 1952 2.3
+constexpr auto gzip_header = std::array<std::byte, 10>{
+    std::byte{0x1F},
+    std::byte{0x8B},
+    std::byte{8},
+    std::byte{},
+    std::byte{},
+    std::byte{},
+    std::byte{},
+    std::byte{},
+    std::byte{},
+    std::byte{0xFF}};
+// CRC32 and ISIZE
+constexpr std::size_t gzip_trailer_size = 8;
+
+// Compressed chunks that may be waiting to be written to the output, per
+// thread. Limits memory use, while allowing threads to work ahead of a chunk
+// that takes longer to compress.
+constexpr std::size_t pending_chunks_per_thread = 2;
+
+auto chunk_count(std::size_t src_size, std::size_t chunk_size) -> std::size_t
+{
+  // an empty input is compressed as one empty chunk
+  return std::max(1UZ, (src_size + chunk_size - 1) / chunk_size);
+}
+
+auto framing_size(CompressFormat format) -> std::size_t
+{
+  return format == CompressFormat::Gzip
+             ? gzip_header.size() + gzip_trailer_size
+             : 0;
+}
+
+auto store_le32(std::uint32_t value, std::span<std::byte> dst) -> void
+{
+  for (auto i = 0UZ; i != sizeof(value); ++i) {
+    dst[i] = static_cast<std::byte>(value >> (i * CHAR_BIT));
+  }
+}
+
+/// A chunk of input compressed by a worker thread
+///
+struct Chunk
+{
+  std::vector<std::byte> compressed;
+  CompressResult result{};
+  std::uint32_t crc{};
+  bool done{};
+};
+
+}  // namespace
+
+auto parallel_compress_bound(
+    std::size_t src_size, const ParallelCompressOptions& options)
+    -> std::size_t
+{
+  const auto chunk_size = std::clamp(
+      options.chunk_size, min_parallel_chunk_size, max_parallel_chunk_size);
+  const auto n_chunks = chunk_count(src_size, chunk_size);
+  const auto last_chunk_size = src_size - ((n_chunks - 1) * chunk_size);
+  return framing_size(options.format) +
+         ((n_chunks - 1) * compress_bound(chunk_size)) +
+         compress_bound(last_chunk_size);
+}
+
+auto compress_parallel(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    const ParallelCompressOptions& options) -> CompressResult
+{
+  if (options.level > max_compress_level) {
+    return {.status = CompressStatus::InvalidLevel, .dst_written = 0};
+  }
+  const auto chunk_size = options.chunk_size;
+  if (chunk_size < min_parallel_chunk_size or
+      chunk_size > max_parallel_chunk_size) {
+    return {.status = CompressStatus::InvalidChunkSize, .dst_written = 0};
+  }
+  const auto gzip = options.format == CompressFormat::Gzip;
+  const auto trailer_size = gzip ? gzip_trailer_size : 0;
+  if (dst.size() < framing_size(options.format)) {
+    return {.status = CompressStatus::DstTooSmall, .dst_written = 0};
+  }
+
+  const auto n_chunks = chunk_count(src.size(), chunk_size);
+  const auto n_threads = std::min<std::size_t>(
+      n_chunks,
+      options.threads != 0 ? options.threads
+                           : std::max(1U, std::thread::hardware_concurrency()));
+
+  // Chunk i is compressed into slot i % slots.size(). A thread may take the
+  // next chunk once the chunk that last used its slot has been written.
+  auto slots = std::vector<Chunk>(n_threads * pending_chunks_per_thread);
+  auto mutex = std::mutex{};
+  auto changed = std::condition_variable{};
+  auto next_chunk = 0UZ;
+  auto written_chunks = 0UZ;
+  auto stop = false;
+
+  const auto compress_chunks = [&] {
+    while (true) {
+      auto index = 0UZ;
+      {
+        auto lock = std::unique_lock{mutex};
+        changed.wait(lock, [&] {
+          return stop or next_chunk == n_chunks or
+                 next_chunk < written_chunks + slots.size();
+        });
+        if (stop or next_chunk == n_chunks) {
+          return;
+        }
+        index = next_chunk++;
+      }
+
+      auto& chunk = slots[index % slots.size()];
+      const auto start = index * chunk_size;
+      const auto size = std::min(chunk_size, src.size() - start);
+      const auto history = std::min(start, max_history_size);
+      chunk.compressed.resize(compress_bound(size));
+      chunk.result = compress_part(
+          src.subspan(start - history, history + size),
+          history,
+          chunk.compressed,
+          options.level,
+          index + 1 == n_chunks ? Flush::Finish : Flush::Sync);
+      if (gzip) {
+        chunk.crc = crc32(src.subspan(start, size));
+      }
+
+      {
+        const auto lock = std::lock_guard{mutex};
+        chunk.done = true;
+      }
+      changed.notify_all();
+    }
+  };
+
+  auto result = CompressResult{
+      .status = CompressStatus::Success,
+      .dst_written = gzip ? gzip_header.size() : 0};
+  if (gzip) {
+    std::ranges::copy(gzip_header, dst.begin());
+  }
+  auto crc = crc32({});
+  {
+    auto threads = std::vector<std::jthread>{};
+    threads.reserve(n_threads);
+    for (auto i = 0UZ; i != n_threads; ++i) {
+      threads.emplace_back(compress_chunks);
+    }
+
+    // write the chunks in order as they are completed
+    for (auto index = 0UZ; index != n_chunks; ++index) {
+      auto& chunk = slots[index % slots.size()];
+      {
+        auto lock = std::unique_lock{mutex};
+        changed.wait(lock, [&chunk] { return chunk.done; });
+      }
+
+      const auto compressed =
+          std::span{chunk.compressed}.first(chunk.result.dst_written);
+      if (chunk.result.status != CompressStatus::Success or
+          dst.size() - result.dst_written < compressed.size() + trailer_size) {
+        result.status = chunk.result.status == CompressStatus::Success
+                            ? CompressStatus::DstTooSmall
+                            : chunk.result.status;
+        break;
+      }
+      std::ranges::copy(compressed, dst.subspan(result.dst_written).begin());
+      result.dst_written += compressed.size();
+      if (gzip) {
+        const auto start = index * chunk_size;
+        crc = crc32_combine(
+            crc, chunk.crc, std::min(chunk_size, src.size() - start));
+      }
+
+      {
+        const auto lock = std::lock_guard{mutex};
+        chunk.done = false;
+        ++written_chunks;
+      }
+      changed.notify_all();
+    }
+
+    {
+      const auto lock = std::lock_guard{mutex};
+      stop = true;
+    }
+    changed.notify_all();
+  }
+
+  if (result.status == CompressStatus::Success and gzip) {
+    const auto trailer = dst.subspan(result.dst_written, trailer_size);
+    store_le32(crc, trailer);
+    store_le32(
+        static_cast<std::uint32_t>(src.size()),
+        trailer.subspan(sizeof(std::uint32_t)));
+    result.dst_written += trailer_size;
+  }
+  return result;
+}
+
+}  // namespace starflate
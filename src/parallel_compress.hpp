@@ -0,0 +1,80 @@
+#pragma once
+
+#include "src/compress.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace starflate {
+
+/// Format of the output of `compress_parallel`
+///
+enum class CompressFormat : std::uint8_t
+{
+  /// A raw DEFLATE stream, RFC 1951
+  Deflate,
+  /// A gzip member, RFC 1952
+  Gzip,
+};
+
+/// Range and default of the size of the chunks compressed in parallel
+///
+/// Smaller chunks allow more parallelism, but lose more compression at chunk
+/// boundaries.
+///
+/// @{
+inline constexpr std::size_t min_parallel_chunk_size = std::size_t{1} << 17U;
+inline constexpr std::size_t max_parallel_chunk_size = std::size_t{1} << 20U;
+inline constexpr std::size_t default_parallel_chunk_size =
+    min_parallel_chunk_size;
+/// @}
+
+struct ParallelCompressOptions
+{
+  CompressFormat format{CompressFormat::Deflate};
+  std::uint8_t level{default_compress_level};
+  /// Size of the chunks the input is split into, from
+  /// `min_parallel_chunk_size` to `max_parallel_chunk_size`.
+  std::size_t chunk_size{default_parallel_chunk_size};
+  /// Number of threads compressing chunks, or 0 for one per hardware thread.
+  /// Does not affect the output.
+  std::size_t threads{};
+};
+
+/// Returns the maximum size of the output of `compress_parallel` for
+/// `src_size` bytes
+///
+auto parallel_compress_bound(
+    std::size_t src_size, const ParallelCompressOptions& options = {})
+    -> std::size_t;
+
+/// Compresses the given source data using multiple threads, as for pigz
+///
+/// The input is split into chunks that are compressed concurrently. Each
+/// chunk may refer back to the last 32 KiB of the chunk before it, and all
+/// but the last end with a sync flush, so the compressed chunks concatenate
+/// into a single stream. For gzip, the CRC-32 of the whole input is combined
+/// from the CRC-32s of the chunks, which are also computed concurrently.
+///
+/// The output depends only on the input, format, level and chunk size, not
+/// on the number of threads or their scheduling.
+///
+/// Compressed chunks are written to `dst` in order as they complete, and at
+/// most a few chunks per thread are buffered at a time.
+///
+/// @param src The data to compress.
+/// @param dst The destination buffer. `parallel_compress_bound` of the size
+///     of `src` is large enough.
+/// @return The number of bytes written to `dst`, with a status of:
+///     * `Success` if all of `src` was compressed.
+///     * `DstTooSmall` if the output does not fit in `dst`.
+///     * `InvalidLevel` if the level is out of range.
+///     * `InvalidChunkSize` if the chunk size is out of range.
+///
+auto compress_parallel(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    const ParallelCompressOptions& options = {}) -> CompressResult;
+
+}  // namespace starflate
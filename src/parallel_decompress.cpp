@@ -0,0 +1,587 @@
+#include "parallel_decompress.hpp"
+
+#include "src/checksum.hpp"
+#include "src/gzip.hpp"
+#include "src/output_sink.hpp"
+#include "src/speculative_inflate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace starflate {
+namespace {
+
+// ID1, ID2 and CM = deflate, RFC 1952 2.3
+constexpr auto gzip_magic =
+    std::array<std::byte, 3>{std::byte{0x1F}, std::byte{0x8B}, std::byte{8}};
+// CRC32 and ISIZE
+constexpr std::size_t gzip_trailer_size = 8;
+
+// Bytes of output decompressed to check that a candidate member starts with a
+// valid DEFLATE stream. Random data rarely gets this far: back-references
+// before the start of the member, invalid codes and invalid block headers are
+// all rejected.
+constexpr std::size_t probe_size = 4096;
+
+// Chunks decompressed speculatively that may be waiting to be resolved, per
+// thread. Limits memory use, while allowing threads to work ahead of a chunk
+// that takes longer to decompress.
+constexpr std::size_t pending_chunks_per_thread = 2;
+
+// Maximum output of a chunk decompressed speculatively, relative to the size
+// of the chunk. Limits the memory of each pending chunk to a few times its
+// size rather than the size of the output. Chunks of more compressible data
+// stop early, and the rest is decompressed when they are resolved.
+constexpr std::size_t max_speculative_expansion = 8;
+
+auto load_le32(std::span<const std::byte> bytes) -> std::uint32_t
+{
+  auto value = std::uint32_t{};
+  for (auto i = 0UZ; i != sizeof(value); ++i) {
+    value |= std::to_integer<std::uint32_t>(bytes[i]) << (i * CHAR_BIT);
+  }
+  return value;
+}
+
+auto thread_count(std::size_t threads) -> std::size_t
+{
+  return threads != 0 ? threads
+                      : std::max(1U, std::thread::hardware_concurrency());
+}
+
+/// Calls `f(i)` for each `i` in [0, n) on up to `threads` threads, including
+/// the calling thread
+///
+template <class F>
+auto parallel_for(std::size_t n, std::size_t threads, const F& f) -> void
+{
+  auto next = std::atomic<std::size_t>{};
+  const auto work = [&next, n, &f] {
+    for (auto i = next++; i < n; i = next++) {
+      f(i);
+    }
+  };
+
+  auto pool = std::vector<std::jthread>{};
+  const auto n_threads = std::min(n, threads);
+  for (auto i = 1UZ; i < n_threads; ++i) {
+    pool.emplace_back(work);
+  }
+  work();
+}
+
+/// Offsets at which a gzip member may start, the first of which is 0
+///
+auto find_member_starts(std::span<const std::byte> src, std::size_t threads)
+    -> std::vector<std::size_t>
+{
+  auto candidates = std::vector<std::size_t>{};
+  for (auto offset = 1UZ; offset < src.size();) {
+    const auto found = std::ranges::search(src.subspan(offset), gzip_magic);
+    if (found.empty()) {
+      break;
+    }
+    offset = static_cast<std::size_t>(found.begin() - src.begin());
+    candidates.push_back(offset++);
+  }
+
+  // std::vector<bool> elements cannot be written concurrently
+  auto valid = std::vector<std::uint8_t>(candidates.size());
+  parallel_for(candidates.size(), threads, [&](std::size_t i) {
+    valid[i] = detail::is_gzip_member_start(src.subspan(candidates[i]));
+  });
+
+  auto starts = std::vector<std::size_t>{0};
+  for (auto i = 0UZ; i != candidates.size(); ++i) {
+    if (valid[i] != 0) {
+      starts.push_back(candidates[i]);
+    }
+  }
+  return starts;
+}
+
+/// Decompresses the segment of a stream from checkpoint `i` of `index` to
+/// the next checkpoint, or to the end of the stream, into its offset in `dst`
+///
+/// @return `Success` if the segment ends exactly where the index says, or
+///     another status.
+///
+auto decompress_segment(
+    std::span<const std::byte> src,
+    const Index& index,
+    std::size_t i,
+    std::span<std::byte> dst) -> DecompressStatus
+{
+  using Step = detail::InflateState::Step;
+
+  const auto stream = src.first(index.src_size);
+  const auto& checkpoint = index.checkpoints[i];
+  const auto last = i + 1 == index.checkpoints.size();
+  const auto end_offset =
+      last ? index.dst_size : index.checkpoints[i + 1].dst_offset;
+
+  auto state = detail::resume_at(stream, checkpoint);
+  auto output = detail::InflateOutput{
+      .dst = dst.subspan(
+          checkpoint.dst_offset, end_offset - checkpoint.dst_offset),
+      .history = checkpoint.window};
+  do {
+    const auto status = detail::inflate_to_block_end(state, output);
+    if (status == DecompressStatus::DstTooSmall) {
+      // a block continues past the next checkpoint
+      return DecompressStatus::InvalidIndex;
+    }
+    if (status != DecompressStatus::Success) {
+      return status;
+    }
+    // the last segment may end with empty blocks
+  } while ((last or output.written != output.dst.size()) and
+           state.step != Step::Done);
+
+  if (output.written != output.dst.size()) {
+    return DecompressStatus::InvalidIndex;
+  }
+  if (last) {
+    state.src_bits.unbuffer();
+    const auto consumed =
+        static_cast<std::size_t>(state.src_bits.next_byte() - stream.data());
+    return consumed == stream.size() ? DecompressStatus::Success
+                                     : DecompressStatus::InvalidIndex;
+  }
+  const auto end_bit = (stream.size() * CHAR_BIT) - state.src_bits.size();
+  return state.step == Step::Header and
+                 end_bit == index.checkpoints[i + 1].src_bit
+             ? DecompressStatus::Success
+             : DecompressStatus::InvalidIndex;
+}
+
+/// A chunk of input decompressed speculatively by a worker thread
+///
+struct SpeculativeChunk
+{
+  std::vector<detail::Symbol> symbols;
+  detail::SymbolResult result{};
+  /// Offset of the first block decompressed, if one was found
+  std::optional<std::size_t> begin_bit;
+  bool done{};
+};
+
+/// Decompresses a member as for `decompress_gzip`, using
+/// `decompress_parallel` if `options.speculative` is set
+///
+auto decompress_member(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    const ParallelDecompressOptions& options) -> DecompressResult
+{
+  if (not options.speculative) {
+    return decompress_gzip(src, dst);
+  }
+
+  const auto header = read_gzip_header(src);
+  if (not header) {
+    return {.status = header.error(), .src_consumed = 0, .dst_written = 0};
+  }
+  auto result = decompress_parallel(src.subspan(header->size), dst, options);
+  const auto trailer_offset = header->size + result.src_consumed;
+  result.src_consumed = 0;
+  if (result.status != DecompressStatus::Success) {
+    return result;
+  }
+  if (src.size() - trailer_offset < gzip_trailer_size) {
+    result.status = DecompressStatus::SrcTooSmall;
+    return result;
+  }
+
+  const auto trailer = src.subspan(trailer_offset, gzip_trailer_size);
+  if (load_le32(trailer) != crc32(dst.first(result.dst_written))) {
+    result.status = DecompressStatus::ChecksumMismatch;
+  } else if (
+      load_le32(trailer.subspan(sizeof(std::uint32_t))) !=
+      static_cast<std::uint32_t>(result.dst_written)) {
+    // ISIZE is the size modulo 2^32
+    result.status = DecompressStatus::SizeMismatch;
+  } else {
+    result.src_consumed = trailer_offset + gzip_trailer_size;
+  }
+  return result;
+}
+
+/// A member found by `find_member_starts`, not yet verified
+///
+struct Member
+{
+  std::size_t src_offset;
+  std::size_t src_size;
+  std::size_t dst_offset;
+  /// From the trailer at the end of the member
+  std::size_t dst_size;
+  bool verified;
+};
+
+}  // namespace
+
+namespace detail {
+
+auto is_gzip_member_start(std::span<const std::byte> src) -> bool
+{
+  const auto header = read_gzip_header(src);
+  if (not header) {
+    return false;
+  }
+
+  auto state = InflateState{
+      .src_bits =
+          huffman::bit_reader{huffman::bit_span{src.subspan(header->size)}}};
+  auto probe = std::array<std::byte, probe_size>{};
+  auto output = InflateOutput{.dst = probe};
+  const auto status = inflate(state, output);
+  // the member may end before the probe is full, or continue past it
+  return status == DecompressStatus::Success or
+         status == DecompressStatus::DstTooSmall;
+}
+
+}  // namespace detail
+
+auto decompress_parallel(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    const ParallelDecompressOptions& options) -> DecompressResult
+{
+  const auto chunk_bits =
+      std::max(options.chunk_size, min_speculative_chunk_size) * CHAR_BIT;
+  const auto src_bits = src.size() * CHAR_BIT;
+  const auto n_chunks =
+      std::max(1UZ, (src_bits + chunk_bits - 1) / chunk_bits);
+  const auto chunk_end = [chunk_bits, src_bits](std::size_t index) {
+    return std::min((index + 1) * chunk_bits, src_bits);
+  };
+  const auto max_chunk_output = std::min(
+      dst.size(), (chunk_bits / CHAR_BIT) * max_speculative_expansion);
+  // The calling thread decompresses the first chunk and resolves the others
+  // in order, which the other threads decompress speculatively.
+  const auto n_threads =
+      std::min(n_chunks - 1, thread_count(options.threads) - 1);
+  if (n_threads == 0) {
+    return decompress(src, SpanSink{dst});
+  }
+
+  // Chunk i is decompressed into slot i % slots.size(). A thread may take the
+  // next chunk once the chunk that last used its slot has been resolved.
+  auto slots =
+      std::vector<SpeculativeChunk>(n_threads * pending_chunks_per_thread);
+  auto mutex = std::mutex{};
+  auto changed = std::condition_variable{};
+  auto next_chunk = 1UZ;
+  auto resolved_chunks = 1UZ;
+  auto stop = false;
+
+  const auto decompress_chunks = [&] {
+    while (true) {
+      auto index = 0UZ;
+      {
+        auto lock = std::unique_lock{mutex};
+        changed.wait(lock, [&] {
+          return stop or next_chunk == n_chunks or
+                 next_chunk < resolved_chunks + slots.size();
+        });
+        if (stop or next_chunk == n_chunks) {
+          return;
+        }
+        index = next_chunk++;
+      }
+
+      // Decompress from the first candidate block that decompresses without
+      // error. The window is unknown, so back-references are valid up to the
+      // maximum distance.
+      auto& chunk = slots[index % slots.size()];
+      chunk.begin_bit.reset();
+      for (auto bit = index * chunk_bits;;) {
+        const auto found =
+            detail::find_dynamic_block(src, bit, chunk_end(index));
+        if (not found) {
+          break;
+        }
+        chunk.result = detail::inflate_symbols(
+            src,
+            *found,
+            chunk_end(index),
+            window_size,
+            max_chunk_output,
+            chunk.symbols);
+        // Output past the limit is left to the resolving thread, which
+        // continues from the end of the last complete block.
+        const auto status = chunk.result.status;
+        if (status == DecompressStatus::Success or
+            (status == DecompressStatus::DstTooSmall and
+             chunk.result.end_bit != *found)) {
+          chunk.begin_bit = *found;
+          break;
+        }
+        if (status == DecompressStatus::DstTooSmall) {
+          break;
+        }
+        bit = *found + 1;
+      }
+
+      {
+        const auto lock = std::lock_guard{mutex};
+        chunk.done = true;
+      }
+      changed.notify_all();
+    }
+  };
+
+  auto result = DecompressResult{
+      .status = DecompressStatus::Success, .src_consumed = 0, .dst_written = 0};
+  // offset of the next block to resolve
+  auto position = 0UZ;
+  auto final = false;
+
+  // appends the output of blocks starting at `position`
+  const auto append = [&](std::span<const detail::Symbol> symbols,
+                          const detail::SymbolResult& blocks) {
+    const auto output = symbols.subspan(window_size);
+    const auto written = result.dst_written;
+    if (output.size() > dst.size() - written) {
+      return DecompressStatus::DstTooSmall;
+    }
+    if (written < window_size and
+        not detail::markers_within(output, written)) {
+      return DecompressStatus::InvalidDistance;
+    }
+    detail::resolve_symbols(
+        output, dst.first(written), dst.subspan(written, output.size()));
+    result.dst_written += output.size();
+    position = blocks.end_bit;
+    final = blocks.final;
+    return DecompressStatus::Success;
+  };
+
+  // Decompresses blocks starting at `position` directly into `dst`, up to the
+  // first block starting at or after `stop_bit`. The output preceding them is
+  // known, so unlike speculative chunks they need no symbols.
+  const auto inflate_direct = [&](std::size_t stop_bit) {
+    using Step = detail::InflateState::Step;
+
+    auto state = detail::InflateState{
+        .src_bits = huffman::bit_reader{
+            src.subspan(position / CHAR_BIT).data(),
+            src_bits - position,
+            static_cast<std::uint8_t>(position % CHAR_BIT)}};
+    const auto written = result.dst_written;
+    auto output = detail::InflateOutput{
+        .dst = dst.subspan(written), .history = dst.first(written)};
+    while (not final and position < stop_bit) {
+      if (const auto status = detail::inflate_to_block_end(state, output);
+          status != DecompressStatus::Success) {
+        return status;
+      }
+      result.dst_written = written + output.written;
+      position = src_bits - state.src_bits.size();
+      final = state.step == Step::Done;
+    }
+    return DecompressStatus::Success;
+  };
+
+  {
+    auto threads = std::vector<std::jthread>{};
+    threads.reserve(n_threads);
+    for (auto i = 0UZ; i != n_threads; ++i) {
+      threads.emplace_back(decompress_chunks);
+    }
+
+    for (auto index = 0UZ; index != n_chunks and not final and
+                           result.status == DecompressStatus::Success;
+         ++index) {
+      SpeculativeChunk* chunk = nullptr;
+      if (index != 0) {
+        chunk = &slots[index % slots.size()];
+        auto lock = std::unique_lock{mutex};
+        changed.wait(lock, [chunk] { return chunk->done; });
+      }
+
+      // Blocks up to the first one starting after the chunk may already have
+      // been decompressed with the chunk before.
+      while (not final and position < chunk_end(index) and
+             result.status == DecompressStatus::Success) {
+        if (chunk != nullptr and chunk->begin_bit == position) {
+          result.status = append(chunk->symbols, chunk->result);
+          continue;
+        }
+        // Decompress up to the speculative start, in case it is a block
+        // boundary, or else to the end of the chunk.
+        const auto stop_bit =
+            chunk != nullptr and chunk->begin_bit > position
+                ? *chunk->begin_bit
+                : chunk_end(index);
+        result.status = inflate_direct(stop_bit);
+      }
+
+      if (chunk != nullptr) {
+        {
+          const auto lock = std::lock_guard{mutex};
+          chunk->done = false;
+          resolved_chunks = index + 1;
+        }
+        changed.notify_all();
+      }
+    }
+
+    {
+      const auto lock = std::lock_guard{mutex};
+      stop = true;
+    }
+    changed.notify_all();
+  }
+
+  if (result.status == DecompressStatus::Success and not final) {
+    result.status = DecompressStatus::SrcTooSmall;
+  }
+  if (result.status == DecompressStatus::Success) {
+    result.src_consumed = (position + CHAR_BIT - 1) / CHAR_BIT;
+  }
+  return result;
+}
+
+auto decompress_parallel(
+    std::span<const std::byte> src,
+    const Index& index,
+    std::span<std::byte> dst,
+    const ParallelDecompressOptions& options) -> DecompressResult
+{
+  auto result = DecompressResult{
+      .status = DecompressStatus::Success, .src_consumed = 0, .dst_written = 0};
+  if (not detail::valid(index)) {
+    result.status = DecompressStatus::InvalidIndex;
+  } else if (src.size() < index.src_size) {
+    result.status = DecompressStatus::SrcTooSmall;
+  } else if (dst.size() < index.dst_size) {
+    result.status = DecompressStatus::DstTooSmall;
+  }
+  if (result.status != DecompressStatus::Success) {
+    return result;
+  }
+
+  const auto& checkpoints = index.checkpoints;
+  auto statuses = std::vector<DecompressStatus>(checkpoints.size());
+  parallel_for(
+      checkpoints.size(), thread_count(options.threads), [&](std::size_t i) {
+        statuses[i] = decompress_segment(src, index, i, dst);
+      });
+
+  // Each segment was decompressed with the window stored in the index, which
+  // must be the output preceding it.
+  for (auto i = 0UZ; i != checkpoints.size(); ++i) {
+    const auto& checkpoint = checkpoints[i];
+    if (statuses[i] == DecompressStatus::Success and
+        not std::ranges::equal(
+            checkpoint.window,
+            dst.first(checkpoint.dst_offset)
+                .last(checkpoint.window.size()))) {
+      statuses[i] = DecompressStatus::InvalidIndex;
+    }
+    if (statuses[i] != DecompressStatus::Success) {
+      result.status = statuses[i];
+      result.dst_written = checkpoint.dst_offset;
+      return result;
+    }
+  }
+
+  result.src_consumed = index.src_size;
+  result.dst_written = index.dst_size;
+  return result;
+}
+
+auto decompress_gzip_parallel(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    const ParallelDecompressOptions& options) -> DecompressResult
+{
+  if (src.empty()) {
+    return {
+        .status = DecompressStatus::SrcTooSmall,
+        .src_consumed = 0,
+        .dst_written = 0};
+  }
+  const auto threads = thread_count(options.threads);
+
+  const auto starts = find_member_starts(src, threads);
+
+  auto members = std::vector<Member>{};
+  members.reserve(starts.size());
+  auto dst_offset = 0UZ;
+  for (auto i = 0UZ; i != starts.size(); ++i) {
+    const auto end = i + 1 != starts.size() ? starts[i + 1] : src.size();
+    const auto size = end - starts[i];
+    // ISIZE, the size modulo 2^32
+    const auto dst_size =
+        size >= gzip_trailer_size
+            ? std::size_t{load_le32(src.subspan(end - sizeof(std::uint32_t)))}
+            : 0;
+    members.push_back(
+        {.src_offset = starts[i],
+         .src_size = size,
+         .dst_offset = dst_offset,
+         .dst_size = dst_size,
+         .verified = false});
+    dst_offset += dst_size;
+  }
+
+  // Members occupy disjoint ranges of dst, so they are decompressed
+  // concurrently even if some candidates are not actually boundaries.
+  // Verified members are at their final offsets. A single member is
+  // decompressed with all threads if speculative decompression is enabled.
+  const auto member_options =
+      members.size() == 1 ? options : ParallelDecompressOptions{};
+  parallel_for(members.size(), threads, [&](std::size_t i) {
+    auto& member = members[i];
+    if (member.dst_offset > dst.size() or
+        member.dst_size > dst.size() - member.dst_offset) {
+      return;
+    }
+    const auto result = decompress_member(
+        src.subspan(member.src_offset, member.src_size),
+        dst.subspan(member.dst_offset, member.dst_size),
+        member_options);
+    member.verified = result.status == DecompressStatus::Success and
+                      result.src_consumed == member.src_size;
+  });
+
+  const auto unverified = std::ranges::find(members, false, &Member::verified);
+  if (unverified == members.end()) {
+    return {
+        .status = DecompressStatus::Success,
+        .src_consumed = src.size(),
+        .dst_written = dst_offset};
+  }
+
+  // decompress the rest sequentially from the first member not verified
+  auto result = DecompressResult{
+      .status = DecompressStatus::Success,
+      .src_consumed = unverified->src_offset,
+      .dst_written = unverified->dst_offset};
+  while (result.src_consumed != src.size()) {
+    const auto member = decompress_member(
+        src.subspan(result.src_consumed),
+        dst.subspan(result.dst_written),
+        options);
+    if (member.status != DecompressStatus::Success) {
+      result.status = member.status;
+      break;
+    }
+    result.src_consumed += member.src_consumed;
+    result.dst_written += member.dst_written;
+  }
+  return result;
+}
+
+}  // namespace starflate
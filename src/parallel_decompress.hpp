@@ -0,0 +1,144 @@
+#pragma once
+
+#include "src/decompress.hpp"
+#include "src/index.hpp"
+
+#include <cstddef>
+#include <span>
+
+namespace starflate {
+
+/// Minimum and default size of the chunks of compressed input decompressed
+/// speculatively by `decompress_parallel`
+///
+/// Larger chunks spend less time searching for the first block, but buffer
+/// more output per thread.
+///
+/// @{
+inline constexpr std::size_t min_speculative_chunk_size =
+    std::size_t{1} << 12U;
+inline constexpr std::size_t default_speculative_chunk_size =
+    std::size_t{1} << 20U;
+/// @}
+
+struct ParallelDecompressOptions
+{
+  /// Number of threads decompressing, or 0 for one per hardware thread. Does
+  /// not affect the output.
+  std::size_t threads{};
+  /// Whether `decompress_gzip_parallel` decompresses each member with
+  /// `decompress_parallel` when members cannot be decompressed concurrently,
+  /// e.g. a file of a single member.
+  bool speculative{};
+  /// Size of the chunks of compressed input for `decompress_parallel`. Sizes
+  /// below `min_speculative_chunk_size` are rounded up to it.
+  std::size_t chunk_size{default_speculative_chunk_size};
+};
+
+/// Decompresses a DEFLATE stream using multiple threads
+///
+/// The input is split into chunks that are decompressed speculatively and
+/// concurrently, as for rapidgzip. Each thread searches its chunk for the
+/// first offset at which a dynamic block plausibly starts, and decompresses
+/// from there before the output preceding it is known. Back-references into
+/// that unknown window are output as markers for the bytes they copy, which
+/// are replaced once the chunk before it has been decompressed.
+///
+/// Chunks are resolved in order. Speculative output is used only if it
+/// starts where the output of the chunk before it ends, so the result is
+/// the same as for `decompress`. Where no block is found or the candidate is
+/// not a block boundary, e.g. for streams of stored or fixed Huffman blocks,
+/// the chunk is decompressed directly into `dst` after the chunk before it
+/// instead, as is the first chunk. At most a few chunks per thread are
+/// buffered at a time.
+///
+/// @param src The stream. Bytes following the stream are not read, except
+///     when searching for blocks.
+/// @param dst The destination buffer. Bytes following the decompressed data
+///     may be overwritten.
+/// @return The size of the stream and the number of bytes written to `dst`,
+///     with a status as for `decompress`. `src_consumed` is zero unless the
+///     status is `Success`.
+///
+auto decompress_parallel(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    const ParallelDecompressOptions& options = {}) -> DecompressResult;
+
+/// Decompresses a DEFLATE stream using multiple threads and an index of it
+///
+/// Each checkpoint of `index`, e.g. built by `build_index` in an earlier
+/// pass, starts a segment of the stream that can be decompressed on its own
+/// using the window stored with it. Segments are decompressed concurrently,
+/// each directly into its offset in `dst`, so an index with checkpoints
+/// every few MiB lets large streams be decompressed on all cores.
+///
+/// Each segment is checked to end exactly at the next checkpoint and each
+/// window to match the output preceding it, so the output is the same as
+/// for `decompress`.
+///
+/// @param src The stream `index` was built from.
+/// @param index The index of the stream.
+/// @param dst The destination buffer, of at least `index.dst_size` bytes.
+/// @return The size of the stream and the number of bytes written to `dst`,
+///     with a status of:
+///     * `Success` if the stream was decompressed.
+///     * `SrcTooSmall` or `DstTooSmall` if `src` or `dst` is smaller than
+///       recorded in `index`.
+///     * `InvalidIndex` if `index` is not valid or does not match the stream.
+///     * another status as for `decompress` for the first segment that could
+///       not be decompressed. `dst_written` is the offset of that segment.
+///     `src_consumed` is zero unless the status is `Success`.
+///
+auto decompress_parallel(
+    std::span<const std::byte> src,
+    const Index& index,
+    std::span<std::byte> dst,
+    const ParallelDecompressOptions& options = {}) -> DecompressResult;
+
+/// Decompresses a gzip file of one or more members using multiple threads
+///
+/// A gzip file may be a concatenation of members, e.g. written by parallel
+/// writers or by `cat` of several files, RFC 1952 2.2. Each member starts
+/// with an empty window, so members are decompressed concurrently, each
+/// directly into its final offset in `dst`, and each is verified against its
+/// own trailer.
+///
+/// Member boundaries are not recorded in the file. Candidates are found by
+/// searching for headers accepted by `read_gzip_header` that are followed by
+/// the start of a valid DEFLATE stream, and the offset of each member in the
+/// output is the sum of the sizes in the trailers preceding it. If a
+/// candidate turns out not to be a boundary, e.g. the header bytes occur
+/// within compressed data or a member is larger than 4 GiB, the rest of the
+/// file from the member before it is decompressed sequentially, so the
+/// output is the same as decompressing the members one after another.
+///
+/// Members decompressed sequentially use `decompress_parallel` if
+/// `options.speculative` is set.
+///
+/// @param src The gzip file. All of it must consist of members.
+/// @param dst The destination buffer. Bytes following the decompressed data
+///     may be overwritten.
+/// @return The number of bytes of `src` consumed and written to `dst`, with a
+///     status of:
+///     * `Success` if all members were decompressed and verified.
+///     * another status as for `decompress_gzip` for the first member that
+///       could not be decompressed. `src_consumed` and `dst_written` are those
+///       of the members before it.
+///
+auto decompress_gzip_parallel(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    const ParallelDecompressOptions& options = {}) -> DecompressResult;
+
+namespace detail {
+
+/// Returns `true` if a gzip member may start at the beginning of `src`
+///
+/// Checks the member header and decompresses the start of the member.
+///
+auto is_gzip_member_start(std::span<const std::byte> src) -> bool;
+
+}  // namespace detail
+
+}  // namespace starflate
@@ -0,0 +1,527 @@
+#include "speculative_inflate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <climits>
+#include <cstring>
+
+namespace starflate::detail {
+namespace {
+
+constexpr auto length_max = std::size_t{258};
+
+// a 15-bit length code, 5 extra length bits, a 15-bit distance code and 13
+// extra distance bits
+constexpr std::uint8_t max_length_distance_bits = 48;
+
+// RFC 3.2.7: Dynamic Huffman codes
+constexpr std::size_t n_len_codes_max = 286;
+constexpr std::size_t n_dist_codes_max = 30;
+constexpr std::uint8_t code_length_code_bitsize_max = 7;
+constexpr std::uint8_t len_code_bitsize_max = 15;
+constexpr auto end_of_block = std::size_t{256};
+
+// a 7-bit code followed by up to 7 repeat count bits
+constexpr std::uint8_t max_code_length_bits = 14;
+
+constexpr std::array<std::uint8_t, 19> code_length_symbols = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+auto make_reader(std::span<const std::byte> src, std::size_t bit)
+    -> huffman::bit_reader
+{
+  if (bit >= src.size() * CHAR_BIT) {
+    return {};
+  }
+  return huffman::bit_reader{
+      src.subspan(bit / CHAR_BIT).data(),
+      (src.size() * CHAR_BIT) - bit,
+      static_cast<std::uint8_t>(bit % CHAR_BIT)};
+}
+
+/// Returns the offset in bits of the next bit of `bits` in `src`
+///
+/// @pre not bits.overrun()
+///
+auto bit_offset(std::span<const std::byte> src, const huffman::bit_reader& bits)
+    -> std::size_t
+{
+  return (src.size() * CHAR_BIT) - bits.size();
+}
+
+/// Returns the bits of `src` starting at `bit`, of which at least 57 are
+/// valid, followed by zero bits past the end of `src`
+///
+auto peek_bits(std::span<const std::byte> src, std::size_t bit)
+    -> std::uint64_t
+{
+  if (bit >= src.size() * CHAR_BIT) {
+    return 0;
+  }
+  auto word = std::uint64_t{};
+  const auto bytes = src.subspan(bit / CHAR_BIT);
+  std::memcpy(&word, bytes.data(), std::min(bytes.size(), sizeof(word)));
+  if constexpr (std::endian::native == std::endian::big) {
+    word = std::byteswap(word);
+  }
+  return word >> (bit % CHAR_BIT);
+}
+
+auto extract_bits(std::uint64_t bits, std::size_t offset, std::uint8_t n)
+    -> std::uint16_t
+{
+  return static_cast<std::uint16_t>(
+      (bits >> offset) & ((std::uint64_t{1} << n) - 1U));
+}
+
+/// Returns the sum of 2^(max_bitsize - bitsize) over the codes, which is
+/// 2^max_bitsize for a complete code, RFC 3.2.2
+///
+auto kraft_sum(std::span<const std::uint8_t> bitsizes, std::uint8_t max_bitsize)
+    -> std::size_t
+{
+  auto sum = std::size_t{};
+  for (const auto bitsize : bitsizes) {
+    if (bitsize != 0) {
+      sum += std::size_t{1} << (max_bitsize - bitsize);
+    }
+  }
+  return sum;
+}
+
+/// Output of the blocks decompressed by `inflate_symbols`
+///
+/// `symbols` is grown ahead of the output, which ends at `size`.
+///
+struct SymbolOutput
+{
+  std::vector<Symbol>& symbols;
+  std::size_t size;
+  // index of the first symbol that back-references may refer to
+  std::size_t min_index;
+  std::size_t max_size;
+
+  /// Makes room for at least `length_max` more symbols, unless that would
+  /// exceed `max_size`
+  auto reserve() -> void
+  {
+    if (symbols.size() - size < length_max and symbols.size() < max_size) {
+      symbols.resize(
+          std::min(max_size, std::max(symbols.size() * 2, size + length_max)));
+    }
+  }
+};
+
+auto inflate_stored_symbols(huffman::bit_reader& bits, SymbolOutput& output)
+    -> DecompressStatus
+{
+  constexpr std::uint8_t kLenBits = 16;
+
+  bits.consume_to_byte_boundary();
+  if (bits.size() < std::size_t{2 * kLenBits}) {
+    return DecompressStatus::SrcTooSmall;
+  }
+  const auto len = static_cast<std::uint16_t>(bits.pop(kLenBits));
+  const auto nlen = static_cast<std::uint16_t>(bits.pop(kLenBits));
+  if (len != static_cast<std::uint16_t>(~nlen)) {
+    return DecompressStatus::NoCompressionLenMismatch;
+  }
+
+  bits.unbuffer();
+  if (bits.size() / CHAR_BIT < len) {
+    return DecompressStatus::SrcTooSmall;
+  }
+  if (output.max_size - output.size < len) {
+    return DecompressStatus::DstTooSmall;
+  }
+  if (output.symbols.size() - output.size < len) {
+    output.symbols.resize(output.size + len);
+  }
+  std::transform(
+      bits.next_byte(),
+      std::next(bits.next_byte(), len),
+      std::next(
+          output.symbols.begin(), static_cast<std::ptrdiff_t>(output.size)),
+      [](std::byte byte) { return std::to_integer<Symbol>(byte); });
+  bits.skip_bytes(len);
+  output.size += len;
+  return DecompressStatus::Success;
+}
+
+template <class Tables>
+auto inflate_huffman_symbols(
+    huffman::bit_reader& bits,
+    const Tables& tables,
+    SymbolOutput& output) -> DecompressStatus
+{
+  using Kind = InflateEntry::Kind;
+
+  const auto& len_table = tables.len_table;
+  const auto& dist_table = tables.dist_table;
+  if (len_table.empty()) {
+    return DecompressStatus::InvalidLitOrLen;
+  }
+
+  while (true) {
+    // zero bits are appended past the end of the input
+    if (bits.unbuffered_bytes() < sizeof(std::uint64_t) and bits.overrun()) {
+      return DecompressStatus::SrcTooSmall;
+    }
+    if (bits.buffered() < max_length_distance_bits) {
+      bits.refill();
+    }
+    const auto peeked = bits.peek(max_length_distance_bits);
+    output.reserve();
+    const auto out = std::span{output.symbols};
+
+    const auto lit_or_len = len_table.find(peeked);
+    if (lit_or_len.kind() == Kind::Literal) {
+      if (output.size == out.size()) {
+        return DecompressStatus::DstTooSmall;
+      }
+      bits.consume(lit_or_len.bitsize());
+      out[output.size++] = lit_or_len.value();
+      continue;
+    }
+    if (lit_or_len.kind() == Kind::EndOfBlock) {
+      bits.consume(lit_or_len.bitsize());
+      return DecompressStatus::Success;
+    }
+    if (lit_or_len.kind() != Kind::Base) {
+      return DecompressStatus::InvalidLitOrLen;
+    }
+
+    auto n_bits = std::size_t{lit_or_len.bitsize()};
+    const auto len = std::size_t{lit_or_len.value()} +
+                     extract_bits(peeked, n_bits, lit_or_len.extra_bits());
+    n_bits += lit_or_len.extra_bits();
+
+    if (dist_table.empty()) {
+      return DecompressStatus::InvalidDistance;
+    }
+    const auto dist_code = dist_table.find(peeked >> n_bits);
+    if (dist_code.kind() != Kind::Base) {
+      return DecompressStatus::InvalidDistance;
+    }
+    n_bits += dist_code.bitsize();
+    const auto distance = std::size_t{dist_code.value()} +
+                          extract_bits(peeked, n_bits, dist_code.extra_bits());
+    n_bits += dist_code.extra_bits();
+    bits.consume(static_cast<std::uint8_t>(n_bits));
+
+    if (distance > output.size - output.min_index) {
+      return DecompressStatus::InvalidDistance;
+    }
+    if (out.size() - output.size < len) {
+      return DecompressStatus::DstTooSmall;
+    }
+    const auto from = output.size - distance;
+    if (distance >= len) {
+      std::ranges::copy(out.subspan(from, len), out.begin() + output.size);
+    } else {
+      // the match repeats the distance symbols before it
+      for (auto i = 0UZ; i != len; ++i) {
+        out[output.size + i] = out[from + i];
+      }
+    }
+    output.size += len;
+  }
+}
+
+/// Returns `true` if the header of a dynamic block with the given numbers of
+/// codes, starting with the code length code at `bit`, describes complete
+/// codes
+///
+/// The literal/length code must include the end of block. The distance code
+/// may also have one code or none, RFC 3.2.7. Faster than building the decode
+/// tables, so most offsets that are not a block header are rejected cheaply
+/// when searching for blocks.
+///
+auto plausible_code_lengths(
+    std::span<const std::byte> src,
+    std::size_t bit,
+    std::size_t n_code_length_codes,
+    std::size_t n_len_codes,
+    std::size_t n_dist_codes) -> bool
+{
+  constexpr std::uint8_t kCodeLengthBits = 3;
+  constexpr std::uint8_t kRepeatPrevSymbol = 16;
+  constexpr std::uint8_t kRepeat0For3BitsSymbol = 17;
+
+  // the code length code must be complete
+  const auto code_lengths = peek_bits(src, bit);
+  auto code_length_bitsizes = std::array<std::uint8_t, 19>{};
+  for (auto i = 0UZ; i != n_code_length_codes; ++i) {
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+    code_length_bitsizes[code_length_symbols[i]] = static_cast<std::uint8_t>(
+        extract_bits(code_lengths, i * kCodeLengthBits, kCodeLengthBits));
+    // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+  }
+  if (kraft_sum(code_length_bitsizes, code_length_code_bitsize_max) !=
+      std::size_t{1} << code_length_code_bitsize_max) {
+    return false;
+  }
+
+  // Decode table of the code length code, indexed by the next 7 bits. Codes
+  // are assigned in order of bitsize, then symbol, RFC 3.2.2, and packed
+  // starting with their most significant bit.
+  struct CodeLength
+  {
+    std::uint8_t symbol;
+    std::uint8_t bitsize;
+  };
+  auto table = std::array<CodeLength, 1U << code_length_code_bitsize_max>{};
+  auto code = 0U;
+  for (auto bitsize = std::uint8_t{1}; bitsize <= code_length_code_bitsize_max;
+       ++bitsize) {
+    for (auto symbol = std::uint8_t{}; symbol != code_length_bitsizes.size();
+         ++symbol) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      if (code_length_bitsizes[symbol] != bitsize) {
+        continue;
+      }
+      auto reversed = 0U;
+      for (auto i = 0U; i != bitsize; ++i) {
+        reversed |= ((code >> i) & 1U) << (bitsize - 1U - i);
+      }
+      for (auto i = reversed; i < table.size(); i += 1U << bitsize) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+        table[i] = {.symbol = symbol, .bitsize = bitsize};
+      }
+      ++code;
+    }
+    code <<= 1U;
+  }
+
+  // decode the code lengths, checking them as `decode_dynamic_huffman_tables`
+  // does
+  auto bits = make_reader(src, bit + (n_code_length_codes * kCodeLengthBits));
+  auto bitsizes =
+      std::array<std::uint8_t, n_len_codes_max + n_dist_codes_max>{};
+  const auto n_codes = n_len_codes + n_dist_codes;
+  for (auto index = 0UZ; index < n_codes;) {
+    if (bits.buffered() < max_code_length_bits) {
+      bits.refill();
+    }
+    const auto peeked = bits.peek(max_code_length_bits);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    const auto length_code = table[extract_bits(
+        peeked, 0, code_length_code_bitsize_max)];
+    auto n_bits = std::size_t{length_code.bitsize};
+    if (length_code.symbol < kRepeatPrevSymbol) {
+      bits.consume(length_code.bitsize);
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      bitsizes[index++] = length_code.symbol;
+      continue;
+    }
+
+    auto bitsize = std::uint8_t{};
+    auto repeat_count = std::size_t{};
+    if (length_code.symbol == kRepeatPrevSymbol) {
+      if (index == 0) {
+        return false;
+      }
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+      bitsize = bitsizes[index - 1];
+      repeat_count = 3UZ + extract_bits(peeked, n_bits, 2);
+      n_bits += 2;
+    } else if (length_code.symbol == kRepeat0For3BitsSymbol) {
+      repeat_count = 3UZ + extract_bits(peeked, n_bits, 3);
+      n_bits += 3;
+    } else {
+      repeat_count = 11UZ + extract_bits(peeked, n_bits, 7);
+      n_bits += 7;
+    }
+    if (repeat_count > n_codes - index) {
+      return false;
+    }
+    bits.consume(static_cast<std::uint8_t>(n_bits));
+    std::ranges::fill(
+        std::span{bitsizes}.subspan(index, repeat_count), bitsize);
+    index += repeat_count;
+  }
+  if (bits.overrun()) {
+    return false;
+  }
+
+  const auto len_bitsizes = std::span{bitsizes}.first(n_len_codes);
+  const auto dist_bitsizes =
+      std::span{bitsizes}.subspan(n_len_codes, n_dist_codes);
+  const auto complete = std::size_t{1} << len_code_bitsize_max;
+  return len_bitsizes[end_of_block] != 0 and
+         kraft_sum(len_bitsizes, len_code_bitsize_max) == complete and
+         (kraft_sum(dist_bitsizes, len_code_bitsize_max) == complete or
+          std::ranges::count_if(dist_bitsizes, [](auto bitsize) {
+            return bitsize != 0;
+          }) <= 1);
+}
+
+}  // namespace
+
+auto inflate_symbols(
+    std::span<const std::byte> src,
+    std::size_t begin_bit,
+    std::size_t stop_bit,
+    std::size_t history_size,
+    std::size_t max_size,
+    std::vector<Symbol>& symbols) -> SymbolResult
+{
+  symbols.resize(window_size);
+  for (auto i = 0UZ; i != window_size; ++i) {
+    symbols[i] = static_cast<Symbol>(marker_base + i);
+  }
+  auto output = SymbolOutput{
+      .symbols = symbols,
+      .size = window_size,
+      .min_index = window_size - std::min(history_size, window_size),
+      .max_size = window_size + max_size};
+
+  auto bits = make_reader(src, begin_bit);
+  auto result = SymbolResult{
+      .status = DecompressStatus::Success,
+      .end_bit = begin_bit,
+      .final = false};
+  auto state = InflateState{};
+  // size of the symbols up to the end of the last complete block
+  auto complete_size = output.size;
+  while (result.end_bit < stop_bit) {
+    const auto header = read_header(bits);
+    if (not header) {
+      result.status = header.error();
+      break;
+    }
+
+    switch (header->type) {
+      case BlockType::NoCompression:
+        result.status = inflate_stored_symbols(bits, output);
+        break;
+      case BlockType::FixedHuffman:
+        result.status =
+            inflate_huffman_symbols(bits, fixed_huffman_tables(), output);
+        break;
+      case BlockType::DynamicHuffman:
+        state.src_bits = bits;
+        result.status = decode_dynamic_huffman_tables(state);
+        bits = state.src_bits;
+        if (result.status == DecompressStatus::Success) {
+          result.status = inflate_huffman_symbols(
+              bits, state.dynamic_tables(), output);
+        }
+        break;
+    }
+    if (result.status == DecompressStatus::Success and bits.overrun()) {
+      result.status = DecompressStatus::SrcTooSmall;
+    }
+    if (result.status != DecompressStatus::Success) {
+      break;
+    }
+
+    result.end_bit = bit_offset(src, bits);
+    complete_size = output.size;
+    if (header->final) {
+      result.final = true;
+      break;
+    }
+  }
+  // drop the output of an incomplete block
+  symbols.resize(complete_size);
+  return result;
+}
+
+auto find_dynamic_block(
+    std::span<const std::byte> src, std::size_t begin_bit, std::size_t end_bit)
+    -> std::optional<std::size_t>
+{
+  constexpr std::uint8_t kHLitBits = 5;
+  constexpr std::uint8_t kHDistBits = 5;
+  constexpr std::uint8_t kHCLenBits = 4;
+  constexpr auto kDynamicType = 2U;
+  constexpr std::size_t kFirstCodeLength = 17;
+  constexpr std::size_t kCodeLengthBits = 3;
+  constexpr std::size_t kMinCodeLengthCodes = 4;
+
+  auto state = InflateState{};
+  const auto src_bits = src.size() * CHAR_BIT;
+  end_bit = std::min(end_bit, src_bits);
+  for (auto bit = begin_bit; bit < end_bit; ++bit) {
+    // the header and the shortest code length code must fit in `src`
+    if (src_bits - bit <
+        kFirstCodeLength + (kMinCodeLengthCodes * kCodeLengthBits)) {
+      break;
+    }
+    // Reject most offsets with a few shifts: the block type, and the numbers
+    // of codes of each kind.
+    const auto header = peek_bits(src, bit);
+    const auto n_len_codes = 257UZ + extract_bits(header, 3, kHLitBits);
+    const auto n_dist_codes =
+        1UZ + extract_bits(header, 3 + kHLitBits, kHDistBits);
+    if (extract_bits(header, 1, 2) != kDynamicType or
+        n_len_codes > n_len_codes_max or n_dist_codes > n_dist_codes_max) {
+      continue;
+    }
+    const auto n_code_length_codes =
+        kMinCodeLengthCodes +
+        extract_bits(header, 3 + kHLitBits + kHDistBits, kHCLenBits);
+    if (src_bits - bit <
+            kFirstCodeLength + (n_code_length_codes * kCodeLengthBits) or
+        not plausible_code_lengths(
+            src,
+            bit + kFirstCodeLength,
+            n_code_length_codes,
+            n_len_codes,
+            n_dist_codes)) {
+      continue;
+    }
+
+    // check the few remaining offsets with the decoder's own parser
+    auto bits = make_reader(src, bit);
+    if (not read_header(bits)) {
+      continue;
+    }
+    state.src_bits = bits;
+    if (decode_dynamic_huffman_tables(state) != DecompressStatus::Success or
+        state.src_bits.overrun()) {
+      continue;
+    }
+    return bit;
+  }
+  return std::nullopt;
+}
+
+auto resolve_symbols(
+    std::span<const Symbol> symbols,
+    std::span<const std::byte> history,
+    std::span<std::byte> dst) -> void
+{
+  assert(symbols.size() == dst.size());
+
+  // bytes for each symbol, so that each is replaced with a single load
+  auto bytes = std::array<std::byte, marker_base + window_size>{};
+  for (auto i = 0UZ; i != marker_base; ++i) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    bytes[i] = static_cast<std::byte>(i);
+  }
+  const auto window = history.last(std::min(history.size(), window_size));
+  std::ranges::copy(
+      window,
+      std::prev(bytes.end(), static_cast<std::ptrdiff_t>(window.size())));
+
+  std::ranges::transform(symbols, dst.begin(), [&bytes](Symbol symbol) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    return bytes[symbol];
+  });
+}
+
+auto markers_within(std::span<const Symbol> symbols, std::size_t history_size)
+    -> bool
+{
+  const auto min_marker = marker_base + window_size -
+                          std::min(history_size, window_size);
+  return std::ranges::all_of(symbols, [min_marker](Symbol symbol) {
+    return symbol < marker_base or symbol >= min_marker;
+  });
+}
+
+}  // namespace starflate::detail
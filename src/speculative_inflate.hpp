@@ -0,0 +1,96 @@
+#pragma once
+
+#include "src/decompress.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace starflate::detail {
+
+/// Output of `inflate_symbols`
+///
+/// Values below `marker_base` are bytes. Back-references may refer to the
+/// window preceding the output before its contents are known, so the bytes
+/// they copy are represented by markers: `marker_base + i` stands for byte
+/// `i` of the `window_size` bytes preceding the output.
+///
+using Symbol = std::uint16_t;
+
+inline constexpr Symbol marker_base = 256;
+
+/// Result of `inflate_symbols`
+///
+struct SymbolResult
+{
+  DecompressStatus status;
+  /// Bit offset in the stream following the last complete block
+  std::size_t end_bit;
+  /// `true` if the last complete block is the final block
+  bool final;
+};
+
+/// Decompresses whole blocks of a DEFLATE stream into symbols
+///
+/// Blocks are decompressed from the one at `begin_bit` until the first block
+/// starting at or after `stop_bit`, or the end of the final block. Since
+/// decoding depends only on the input bits, not on the contents of the
+/// window, the symbols are the output of the blocks once the markers are
+/// replaced by the bytes of the window with `resolve_symbols`.
+///
+/// @param src The stream.
+/// @param begin_bit The offset of the first block header in `src`, in bits.
+/// @param stop_bit The offset in bits at which to stop at a block boundary.
+/// @param history_size The number of bytes of the window that exist, from 0
+///     at the start of the stream to `window_size`. Back-references beyond
+///     them are invalid.
+/// @param max_size The maximum number of symbols to output.
+/// @param symbols Set to `window_size` markers for the window, followed by
+///     the output of the complete blocks.
+/// @return The offset following the last complete block, with a status of:
+///     * `Success` if the blocks were decompressed.
+///     * `DstTooSmall` if the output of the next block would exceed
+///       `max_size`.
+///     * `SrcTooSmall` if `src` ends before the last block does.
+///     * another status if the input is invalid.
+///
+auto inflate_symbols(
+    std::span<const std::byte> src,
+    std::size_t begin_bit,
+    std::size_t stop_bit,
+    std::size_t history_size,
+    std::size_t max_size,
+    std::vector<Symbol>& symbols) -> SymbolResult;
+
+/// Finds the first offset in [begin_bit, end_bit) at which a dynamic block
+/// plausibly starts
+///
+/// Checks the block header with `read_header` and the code length code, and
+/// decodes the code lengths, which must form complete codes.
+///
+auto find_dynamic_block(
+    std::span<const std::byte> src, std::size_t begin_bit, std::size_t end_bit)
+    -> std::optional<std::size_t>;
+
+/// Replaces the symbols output by `inflate_symbols` with bytes
+///
+/// @param symbols The output, without the markers for the window.
+/// @param history The bytes preceding the output. Only the last
+///     `window_size` are used.
+/// @param dst The destination, of the same size as `symbols`.
+/// @pre No marker refers to a byte preceding `history`.
+///
+auto resolve_symbols(
+    std::span<const Symbol> symbols,
+    std::span<const std::byte> history,
+    std::span<std::byte> dst) -> void;
+
+/// Returns `true` if no marker in `symbols` refers to a byte preceding the
+/// last `history_size` bytes of the window
+///
+auto markers_within(std::span<const Symbol> symbols, std::size_t history_size)
+    -> bool;
+
+}  // namespace starflate::detail
@@ -0,0 +1,68 @@
+#include "src/checksum.hpp"
+#include "version/version.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+// ignore checks to Google Benchmark headers,
+// NOLINTBEGIN(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+namespace {
+
+void BM_Checksum(
+    benchmark::State& state,
+    starflate::detail::ChecksumKernel kernel,
+    std::uint32_t initial)
+{
+  auto rng = std::mt19937{};
+  auto data = std::vector<std::byte>(static_cast<std::size_t>(state.range(0)));
+  for (auto& byte : data) {
+    byte = static_cast<std::byte>(rng());
+  }
+
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(kernel.checksum(data, initial));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void register_benchmarks(
+    const std::string& name,
+    std::span<const starflate::detail::ChecksumKernel> kernels,
+    std::uint32_t initial)
+{
+  for (const auto& kernel : kernels) {
+    const auto full_name = name + "/" + std::string{kernel.name};
+    benchmark::RegisterBenchmark(
+        full_name.c_str(), BM_Checksum, kernel, initial)
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        ->RangeMultiplier(16)
+        // NOLINTNEXTLINE(readability-magic-numbers)
+        ->Range(64, 1 << 20);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  register_benchmarks("BM_Crc32", starflate::detail::crc32_kernels(), 0);
+  register_benchmarks("BM_Adler32", starflate::detail::adler32_kernels(), 1);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
+
+// NOLINTEND(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
@@ -0,0 +1,129 @@
+#include "huffman/src/utility.hpp"
+#include "src/checksum.hpp"
+
+#include <boost/ut.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+auto main() -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  test("crc32 of empty data") = [] {
+    expect(eq(0U, crc32({})));
+    expect(eq(0x1234'5678U, crc32({}, 0x1234'5678U)));
+  };
+
+  test("crc32 check value") = [] {
+    // CRC-32 of the ASCII digits 1 to 9, the customary check input
+    constexpr auto digits =
+        huffman::byte_array('1', '2', '3', '4', '5', '6', '7', '8', '9');
+    expect(eq(0xCBF4'3926U, crc32(digits)));
+  };
+
+  test("crc32 computed in parts") = [] {
+    auto data = std::vector<std::byte>(1000);
+    for (auto i = 0UZ; i != data.size(); ++i) {
+      data[i] = static_cast<std::byte>((i * 151U) ^ (i >> 3U));
+    }
+    const auto whole = crc32(data);
+
+    for (const auto split : {0UZ, 1UZ, 7UZ, 500UZ, 999UZ, 1000UZ}) {
+      const auto bytes = std::span<const std::byte>{data};
+      const auto crc = crc32(bytes.subspan(split), crc32(bytes.first(split)));
+      expect(eq(whole, crc)) << "split at " << split;
+    }
+  };
+
+  test("crc32_combine") = [] {
+    auto data = std::vector<std::byte>(1000);
+    for (auto i = 0UZ; i != data.size(); ++i) {
+      data[i] = static_cast<std::byte>((i * 151U) ^ (i >> 3U));
+    }
+    const auto whole = crc32(data);
+
+    for (const auto split : {0UZ, 1UZ, 7UZ, 500UZ, 999UZ, 1000UZ}) {
+      const auto bytes = std::span<const std::byte>{data};
+      const auto second = bytes.subspan(split);
+      const auto crc = crc32_combine(
+          crc32(bytes.first(split)), crc32(second), second.size());
+      expect(eq(whole, crc)) << "split at " << split;
+    }
+  };
+
+  test("adler32 of empty data") = [] {
+    expect(eq(1U, adler32({})));
+    expect(eq(0x1234'5678U, adler32({}, 0x1234'5678U)));
+  };
+
+  test("adler32 check value") = [] {
+    constexpr auto digits =
+        huffman::byte_array('1', '2', '3', '4', '5', '6', '7', '8', '9');
+    expect(eq(0x091E'01DEU, adler32(digits)));
+  };
+
+  test("adler32 computed in parts") = [] {
+    // longer than the runs of bytes between reductions
+    auto data = std::vector<std::byte>(20'000, std::byte{0xFF});
+    for (auto i = 0UZ; i < data.size(); i += 3) {
+      data[i] = static_cast<std::byte>(i);
+    }
+    const auto whole = adler32(data);
+
+    // computed without reductions delayed
+    auto a = std::uint64_t{1};
+    auto b = std::uint64_t{};
+    for (const auto byte : data) {
+      a = (a + std::to_integer<std::uint64_t>(byte)) % 65521U;
+      b = (b + a) % 65521U;
+    }
+    expect(eq((b << 16U) | a, std::uint64_t{whole}));
+
+    for (const auto split : {0UZ, 1UZ, 5552UZ, 10'000UZ, 20'000UZ}) {
+      const auto bytes = std::span<const std::byte>{data};
+      const auto adler =
+          adler32(bytes.subspan(split), adler32(bytes.first(split)));
+      expect(eq(whole, adler)) << "split at " << split;
+    }
+  };
+  test("checksum kernels match the portable implementations") = [] {
+    auto rng = std::mt19937{1234};
+    auto data = std::vector<std::byte>(100'000);
+    for (auto& byte : data) {
+      byte = static_cast<std::byte>(rng());
+    }
+    const auto bytes = std::span<const std::byte>{data};
+
+    auto sizes = std::vector<std::size_t>{};
+    for (auto size = 0UZ; size != 600; ++size) {
+      sizes.push_back(size);
+    }
+    // around the runs of bytes between Adler-32 reductions
+    for (const auto size : {5551UZ, 5552UZ, 5553UZ, 11'104UZ, 99'997UZ}) {
+      sizes.push_back(size);
+    }
+
+    for (const auto& kernels :
+         {detail::crc32_kernels(), detail::adler32_kernels()}) {
+      expect(eq(std::string_view{"portable"}, kernels.front().name));
+      const auto portable = kernels.front().checksum;
+      for (const auto& kernel : kernels.subspan(1)) {
+        for (const auto size : sizes) {
+          // unaligned, with an arbitrary initial value
+          const auto part = bytes.subspan(3, size);
+          const auto initial = static_cast<std::uint32_t>(rng()) % 65521U;
+          expect(eq(portable(part, initial), kernel.checksum(part, initial)))
+              << kernel.name << " of " << size << " bytes";
+        }
+      }
+    }
+  };
+}
@@ -0,0 +1,180 @@
+#include "huffman/huffman.hpp"
+#include "src/compress.hpp"
+#include "src/decompress.hpp"
+#include "src/test/test_util.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+
+auto random_bytes(std::size_t n) -> std::vector<std::byte>
+{
+  auto rng = std::mt19937{n};
+  auto bytes = std::vector<std::byte>(n);
+  for (auto& byte : bytes) {
+    byte = static_cast<std::byte>(rng());
+  }
+  return bytes;
+}
+
+/// Compresses `src` into a buffer of `compress_bound` bytes
+///
+auto compress_all(
+    std::span<const std::byte> src,
+    std::uint8_t level,
+    ::starflate::Strategy strategy = ::starflate::Strategy::Default)
+    -> std::vector<std::byte>
+{
+  auto dst = std::vector<std::byte>(::starflate::compress_bound(src.size()));
+  const auto result = ::starflate::compress(src, dst, level, strategy);
+  ::boost::ut::expect(
+      ::boost::ut::fatal(result.status == ::starflate::CompressStatus::Success))
+      << "got status: " << static_cast<int>(result.status);
+  dst.resize(result.dst_written);
+  return dst;
+}
+
+/// Returns `true` if `compressed` decompresses to `expected`
+///
+auto round_trips(
+    std::span<const std::byte> compressed, std::span<const std::byte> expected)
+    -> bool
+{
+  auto dst = std::vector<std::byte>(expected.size());
+  return ::starflate::decompress(compressed, dst) ==
+             ::starflate::DecompressStatus::Success and
+         std::ranges::equal(dst, expected);
+}
+
+auto first_block_type(std::span<const std::byte> compressed)
+    -> ::starflate::detail::BlockType
+{
+  auto bits = ::starflate::huffman::bit_span{compressed};
+  const auto header = ::starflate::detail::read_header(bits);
+  ::boost::ut::expect(::boost::ut::fatal(header.has_value()));
+  return header->type;
+}
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::expect;
+  using ::boost::ut::le;
+  using ::boost::ut::lt;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  test("compress round trips at every level") = [argv] {
+    const auto src = read_runfile(*argv, "starflate/src/test/starfleet.html");
+    auto prev_size = compress_bound(src.size());
+    for (auto level = min_compress_level; level <= max_compress_level;
+         ++level) {
+      const auto compressed = compress_all(src, level);
+      expect(round_trips(compressed, src)) << "level " << int{level};
+      // higher levels search for matches more thoroughly
+      expect(le(compressed.size(), prev_size)) << "level " << int{level};
+      prev_size = compressed.size();
+    }
+  };
+
+  test("compress empty input") = [] {
+    for (const auto level : {0, 1, 6, 9}) {
+      const auto compressed =
+          compress_all({}, static_cast<std::uint8_t>(level));
+      expect(round_trips(compressed, {})) << "level " << level;
+    }
+  };
+
+  test("compress chooses the smallest block type") = [argv] {
+    const auto text = read_runfile(*argv, "starflate/src/test/starfleet.html");
+    expect(
+        first_block_type(compress_all(text, 0)) ==
+        detail::BlockType::NoCompression);
+    expect(
+        first_block_type(compress_all(text, default_compress_level)) ==
+        detail::BlockType::DynamicHuffman);
+
+    const auto short_text = std::span{text}.first(20);
+    expect(
+        first_block_type(compress_all(short_text, default_compress_level)) ==
+        detail::BlockType::FixedHuffman);
+
+    const auto noise = random_bytes(1000);
+    expect(
+        first_block_type(compress_all(noise, default_compress_level)) ==
+        detail::BlockType::NoCompression);
+  };
+
+  test("compress with fixed codes only") = [argv] {
+    const auto text = read_runfile(*argv, "starflate/src/test/starfleet.html");
+    const auto compressed =
+        compress_all(text, default_compress_level, Strategy::Fixed);
+    expect(first_block_type(compressed) == detail::BlockType::FixedHuffman);
+    expect(round_trips(compressed, text));
+    expect(
+        lt(compress_all(text, default_compress_level).size(),
+           compressed.size()));
+
+    // blocks are still stored if that is smaller
+    const auto noise = random_bytes(1000);
+    expect(
+        first_block_type(
+            compress_all(noise, default_compress_level, Strategy::Fixed)) ==
+        detail::BlockType::NoCompression);
+  };
+
+  test("compress fits in compress_bound") = [] {
+    // incompressible input is stored, in several blocks when large
+    for (const auto size : {1UZ, 100UZ, 65'535UZ, 65'536UZ, 300'000UZ}) {
+      const auto src = random_bytes(size);
+      for (const auto level : {0, 1, 6, 9}) {
+        const auto compressed =
+            compress_all(src, static_cast<std::uint8_t>(level));
+        expect(round_trips(compressed, src))
+            << "size " << size << " level " << level;
+      }
+    }
+  };
+
+  test("compress long repeats") = [] {
+    // matches of the maximum length at a distance of 1, and runs of zero code
+    // lengths in the dynamic header
+    auto src = std::vector<std::byte>(100'000, std::byte{'a'});
+    std::ranges::copy(random_bytes(50), src.begin() + 50'000);
+    for (const auto level : {1, 4, 9}) {
+      const auto compressed =
+          compress_all(src, static_cast<std::uint8_t>(level));
+      expect(round_trips(compressed, src)) << "level " << level;
+      expect(lt(compressed.size(), 1'000UZ)) << "level " << level;
+    }
+  };
+
+  test("compress with a small dst") = [argv] {
+    const auto src = read_runfile(*argv, "starflate/src/test/starfleet.html");
+    const auto compressed = compress_all(src, default_compress_level);
+
+    auto dst = std::vector<std::byte>(compressed.size() - 1);
+    expect(compress(src, dst).status == CompressStatus::DstTooSmall);
+
+    dst.resize(compressed.size());
+    const auto result = compress(src, dst);
+    expect(result.status == CompressStatus::Success);
+    expect(std::ranges::equal(dst, compressed));
+  };
+
+  test("compress rejects invalid levels") = [] {
+    auto dst = std::vector<std::byte>(compress_bound(0));
+    const auto result = compress({}, dst, max_compress_level + 1);
+    expect(result.status == CompressStatus::InvalidLevel);
+  };
+}
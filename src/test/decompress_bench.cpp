@@ -0,0 +1,492 @@
+#include "src/compress.hpp"
+#include "src/decompress.hpp"
+#include "src/test/test_util.hpp"
+#include "version/version.hpp"
+
+#include <benchmark/benchmark.h>
+#include <malloc.h>
+
+#if defined(HAVE_ZLIB)
+#define ZLIB_CONST
+#include <zlib.h>
+#endif
+
+#if defined(HAVE_LIBDEFLATE)
+#include <libdeflate.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ignore checks to Google Benchmark headers,
+// NOLINTBEGIN(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+namespace {
+
+/// Heap memory in use, tracked to report the peak memory of decompressing
+///
+struct HeapUsage
+{
+  std::size_t current;
+  std::size_t peak;
+};
+
+HeapUsage heap_usage{};
+
+auto tracked_malloc(std::size_t size) -> void*
+{
+  // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+  auto* ptr = std::malloc(size);
+  if (ptr != nullptr) {
+    heap_usage.current += ::malloc_usable_size(ptr);
+    heap_usage.peak = std::max(heap_usage.peak, heap_usage.current);
+  }
+  return ptr;
+}
+
+// not inlined into operator delete, where freeing memory from operator new
+// is reported as mismatched
+[[gnu::noinline]]
+auto tracked_free(void* ptr) -> void
+{
+  if (ptr != nullptr) {
+    heap_usage.current -= ::malloc_usable_size(ptr);
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+  std::free(ptr);
+}
+
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+  auto* ptr = tracked_malloc(size);
+  if (ptr == nullptr) {
+    std::abort();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { tracked_free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { tracked_free(ptr); }
+
+namespace {
+
+using Bytes = std::vector<std::byte>;
+
+auto append(Bytes& bytes, std::string_view str) -> void
+{
+  const auto chars = std::as_bytes(std::span{str});
+  bytes.insert(bytes.end(), chars.begin(), chars.end());
+}
+
+/// English-like text, with words drawn from a skewed distribution
+///
+auto make_text(std::size_t size) -> Bytes
+{
+  constexpr auto words = std::array<std::string_view, 24>{
+      "the",   "of",     "and",      "to",     "a",       "in",
+      "is",    "that",   "for",      "it",     "as",      "with",
+      "ship",  "was",    "on",       "be",     "by",      "captain",
+      "warp",  "engine", "starbase", "sensor", "officer", "federation"};
+
+  auto rng = std::mt19937{size};
+  auto text = Bytes{};
+  text.reserve(size + 16);
+  while (text.size() < size) {
+    // favor the first words, as in natural language
+    const auto rank = rng() % (rng() % words.size() + 1);
+    append(text, words[rank]);
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    const auto punctuation = rng() % 16;
+    append(text, punctuation == 0 ? ".\n" : punctuation == 1 ? ", " : " ");
+  }
+  text.resize(size);
+  return text;
+}
+
+/// The given document repeated, like pages of a site
+///
+auto make_repeated(std::span<const std::byte> document, std::size_t size)
+    -> Bytes
+{
+  auto bytes = Bytes{};
+  bytes.reserve(size + document.size());
+  while (bytes.size() < size) {
+    bytes.insert(bytes.end(), document.begin(), document.end());
+  }
+  bytes.resize(size);
+  return bytes;
+}
+
+/// JSON log lines, with a few fields varying between lines
+///
+auto make_json_logs(std::size_t size) -> Bytes
+{
+  constexpr auto levels =
+      std::array<std::string_view, 3>{"INFO", "WARN", "ERROR"};
+  constexpr auto paths =
+      std::array<std::string_view, 4>{"/items", "/users", "/orders", "/health"};
+
+  auto rng = std::mt19937{size};
+  auto logs = Bytes{};
+  logs.reserve(size + 256);
+  for (auto line = 0UZ; logs.size() < size; ++line) {
+    append(logs, R"({"ts":)");
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    append(logs, std::to_string(1'700'000'000'000 + (line * 17)));
+    append(logs, R"(,"level":")");
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    append(logs, levels[rng() % 16 == 0 ? 1 + (rng() % 2) : 0]);
+    append(logs, R"(","path":"/v1)");
+    append(logs, paths[rng() % paths.size()]);
+    append(logs, "/");
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    append(logs, std::to_string(rng() % 100'000));
+    append(logs, R"(","latency_ms":)");
+    // NOLINTNEXTLINE(readability-magic-numbers)
+    append(logs, std::to_string(rng() % 500));
+    append(logs, "}\n");
+  }
+  logs.resize(size);
+  return logs;
+}
+
+/// Binary records of counters, small integers and flags, like a table of
+/// structs
+///
+auto make_binary(std::size_t size) -> Bytes
+{
+  struct Record
+  {
+    std::uint32_t id;
+    std::uint32_t count;
+    std::uint16_t flags;
+    std::uint16_t kind;
+    std::uint32_t offset;
+  };
+
+  auto rng = std::mt19937{size};
+  auto binary = Bytes{};
+  binary.reserve(size + sizeof(Record));
+  auto offset = std::uint32_t{};
+  for (auto id = std::uint32_t{}; binary.size() < size; ++id) {
+    // NOLINTBEGIN(readability-magic-numbers)
+    offset += static_cast<std::uint32_t>(rng() % 4096);
+    const auto record = Record{
+        .id = id,
+        .count = static_cast<std::uint32_t>(rng() % 1000),
+        .flags = static_cast<std::uint16_t>(1U << (rng() % 4)),
+        .kind = static_cast<std::uint16_t>(rng() % 8),
+        .offset = offset};
+    // NOLINTEND(readability-magic-numbers)
+    const auto old_size = binary.size();
+    binary.resize(old_size + sizeof(record));
+    std::memcpy(&binary[old_size], &record, sizeof(record));
+  }
+  binary.resize(size);
+  return binary;
+}
+
+/// Uniformly random bytes, which are incompressible
+///
+auto make_random(std::size_t size) -> Bytes
+{
+  auto rng = std::mt19937{size};
+  auto bytes = Bytes(size);
+  for (auto& byte : bytes) {
+    byte = static_cast<std::byte>(rng());
+  }
+  return bytes;
+}
+
+/// A short random sequence repeated, which compresses to long matches
+///
+auto make_repetitive(std::size_t size) -> Bytes
+{
+  // NOLINTNEXTLINE(readability-magic-numbers)
+  return make_repeated(make_random(64), size);
+}
+
+struct Corpus
+{
+  std::string_view name;
+  Bytes (*make)(std::size_t size, std::span<const std::byte> html);
+};
+
+/// Compression of a corpus
+///
+/// Whatever the strategy, blocks are stored if that is smaller, as for
+/// random data.
+///
+struct Encoding
+{
+  std::string_view name;
+  std::uint8_t level;
+  starflate::Strategy strategy;
+};
+
+using starflate::Strategy;
+
+constexpr auto encodings = std::array<Encoding, 5>{{
+    {"stored", 0, Strategy::Default},
+    {"fixed", starflate::default_compress_level, Strategy::Fixed},
+    {"dynamic1", 1, Strategy::Default},
+    {"dynamic6", starflate::default_compress_level, Strategy::Default},
+    {"dynamic9", starflate::max_compress_level, Strategy::Default},
+}};
+
+/// Input and compressed stream of the last benchmark
+///
+/// Benchmarks of the same corpus and size are registered consecutively, and
+/// each benchmark runs several times, so the last input and stream are kept
+/// instead of being made again.
+///
+struct Streams
+{
+  std::string_view corpus;
+  std::string_view encoding;
+  std::size_t size{};
+  Bytes input;
+  Bytes compressed;
+};
+
+auto streams_for(
+    const Corpus& corpus,
+    const Encoding& encoding,
+    std::size_t size,
+    std::span<const std::byte> html) -> const Streams&
+{
+  static auto streams = Streams{};
+  if (streams.corpus != corpus.name or streams.size != size) {
+    streams.corpus = corpus.name;
+    streams.encoding = {};
+    streams.size = size;
+    streams.input = corpus.make(size, html);
+  }
+  if (streams.encoding != encoding.name) {
+    streams.encoding = encoding.name;
+    streams.compressed.resize(starflate::compress_bound(size));
+    const auto result = starflate::compress(
+        streams.input, streams.compressed, encoding.level, encoding.strategy);
+    streams.compressed.resize(
+        result.status == starflate::CompressStatus::Success ? result.dst_written
+                                                            : 0);
+  }
+  return streams;
+}
+
+/// A decompressor of raw DEFLATE streams
+///
+struct Decoder
+{
+  std::string_view name;
+  /// Decompresses all of `src` into all of `dst`, returning `false` on error
+  bool (*decompress)(std::span<const std::byte> src, std::span<std::byte> dst);
+  /// Memory used while decompressing that is not on the heap
+  std::size_t stack_size;
+};
+
+auto starflate_decompress(
+    std::span<const std::byte> src, std::span<std::byte> dst) -> bool
+{
+  return starflate::decompress(src, dst) ==
+         starflate::DecompressStatus::Success;
+}
+
+#if defined(HAVE_ZLIB)
+auto zlib_decompress(std::span<const std::byte> src, std::span<std::byte> dst)
+    -> bool
+{
+  auto stream = z_stream{};
+  stream.zalloc = [](voidpf, uInt items, uInt size) -> voidpf {
+    return tracked_malloc(std::size_t{items} * size);
+  };
+  stream.zfree = [](voidpf, voidpf ptr) { tracked_free(ptr); };
+  // negative window bits for a raw DEFLATE stream
+  // NOLINTNEXTLINE(readability-magic-numbers)
+  if (inflateInit2(&stream, -15) != Z_OK) {
+    return false;
+  }
+
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+  stream.next_in = reinterpret_cast<const Bytef*>(src.data());
+  stream.avail_in = static_cast<uInt>(src.size());
+  stream.next_out = reinterpret_cast<Bytef*>(dst.data());
+  stream.avail_out = static_cast<uInt>(dst.size());
+  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+  const auto status = inflate(&stream, Z_FINISH);
+  const auto written = stream.total_out;
+  inflateEnd(&stream);
+  return status == Z_STREAM_END and written == dst.size();
+}
+#endif
+
+#if defined(HAVE_LIBDEFLATE)
+auto libdeflate_decompress(
+    std::span<const std::byte> src, std::span<std::byte> dst) -> bool
+{
+  auto* decompressor = libdeflate_alloc_decompressor();
+  if (decompressor == nullptr) {
+    return false;
+  }
+  const auto result = libdeflate_deflate_decompress(
+      decompressor, src.data(), src.size(), dst.data(), dst.size(), nullptr);
+  libdeflate_free_decompressor(decompressor);
+  return result == LIBDEFLATE_SUCCESS;
+}
+#endif
+
+/// Decoders compared by the benchmarks, those of other libraries if installed
+///
+const auto decoders = std::array{
+    Decoder{
+        "starflate",
+        starflate_decompress,
+        sizeof(starflate::detail::InflateState)},
+#if defined(HAVE_ZLIB)
+    Decoder{"zlib", zlib_decompress, 0},
+#endif
+#if defined(HAVE_LIBDEFLATE)
+    Decoder{"libdeflate", libdeflate_decompress, 0},
+#endif
+};
+
+/// Decompresses a corpus
+///
+/// Reports the throughput in bytes of decompressed output, as MB/s and CPU
+/// cycles per byte, the peak memory used by the decoder, excluding the input
+/// and output, and the compression ratio. Sizes of up to 100 MB take a while
+/// to generate and compress; use `--benchmark_filter` to select some.
+///
+void BM_Decompress(
+    benchmark::State& state,
+    const Corpus& corpus,
+    const Encoding& encoding,
+    const Decoder& decoder,
+    std::span<const std::byte> html)
+{
+  const auto size = static_cast<std::size_t>(state.range(0));
+  const auto& streams = streams_for(corpus, encoding, size, html);
+  if (streams.compressed.empty()) {
+    state.SkipWithError("compression failed");
+    return;
+  }
+
+  auto dst = Bytes(size);
+  heap_usage.peak = heap_usage.current;
+  const auto heap_before = heap_usage.current;
+  if (not decoder.decompress(streams.compressed, dst)) {
+    state.SkipWithError("decompression failed");
+    return;
+  }
+  const auto peak_memory =
+      heap_usage.peak - heap_before + decoder.stack_size;
+
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    if (not decoder.decompress(streams.compressed, dst)) {
+      state.SkipWithError("decompression failed");
+      return;
+    }
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  if (dst != streams.input) {
+    state.SkipWithError("decompressed output does not match input");
+    return;
+  }
+
+  const auto bytes =
+      static_cast<double>(state.iterations()) * static_cast<double>(size);
+  state.SetBytesProcessed(
+      state.iterations() * static_cast<std::int64_t>(size));
+  // reported per second
+  state.counters["MB"] =
+      // NOLINTNEXTLINE(readability-magic-numbers)
+      benchmark::Counter{bytes / 1e6, benchmark::Counter::kIsRate};
+  // CPU time divided by the time of a cycle at the nominal frequency and by
+  // the number of bytes
+  state.counters["cycles/B"] = benchmark::Counter{
+      bytes / benchmark::CPUInfo::Get().cycles_per_second,
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert};
+  state.counters["peak_mem"] = benchmark::Counter{
+      static_cast<double>(peak_memory),
+      benchmark::Counter::kDefaults,
+      benchmark::Counter::kIs1024};
+  state.counters["ratio"] = static_cast<double>(size) /
+                            static_cast<double>(streams.compressed.size());
+}
+
+using ::starflate::test::read_runfile;
+
+const auto corpora = std::array<Corpus, 6>{{
+    {"text", [](std::size_t size, auto) { return make_text(size); }},
+    {"html",
+     [](std::size_t size, std::span<const std::byte> html) {
+       return make_repeated(html, size);
+     }},
+    {"json", [](std::size_t size, auto) { return make_json_logs(size); }},
+    {"binary", [](std::size_t size, auto) { return make_binary(size); }},
+    {"random", [](std::size_t size, auto) { return make_random(size); }},
+    {"repetitive",
+     [](std::size_t size, auto) { return make_repetitive(size); }},
+}};
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  // repeated to the size of each benchmark
+  static const auto html =
+      read_runfile(*argv, "starflate/src/test/starfleet.html");
+#if defined(HAVE_LIBDEFLATE)
+  libdeflate_set_memory_allocator(tracked_malloc, tracked_free);
+#endif
+
+  // NOLINTNEXTLINE(readability-magic-numbers)
+  constexpr auto sizes =
+      std::array<std::int64_t, 4>{100, 10'000, 1'000'000, 100'000'000};
+  for (const auto& corpus : corpora) {
+    for (const auto size : sizes) {
+      for (const auto& encoding : encodings) {
+        // decoders of the same stream are reported side by side
+        for (const auto& decoder : decoders) {
+          const auto name = "BM_Decompress/" + std::string{corpus.name} +
+                            "/" + std::string{encoding.name} + "/" +
+                            std::string{decoder.name};
+          benchmark::RegisterBenchmark(
+              name.c_str(),
+              BM_Decompress,
+              corpus,
+              encoding,
+              decoder,
+              std::span{html})
+              ->Arg(size)
+              ->Unit(benchmark::kMicrosecond);
+        }
+      }
+    }
+  }
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
+
+// NOLINTEND(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
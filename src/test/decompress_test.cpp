@@ -1,14 +1,17 @@
 #include "huffman/huffman.hpp"
 #include "huffman/src/utility.hpp"
 #include "src/decompress.hpp"
-#include "tools/cpp/runfiles/runfiles.h"
+#include "src/test/test_util.hpp"
 
 #include <boost/ut.hpp>
 
+#include <algorithm>
 #include <array>
-#include <fstream>
-#include <iterator>
-#include <memory>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace {
@@ -18,38 +21,65 @@ constexpr auto byte_vector(Ts... values)
   return std::vector<std::byte>{std::byte(values)...};
 }
 
-auto read_runfile(const char* argv0, const std::string& path)
-    -> std::vector<std::byte>
+/// Returns a stream from its bits in stream order, as `'0'` and `'1'`
+///
+auto stream_bytes(std::string_view bits) -> std::vector<std::byte>
 {
-  using ::bazel::tools::cpp::runfiles::Runfiles;
-  std::string error;
-  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv0, &error));
-  ::boost::ut::expect(::boost::ut::fatal(runfiles != nullptr)) << error;
-
-  const std::string abs_path{runfiles->Rlocation(path)};
-
-  std::ifstream file{abs_path, std::ios::binary};
-  if (not file.is_open()) {
-    // ::boost::ut::fatal swallows log messages, so log before.
-    ::boost::ut::log("failed to open file: " + abs_path);
-    ::boost::ut::expect(::boost::ut::fatal(false));
+  auto bytes = std::vector<std::byte>((bits.size() + 7) / 8);
+  for (auto i = 0UZ; i != bits.size(); ++i) {
+    if (bits[i] == '1') {
+      bytes[i / 8] |= std::byte{1} << (i % 8);
+    }
   }
+  return bytes;
+}
+
+/// Returns the bits of a field of a stream in stream order, least
+/// significant bit first
+///
+auto field(unsigned value, std::size_t bitsize) -> std::string
+{
+  auto bits = std::string{};
+  for (auto i = 0UZ; i != bitsize; ++i) {
+    bits += ((value >> i) & 1U) != 0 ? '1' : '0';
+  }
+  return bits;
+}
 
-  std::vector<char> chars(
-      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+using ::starflate::test::read_runfile;
 
-  const std::vector<char> char_vector(
-      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+/// Decompresses `src` with a Decompressor, providing at most `src_chunk` bytes
+/// of input and `dst_chunk` bytes of output space per call.
+auto decompress_chunked(
+    std::span<const std::byte> src,
+    std::size_t src_chunk,
+    std::size_t dst_chunk)
+    -> std::pair<::starflate::DecompressStatus, std::vector<std::byte>>
+{
+  using ::starflate::DecompressStatus;
+
+  auto decompressor = ::starflate::Decompressor{};
+  auto dst = std::vector<std::byte>(dst_chunk);
+  auto decompressed = std::vector<std::byte>{};
+
+  while (true) {
+    const auto result = decompressor.decompress(
+        src.first(std::min(src_chunk, src.size())), dst);
+    src = src.subspan(result.src_consumed);
+    decompressed.insert(
+        decompressed.end(),
+        dst.begin(),
+        dst.begin() + static_cast<std::ptrdiff_t>(result.dst_written));
 
-  // The standard library really doesn't want me to read std::byte from a file,
-  // so reinterpret chars as bytes.
-  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
-  return {
-      reinterpret_cast<std::byte*>(chars.data()),
-      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-      reinterpret_cast<std::byte*>(chars.data() + chars.size())};
-  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (result.status == DecompressStatus::SrcTooSmall and not src.empty()) {
+      continue;
+    }
+    if (result.status != DecompressStatus::DstTooSmall) {
+      return {result.status, decompressed};
+    }
+  }
 }
+
 }  // namespace
 
 auto main(int, char* argv[]) -> int
@@ -153,6 +183,21 @@ auto main(int, char* argv[]) -> int
         << "decompressed does not match expected";
   };
 
+  test("truncated fixed huffman") = [argv] {
+    const std::vector<std::byte> input_bytes =
+        read_runfile(*argv, "starflate/src/test/starfleet.html.fixed");
+    const std::vector<std::byte> expected_bytes =
+        read_runfile(*argv, "starflate/src/test/starfleet.html");
+    std::vector<std::byte> dst(expected_bytes.size());
+
+    for (const auto size :
+         {1UZ, 2UZ, input_bytes.size() / 2, input_bytes.size() - 1}) {
+      const auto status = decompress(std::span{input_bytes}.first(size), dst);
+      expect(status != DecompressStatus::Success)
+          << "truncated to " << size << " bytes";
+    }
+  };
+
   test("dynamic huffman") = [argv] {
     const std::vector<std::byte> input_bytes =
         read_runfile(*argv, "starflate/src/test/starfleet.html.dynamic");
@@ -173,10 +218,287 @@ auto main(int, char* argv[]) -> int
         << "decompressed does not match expected";
   };
 
+  test("dynamic huffman with invalid codes") = [] {
+    // a final dynamic block, with 257 literal/length codes and 1 distance code
+    const auto header = field(1, 1) + field(2, 2) + field(0, 5) + field(0, 5);
+
+    // 4 code length codes of 1 bit are oversubscribed
+    const auto oversubscribed =
+        header + field(0, 4) + field(1, 3) + field(1, 3) + field(1, 3) +
+        field(1, 3);
+    auto dst = std::vector<std::byte>(1);
+    expect(
+        decompress(stream_bytes(oversubscribed), dst) ==
+        DecompressStatus::InvalidLitOrLen);
+
+    // code length codes 0, 1 and 2 are "0", "10" and "11"
+    auto code_lengths = header + field(14, 4);
+    // in the order of RFC 3.2.7, up to code length code 1
+    constexpr auto code_length_bitsizes = std::array{
+        0U, 0U, 0U, 1U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U, 2U, 0U, 2U};
+    for (const auto bitsize : code_length_bitsizes) {
+      code_lengths += field(bitsize, 3);
+    }
+    const auto zeros = std::string(255, '0');
+
+    // literal 0 and end of block with 2-bit codes are incomplete
+    const auto incomplete = code_lengths + "11" + zeros + "11" + "0";
+    expect(
+        decompress(stream_bytes(incomplete), dst) ==
+        DecompressStatus::InvalidLitOrLen);
+
+    // a single code is incomplete but valid, as for a block with one
+    // distance code
+    const auto single = code_lengths + "10" + zeros + "10" + "10" + "0" + "1";
+    expect(decompress(stream_bytes(single), dst) == DecompressStatus::Success);
+    expect(eq(dst, byte_vector(0)));
+  };
+
+  test("decompressor with chunked input and output") = [argv] {
+    const std::vector<std::byte> expected_bytes =
+        read_runfile(*argv, "starflate/src/test/starfleet.html");
+
+    for (const auto* path : {"starflate/src/test/starfleet.html.fixed",
+                             "starflate/src/test/starfleet.html.dynamic"}) {
+      const std::vector<std::byte> input_bytes = read_runfile(*argv, path);
+
+      for (const auto& [src_chunk, dst_chunk] :
+           {std::pair{1UZ, 1UZ},
+            {1UZ, 65536UZ},
+            {7UZ, 3UZ},
+            {4096UZ, 1000UZ},
+            {input_bytes.size(), 1UZ}}) {
+        const auto [status, decompressed] =
+            decompress_chunked(input_bytes, src_chunk, dst_chunk);
+        expect(status == DecompressStatus::Success)
+            << path << " with chunk sizes " << src_chunk << ", " << dst_chunk
+            << " got error code: " << static_cast<int>(status);
+        expect(std::ranges::equal(decompressed, expected_bytes))
+            << path << " with chunk sizes " << src_chunk << ", " << dst_chunk
+            << " does not match expected";
+      }
+    }
+  };
+
+  test("decompressor with no compression") = [] {
+    constexpr auto compressed = huffman::byte_array(
+        0b000, 4, 0, ~4, ~0, 'r', 'o', 's', 'e',  // not final
+        0b001, 3, 0, ~3, ~0, 'b', 'u', 'd');      // final
+
+    for (const auto src_chunk : {1UZ, 2UZ, 5UZ, compressed.size()}) {
+      const auto [status, decompressed] =
+          decompress_chunked(compressed, src_chunk, 2);
+      expect(status == DecompressStatus::Success);
+      expect(std::ranges::equal(
+          decompressed,
+          huffman::byte_array('r', 'o', 's', 'e', 'b', 'u', 'd')));
+    }
+  };
+
+  test("decompressor reports consumed input") = [argv] {
+    const std::vector<std::byte> input_bytes =
+        read_runfile(*argv, "starflate/src/test/starfleet.html.dynamic");
+    const std::vector<std::byte> expected_bytes =
+        read_runfile(*argv, "starflate/src/test/starfleet.html");
+
+    auto src = input_bytes;
+    src.insert(src.end(), {std::byte{0xAB}, std::byte{0xCD}});
+    std::vector<std::byte> dst(expected_bytes.size());
+
+    auto decompressor = Decompressor{};
+    const auto result = decompressor.decompress(src, dst);
+    expect(result.status == DecompressStatus::Success);
+    expect(decompressor.done());
+    expect(eq(input_bytes.size(), result.src_consumed));
+    expect(eq(expected_bytes.size(), result.dst_written));
+
+    const auto after = decompressor.decompress(
+        std::span{src}.subspan(result.src_consumed), dst);
+    expect(after.status == DecompressStatus::Success);
+    expect(eq(0UZ, after.src_consumed));
+    expect(eq(0UZ, after.dst_written));
+  };
+
+  test("decompressor with truncated input") = [argv] {
+    const std::vector<std::byte> input_bytes =
+        read_runfile(*argv, "starflate/src/test/starfleet.html.dynamic");
+    std::vector<std::byte> dst(1024);
+
+    auto decompressor = Decompressor{};
+    auto result = DecompressResult{};
+    auto src = std::span{input_bytes}.first(input_bytes.size() - 1);
+    do {
+      result = decompressor.decompress(src, dst);
+      src = src.subspan(result.src_consumed);
+    } while (result.status == DecompressStatus::DstTooSmall);
+
+    expect(result.status == DecompressStatus::SrcTooSmall);
+    expect(src.empty());
+    expect(not decompressor.done());
+  };
+
+  test("decompressor with streaming output") = [argv] {
+    static_assert(sizeof(Decompressor) < 1024UZ * 1024UZ);
+
+    const std::vector<std::byte> expected_bytes =
+        read_runfile(*argv, "starflate/src/test/starfleet.html");
+
+    for (const auto* path : {"starflate/src/test/starfleet.html.fixed",
+                             "starflate/src/test/starfleet.html.dynamic"}) {
+      const std::vector<std::byte> input_bytes = read_runfile(*argv, path);
+
+      for (const auto src_chunk : {1UZ, 16384UZ, input_bytes.size()}) {
+        auto decompressor = Decompressor{};
+        auto src = std::span{input_bytes};
+        auto decompressed = std::vector<std::byte>{};
+        auto result = StreamResult{};
+        do {
+          result = decompressor.decompress(
+              src.first(std::min(src_chunk, src.size())));
+          src = src.subspan(result.src_consumed);
+          expect(result.output.size() <= Decompressor::max_stream_output);
+          decompressed.insert(
+              decompressed.end(), result.output.begin(), result.output.end());
+        } while (result.status == DecompressStatus::DstTooSmall or
+                 (result.status == DecompressStatus::SrcTooSmall and
+                  not src.empty()));
+
+        expect(result.status == DecompressStatus::Success)
+            << path << " with chunk size " << src_chunk
+            << " got error code: " << static_cast<int>(result.status);
+        expect(src.empty());
+        expect(std::ranges::equal(decompressed, expected_bytes))
+            << path << " with chunk size " << src_chunk
+            << " does not match expected";
+      }
+    }
+  };
+
+  test("inflate table matches decode table") = [] {
+    using Kind = detail::InflateEntry::Kind;
+
+    // an incomplete code with codes longer than the primary table
+    constexpr auto code_table = huffman::table<std::uint16_t, 16>{
+        huffman::symbol_bitsize, {{{0, 3}, 3}, {{4, 11}, 5}, {{12, 15}, 6}}};
+    constexpr auto decode_table =
+        huffman::decode_table<std::uint16_t, 128>{code_table, 4};
+    constexpr auto inflate_table = detail::InflateTable<128>{
+        decode_table, [](std::uint16_t symbol, std::uint8_t bitsize) {
+          return detail::InflateEntry{Kind::Literal, symbol, bitsize};
+        }};
+    static_assert(inflate_table.max_bitsize() == 6);
+
+    for (auto bits = 0UZ; bits != 64; ++bits) {
+      const auto& expected = decode_table.find(bits);
+      const auto actual = inflate_table.find(bits);
+      expect(eq(expected.bitsize, actual.bitsize()));
+      if (expected.bitsize == 0) {
+        expect(actual.kind() == Kind::Invalid);
+        continue;
+      }
+      expect(actual.kind() == Kind::Literal);
+      expect(eq(expected.symbol, actual.value()));
+    }
+  };
+
+  test("direct inflate table matches decode table") = [] {
+    using Kind = detail::InflateEntry::Kind;
+
+    // the table is indexed by more bits than the longest code
+    constexpr auto code_table = huffman::table<std::uint16_t, 8>{
+        huffman::symbol_bitsize, {{{0, 1}, 2}, {{2, 5}, 3}}};
+    constexpr auto decode_table =
+        huffman::decode_table<std::uint16_t, 8>{code_table, 3};
+    constexpr auto inflate_table = detail::DirectInflateTable<5>{
+        decode_table, [](std::uint16_t symbol, std::uint8_t bitsize) {
+          return detail::InflateEntry{Kind::Literal, symbol, bitsize};
+        }};
+
+    for (auto bits = 0UZ; bits != 32; ++bits) {
+      const auto& expected = decode_table.find(bits);
+      const auto actual = inflate_table.find(bits);
+      expect(eq(expected.bitsize, actual.bitsize()));
+      if (expected.bitsize == 0) {
+        expect(actual.kind() == Kind::Invalid);
+        continue;
+      }
+      expect(actual.kind() == Kind::Literal);
+      expect(eq(expected.symbol, actual.value()));
+    }
+  };
+
+  test("fixed huffman tables") = [] {
+    using Kind = detail::InflateEntry::Kind;
+    const auto& tables = detail::fixed_huffman_tables();
+
+    // end of block is 7 zero bits
+    const auto end_of_block = tables.len_table.find(0);
+    expect(end_of_block.kind() == Kind::EndOfBlock);
+    expect(eq(7, end_of_block.bitsize()));
+
+    // literal 0 is 00110000, stored first bit first
+    const auto literal = tables.len_table.find(0b0000'1100);
+    expect(literal.kind() == Kind::Literal);
+    expect(eq(0, literal.value()));
+    expect(eq(8, literal.bitsize()));
+
+    // distance code 4 is 00100, for distances 5 and 6
+    const auto distance = tables.dist_table.find(0b0'0100);
+    expect(distance.kind() == Kind::Base);
+    expect(eq(5, distance.value()));
+    expect(eq(1, distance.extra_bits()));
+    expect(eq(5, distance.bitsize()));
+  };
+
   test("copy_from_before") = [] {
     auto src_and_dst = huffman::byte_array(1, 2, 0, 0, 0, 0);
     const auto dst_span = std::span<std::byte>{src_and_dst}.subspan(2);
     detail::copy_from_before(2, dst_span.begin(), 3);
     expect(eq(src_and_dst, huffman::byte_array(1, 2, 1, 2, 1, 0)));
   };
+
+  test("copy_from_before matches a byte-by-byte copy") = [] {
+    constexpr auto max_distance = 40UZ;
+    constexpr auto max_len = 300UZ;
+    constexpr auto guard = std::byte{0xEE};
+
+    auto expected = std::vector<std::byte>(
+        max_distance + max_len + detail::copy_slack + 1);
+    for (auto distance = 1UZ; distance <= max_distance; ++distance) {
+      for (auto len = 0UZ; len <= max_len; len += (len < 40 ? 1 : 37)) {
+        // history, followed by the output and slack
+        std::ranges::fill(expected, guard);
+        for (auto i = 0UZ; i != distance; ++i) {
+          expected[i] = static_cast<std::byte>(i + 1);
+        }
+        auto exact = expected;
+        auto with_slack = expected;
+        for (auto i = distance; i != distance + len; ++i) {
+          expected[i] = expected[i - distance];
+        }
+        const auto dst = static_cast<std::ptrdiff_t>(distance);
+
+        detail::copy_from_before(
+            static_cast<std::uint16_t>(distance),
+            std::span{exact}.begin() + dst,
+            static_cast<std::uint16_t>(len));
+        expect(exact == expected)
+            << "distance " << distance << ", length " << len;
+
+        detail::copy_from_before_with_slack(
+            static_cast<std::uint16_t>(distance),
+            std::span{with_slack}.begin() + dst,
+            static_cast<std::uint16_t>(len));
+        const auto copied = distance + len;
+        expect(std::ranges::equal(
+            std::span{with_slack}.first(copied),
+            std::span{expected}.first(copied)))
+            << "distance " << distance << ", length " << len;
+        expect(std::ranges::all_of(
+            std::span{with_slack}.subspan(copied + detail::copy_slack),
+            [=](auto b) { return b == guard; }))
+            << "distance " << distance << ", length " << len;
+      }
+    }
+  };
 };
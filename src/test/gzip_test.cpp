@@ -0,0 +1,194 @@
+#include "src/checksum.hpp"
+#include "src/gzip.hpp"
+#include "src/test/test_util.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+
+/// Appends `value` to `bytes` in little-endian order
+template <class T>
+auto append_le(std::vector<std::byte>& bytes, T value) -> void
+{
+  for (auto i = 0UZ; i != sizeof(T); ++i) {
+    bytes.push_back(static_cast<std::byte>(value >> (i * 8U)));
+  }
+}
+
+/// A gzip header with every optional field
+auto header_with_optional_fields() -> std::vector<std::byte>
+{
+  using ::starflate::GzipHeader;
+
+  auto header = std::vector<std::byte>{
+      std::byte{0x1F},
+      std::byte{0x8B},
+      std::byte{8},
+      std::byte{GzipHeader::Text | GzipHeader::HeaderCrc | GzipHeader::Extra |
+                GzipHeader::Name | GzipHeader::Comment}};
+  append_le(header, std::uint32_t{0x6543'2100});  // mtime
+  header.push_back(std::byte{2});                 // xfl
+  header.push_back(std::byte{3});                 // os
+
+  append_le(header, std::uint16_t{4});
+  for (const auto c : {'A', 'P', '\0', '\0'}) {
+    header.push_back(static_cast<std::byte>(c));
+  }
+  // the zero terminators of the string literals terminate the fields
+  for (const auto c : "name") {
+    header.push_back(static_cast<std::byte>(c));
+  }
+  for (const auto c : "a comment") {
+    header.push_back(static_cast<std::byte>(c));
+  }
+  append_le(header, static_cast<std::uint16_t>(::starflate::crc32(header)));
+  return header;
+}
+
+auto as_string(std::span<const std::byte> bytes) -> std::string
+{
+  auto str = std::string{};
+  std::ranges::transform(bytes, std::back_inserter(str), [](auto b) {
+    return std::to_integer<char>(b);
+  });
+  return str;
+}
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  test("read_gzip_header") = [argv] {
+    const auto member =
+        read_runfile(*argv, "starflate/src/test/starfleet.html.gz");
+
+    const auto header = read_gzip_header(member);
+    expect(header.has_value())
+        << "got error: " << static_cast<int>(header.error());
+    expect(eq(0U, unsigned{header->flags}));
+    expect(eq(10UZ, header->size));
+    expect(header->extra.empty());
+    expect(header->name.empty());
+    expect(header->comment.empty());
+  };
+
+  test("read_gzip_header with optional fields") = [] {
+    const auto bytes = header_with_optional_fields();
+
+    const auto header = read_gzip_header(bytes);
+    expect(header.has_value())
+        << "got error: " << static_cast<int>(header.error());
+    expect(eq(0x6543'2100U, header->mtime));
+    expect(eq(2U, unsigned{header->extra_flags}));
+    expect(eq(3U, unsigned{header->os}));
+    expect(eq(std::string{'A', 'P', 0, 0}, as_string(header->extra)));
+    expect(eq(std::string{"name"}, as_string(header->name)));
+    expect(eq(std::string{"a comment"}, as_string(header->comment)));
+    expect(eq(bytes.size(), header->size));
+
+    for (auto size = 0UZ; size != bytes.size(); ++size) {
+      const auto truncated = read_gzip_header(std::span{bytes}.first(size));
+      expect(truncated.error() == DecompressStatus::SrcTooSmall)
+          << "truncated to " << size << " bytes";
+    }
+  };
+
+  test("read_gzip_header rejects invalid headers") = [] {
+    const auto valid = header_with_optional_fields();
+
+    // ID1, ID2, CM, reserved FLG bits and the header CRC
+    for (const auto& [offset, value] : {std::pair{0UZ, std::byte{0x1E}},
+                                        {1UZ, std::byte{0x8C}},
+                                        {2UZ, std::byte{7}},
+                                        {3UZ, std::byte{0xFF}},
+                                        {valid.size() - 1, std::byte{0}}}) {
+      auto bytes = valid;
+      bytes[offset] = value;
+      const auto header = read_gzip_header(bytes);
+      expect(not header.has_value() and
+             header.error() == DecompressStatus::InvalidGzipHeader)
+          << "modified byte " << offset;
+    }
+  };
+
+  test("decompress_gzip") = [argv] {
+    const auto member =
+        read_runfile(*argv, "starflate/src/test/starfleet.html.gz");
+    const auto expected =
+        read_runfile(*argv, "starflate/src/test/starfleet.html");
+
+    // a second member follows the first
+    auto src = member;
+    src.insert(src.end(), member.begin(), member.end());
+
+    auto dst = std::vector<std::byte>(expected.size());
+    const auto result = decompress_gzip(src, dst);
+    expect(result.status == DecompressStatus::Success)
+        << "got error code: " << static_cast<int>(result.status);
+    expect(eq(member.size(), result.src_consumed));
+    expect(eq(expected.size(), result.dst_written));
+    expect(std::ranges::equal(dst, expected));
+
+    const auto too_small =
+        decompress_gzip(member, std::span{dst}.first(expected.size() - 1));
+    expect(too_small.status == DecompressStatus::DstTooSmall);
+  };
+
+  test("decompress_gzip with optional header fields") = [argv] {
+    const auto expected =
+        read_runfile(*argv, "starflate/src/test/starfleet.html");
+
+    auto member = header_with_optional_fields();
+    const auto compressed =
+        read_runfile(*argv, "starflate/src/test/starfleet.html.dynamic");
+    member.insert(member.end(), compressed.begin(), compressed.end());
+    append_le(member, crc32(expected));
+    append_le(member, static_cast<std::uint32_t>(expected.size()));
+
+    auto dst = std::vector<std::byte>(expected.size());
+    const auto result = decompress_gzip(member, dst);
+    expect(result.status == DecompressStatus::Success)
+        << "got error code: " << static_cast<int>(result.status);
+    expect(eq(member.size(), result.src_consumed));
+    expect(std::ranges::equal(dst, expected));
+  };
+
+  test("decompress_gzip verifies the trailer") = [argv] {
+    const auto member =
+        read_runfile(*argv, "starflate/src/test/starfleet.html.gz");
+    auto dst = std::vector<std::byte>(200'000);
+
+    auto bad_crc = member;
+    bad_crc[member.size() - 8] ^= std::byte{1};
+    expect(
+        decompress_gzip(bad_crc, dst).status ==
+        DecompressStatus::ChecksumMismatch);
+
+    auto bad_size = member;
+    bad_size[member.size() - 4] ^= std::byte{1};
+    expect(
+        decompress_gzip(bad_size, dst).status ==
+        DecompressStatus::SizeMismatch);
+
+    const auto truncated = std::span{member}.first(member.size() - 1);
+    expect(
+        decompress_gzip(truncated, dst).status ==
+        DecompressStatus::SrcTooSmall);
+  };
+}
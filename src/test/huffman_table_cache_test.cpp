@@ -0,0 +1,138 @@
+#include "src/compress.hpp"
+#include "src/decompress.hpp"
+#include "src/huffman_table_cache.hpp"
+#include "src/test/test_util.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+using ::starflate::test::compress_raw;
+
+/// Decompresses `src` with a decompressor using `cache`
+///
+auto decompress_cached(
+    std::span<const std::byte> src,
+    std::size_t dst_size,
+    ::starflate::HuffmanTableCache& cache) -> std::vector<std::byte>
+{
+  auto decompressor = std::make_unique<::starflate::Decompressor>(cache);
+  auto dst = std::vector<std::byte>(dst_size);
+  const auto result = decompressor->decompress(src, dst);
+  ::boost::ut::expect(result.status == ::starflate::DecompressStatus::Success)
+      << "got status: " << static_cast<int>(result.status);
+  dst.resize(result.dst_written);
+  return dst;
+}
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::fatal;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  const auto text = read_runfile(*argv, "starflate/src/test/starfleet.html");
+  const auto compressed = compress_raw(text, default_compress_level);
+
+  test("find returns the tables inserted for the same bitsizes") = [] {
+    auto len_bitsizes = std::array<std::uint8_t, 288>{};
+    std::ranges::fill(std::span{len_bitsizes}.first(144), 8);
+    std::ranges::fill(std::span{len_bitsizes}.subspan(144, 112), 9);
+    std::ranges::fill(std::span{len_bitsizes}.subspan(256, 24), 7);
+    std::ranges::fill(std::span{len_bitsizes}.subspan(280), 8);
+    auto dist_bitsizes = std::array<std::uint8_t, 32>{};
+    std::ranges::fill(dist_bitsizes, 5);
+    const auto literal_entry = [](std::uint16_t symbol, std::uint8_t bitsize) {
+      return detail::InflateEntry{
+          detail::InflateEntry::Kind::Literal, symbol, bitsize};
+    };
+    const auto tables = detail::DynamicHuffmanTables{
+        .len_table = {huffman::decode_table<std::uint16_t, 512>{
+                          huffman::code_bitsizes, len_bitsizes, 9},
+                      literal_entry},
+        .dist_table = {huffman::decode_table<std::uint16_t, 32>{
+                           huffman::code_bitsizes, dist_bitsizes, 5},
+                       literal_entry}};
+
+    // a single slot
+    auto cache = HuffmanTableCache{1};
+    expect(cache.find(len_bitsizes, dist_bitsizes) == nullptr);
+    cache.insert(len_bitsizes, dist_bitsizes, tables);
+    expect(eq(1UZ, cache.size()));
+
+    const auto* found = cache.find(len_bitsizes, dist_bitsizes);
+    expect(fatal(found != nullptr));
+    expect(found != &tables);
+    const auto same_entry = [](const auto& lhs, const auto& rhs) {
+      return lhs.kind() == rhs.kind() and lhs.value() == rhs.value() and
+             lhs.bitsize() == rhs.bitsize();
+    };
+    for (auto bits = 0UZ; bits != 512; ++bits) {
+      expect(same_entry(
+          found->len_table.find(bits), tables.len_table.find(bits)));
+      expect(same_entry(
+          found->dist_table.find(bits), tables.dist_table.find(bits)));
+    }
+
+    // other bitsizes are not found, and are not cached in the taken slot
+    const auto other_dist_bitsizes = std::span{dist_bitsizes}.first(30);
+    expect(cache.find(len_bitsizes, other_dist_bitsizes) == nullptr);
+    cache.insert(len_bitsizes, other_dist_bitsizes, tables);
+    expect(cache.find(len_bitsizes, other_dist_bitsizes) == nullptr);
+    expect(cache.find(len_bitsizes, dist_bitsizes) == found);
+  };
+
+  test("repeated headers reuse cached tables") = [&compressed] {
+    auto cache = HuffmanTableCache{};
+
+    for (const auto expect_cached : {false, true}) {
+      auto state = detail::InflateState{
+          .src_bits = huffman::bit_reader{huffman::bit_span{compressed}},
+          .table_cache = &cache};
+      const auto header = detail::read_header(state.src_bits);
+      expect(fatal(header.has_value()));
+      expect(fatal(header->type == detail::BlockType::DynamicHuffman));
+      expect(
+          detail::decode_dynamic_huffman_tables(state) ==
+          DecompressStatus::Success);
+      expect(eq(expect_cached, state.cached_tables != nullptr));
+    }
+    expect(eq(1UZ, cache.size()));
+  };
+
+  test("decompressors sharing a cache") = [&text, &compressed] {
+    auto cache = HuffmanTableCache{};
+    expect(decompress_cached(compressed, text.size(), cache) == text);
+    const auto size = cache.size();
+    expect(size > 0UZ);
+
+    auto outputs = std::vector<std::vector<std::byte>>(4);
+    auto threads = std::vector<std::thread>{};
+    for (auto& output : outputs) {
+      threads.emplace_back([&output, &compressed, &text, &cache] {
+        output = decompress_cached(compressed, text.size(), cache);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    for (const auto& output : outputs) {
+      expect(output == text);
+    }
+    expect(eq(size, cache.size()));
+  };
+}
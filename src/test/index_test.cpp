@@ -0,0 +1,165 @@
+#include "src/compress.hpp"
+#include "src/decompress.hpp"
+#include "src/index.hpp"
+#include "src/test/test_util.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+using ::starflate::test::compress_raw;
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::fatal;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  const auto text = read_runfile(*argv, "starflate/src/test/starfleet.html");
+  auto repeated = std::vector<std::byte>{};
+  for (auto i = 0; i != 4; ++i) {
+    repeated.insert(repeated.end(), text.begin(), text.end());
+  }
+  const auto data = std::span<const std::byte>{repeated};
+  constexpr auto spacing = std::size_t{1} << 16U;
+
+  test("build_index records checkpoints at block boundaries") = [data] {
+    for (const auto level : {0, 1, 6}) {
+      auto compressed = compress_raw(data, static_cast<std::uint8_t>(level));
+      const auto stream_size = compressed.size();
+      // bytes following the stream are not part of it
+      compressed.push_back(std::byte{0xFF});
+
+      const auto index = build_index(compressed, spacing);
+      expect(fatal(index.has_value()))
+          << "level " << level << " got " << static_cast<int>(index.error());
+      expect(eq(stream_size, index->src_size));
+      expect(eq(data.size(), index->dst_size));
+      expect(fatal(index->checkpoints.size() > 2)) << "level " << level;
+
+      auto previous = index->checkpoints.front();
+      expect(eq(0UZ, previous.src_bit));
+      expect(eq(0UZ, previous.dst_offset));
+      for (const auto& checkpoint :
+           std::span{index->checkpoints}.subspan(1)) {
+        expect(checkpoint.dst_offset - previous.dst_offset >= spacing);
+        expect(checkpoint.src_bit > previous.src_bit);
+        expect(std::ranges::equal(
+            checkpoint.window,
+            data.first(checkpoint.dst_offset).last(window_size)));
+
+        // decompression resumes at the checkpoint
+        auto dst = std::vector<std::byte>(data.size() - checkpoint.dst_offset);
+        auto state = detail::InflateState{
+            .src_bits = huffman::bit_reader{
+                std::span{compressed}.subspan(checkpoint.src_bit / CHAR_BIT)
+                    .data(),
+                (stream_size * CHAR_BIT) - checkpoint.src_bit,
+                static_cast<std::uint8_t>(checkpoint.src_bit % CHAR_BIT)}};
+        auto output = detail::InflateOutput{
+            .dst = dst, .history = checkpoint.window};
+        expect(detail::inflate(state, output) == DecompressStatus::Success)
+            << "level " << level << " offset " << checkpoint.dst_offset;
+        expect(std::ranges::equal(dst, data.subspan(checkpoint.dst_offset)));
+        previous = checkpoint;
+      }
+    }
+  };
+
+  test("build_index rejects invalid streams") = [data] {
+    const auto compressed = compress_raw(data, default_compress_level);
+    const auto truncated =
+        std::span{compressed}.first(compressed.size() / 2);
+    expect(not build_index(truncated, spacing).has_value());
+    expect(
+        build_index({}, spacing).error() ==
+        DecompressStatus::InvalidBlockHeader);
+  };
+
+  test("read_at reads any range of the output") = [data] {
+    const auto compressed = compress_raw(data, default_compress_level);
+    const auto index = build_index(compressed, spacing);
+    expect(fatal(index.has_value()));
+
+    for (const auto offset :
+         {0UZ,
+          1UZ,
+          spacing - 1,
+          spacing,
+          index->checkpoints[1].dst_offset,
+          index->checkpoints[1].dst_offset + 100'000,
+          data.size() - 10}) {
+      for (const auto length : {0UZ, 1UZ, 1000UZ, 100'000UZ}) {
+        auto dst = std::vector<std::byte>(length);
+        const auto read = read_at(compressed, *index, offset, dst);
+        expect(fatal(read.has_value()))
+            << "offset " << offset << " got " << static_cast<int>(read.error());
+        // reads stop at the end of the output
+        const auto expected =
+            data.subspan(offset, std::min(length, data.size() - offset));
+        expect(eq(expected.size(), *read));
+        expect(std::ranges::equal(std::span{dst}.first(*read), expected))
+            << "offset " << offset << " length " << length;
+      }
+    }
+
+    auto dst = std::vector<std::byte>(10);
+    expect(eq(0UZ, *read_at(compressed, *index, data.size(), dst)));
+    expect(
+        read_at(std::span{compressed}.first(10), *index, 0, dst).error() ==
+        DecompressStatus::SrcTooSmall);
+    expect(
+        read_at(compressed, Index{}, 0, dst).error() ==
+        DecompressStatus::InvalidIndex);
+  };
+
+  test("serialize_index round trips") = [data] {
+    const auto compressed = compress_raw(data, default_compress_level);
+    const auto index = build_index(compressed, spacing);
+    expect(fatal(index.has_value()));
+
+    const auto serialized = serialize_index(*index);
+    const auto deserialized = deserialize_index(serialized);
+    expect(fatal(deserialized.has_value()));
+    expect(*deserialized == *index);
+
+    auto dst = std::vector<std::byte>(1000);
+    expect(eq(dst.size(), *read_at(compressed, *deserialized, 300'000, dst)));
+    expect(std::ranges::equal(dst, data.subspan(300'000, dst.size())));
+  };
+
+  test("deserialize_index rejects invalid indexes") = [data] {
+    const auto compressed = compress_raw(data, default_compress_level);
+    const auto serialized = serialize_index(*build_index(compressed, spacing));
+    const auto bytes = std::span{serialized};
+
+    expect(not deserialize_index({}).has_value());
+    expect(not deserialize_index(bytes.first(bytes.size() - 1)).has_value());
+    auto extended = serialized;
+    extended.push_back(std::byte{});
+    expect(not deserialize_index(extended).has_value());
+
+    // the magic bytes, the number of checkpoints, and the most significant
+    // byte of the bit offset of the second checkpoint
+    for (const auto offset : {0UZ, 24UZ + 7, 32UZ + 16 + 7}) {
+      auto corrupted = serialized;
+      corrupted[offset] ^= std::byte{0x80};
+      expect(
+          deserialize_index(corrupted).error() ==
+          DecompressStatus::InvalidIndex)
+          << "offset " << offset;
+    }
+  };
+}
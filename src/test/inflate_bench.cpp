@@ -0,0 +1,340 @@
+#include "src/compress.hpp"
+#include "src/decompress.hpp"
+#include "src/test/test_util.hpp"
+#include "version/version.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ignore checks to Google Benchmark headers,
+// NOLINTBEGIN(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
+
+// Benchmarks of the stages of inflate in isolation, so that a change in the
+// speed of decompression can be traced to the stage that moved.
+
+namespace {
+
+using Bytes = std::vector<std::byte>;
+
+namespace detail = starflate::detail;
+namespace huffman = starflate::huffman;
+
+/// Uniformly random bytes
+///
+auto make_random(std::size_t size) -> Bytes
+{
+  auto rng = std::mt19937{size};
+  auto bytes = Bytes(size);
+  for (auto& byte : bytes) {
+    byte = static_cast<std::byte>(rng());
+  }
+  return bytes;
+}
+
+/// Number of random bytes that bits and codes are read from
+///
+// NOLINTNEXTLINE(readability-magic-numbers)
+constexpr auto random_input_size = std::size_t{1} << 16U;
+
+void BM_ReadHeader(benchmark::State& state)
+{
+  // valid block headers of random finality and type, packed back to back
+  constexpr auto kHeaderBits = 3UZ;
+  // NOLINTNEXTLINE(readability-magic-numbers)
+  constexpr auto kHeaders = 8192UZ;
+  auto rng = std::mt19937{kHeaders};
+  auto headers = Bytes(kHeaders * kHeaderBits / CHAR_BIT);
+  for (auto i = 0UZ; i != kHeaders; ++i) {
+    const auto header = (rng() % 2) | ((rng() % 3) << 1U);
+    for (auto bit = 0UZ; bit != kHeaderBits; ++bit) {
+      const auto offset = (i * kHeaderBits) + bit;
+      headers[offset / CHAR_BIT] |=
+          static_cast<std::byte>(((header >> bit) & 1U) << (offset % CHAR_BIT));
+    }
+  }
+
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto bits = huffman::bit_reader{huffman::bit_span{headers}};
+    for (auto i = 0UZ; i != kHeaders; ++i) {
+      auto header = detail::read_header(bits);
+      benchmark::DoNotOptimize(header);
+    }
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(kHeaders));
+}
+
+/// Pops fields of `state.range(0)` bits, as the header, length and distance
+/// fields of a block are read
+///
+void BM_PopBits(benchmark::State& state)
+{
+  const auto n = static_cast<std::uint8_t>(state.range(0));
+  const auto input = make_random(random_input_size);
+  const auto count = (input.size() * CHAR_BIT) / n;
+
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto bits = huffman::bit_reader{huffman::bit_span{input}};
+    for (auto i = 0UZ; i != count; ++i) {
+      auto field = bits.pop(n);
+      benchmark::DoNotOptimize(field);
+    }
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(count));
+  state.SetBytesProcessed(
+      state.iterations() * static_cast<std::int64_t>(input.size()));
+}
+
+/// Decodes literal/length codes and consumes their extra bits, as the fast
+/// loop of a block does
+///
+/// The input is random, so each symbol is decoded with the probability its
+/// code length implies, as for a stream the code was built for.
+///
+template <class Table>
+void decode_symbols(benchmark::State& state, const Table& table)
+{
+  const auto input = make_random(random_input_size);
+  // refill loads a whole word, which is not done past the end of input
+  const auto min_input = sizeof(std::uint64_t);
+
+  auto symbols = std::int64_t{};
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto bits = huffman::bit_reader{huffman::bit_span{input}};
+    while (bits.unbuffered_bytes() >= min_input) {
+      bits.refill();
+      const auto entry = table.find(bits.peek(huffman::bit_reader::max_bits));
+      benchmark::DoNotOptimize(entry);
+      // entries of an incomplete code without a symbol have no bits
+      bits.consume(std::max<std::uint8_t>(
+          static_cast<std::uint8_t>(entry.bitsize() + entry.extra_bits()), 1));
+      ++symbols;
+    }
+  }
+  state.SetItemsProcessed(symbols);
+  state.SetBytesProcessed(
+      state.iterations() * static_cast<std::int64_t>(input.size()));
+}
+
+void BM_DecodeSymbolFixed(benchmark::State& state)
+{
+  decode_symbols(state, detail::fixed_huffman_tables().len_table);
+}
+
+/// Dynamic block headers, each starting after the 3 bit block header
+///
+using Headers = std::vector<huffman::bit_span>;
+
+void BM_DecodeSymbolDynamic(benchmark::State& state, const Headers& headers)
+{
+  // the tables of the first block of a stream of text
+  auto tables = detail::InflateState{
+      .src_bits = huffman::bit_reader{headers.front()}};
+  if (detail::decode_dynamic_huffman_tables(tables) !=
+      starflate::DecompressStatus::Success) {
+    state.SkipWithError("failed to decode dynamic block header");
+    return;
+  }
+  decode_symbols(state, tables.dynamic_tables().len_table);
+}
+
+using CopyFunction =
+    void(std::uint16_t, std::span<std::byte>::iterator, std::uint16_t);
+
+/// Copies matches of distance `state.range(0)` and length `state.range(1)`
+/// to successive positions of a buffer
+///
+template <CopyFunction* Copy>
+void BM_CopyFromBefore(benchmark::State& state)
+{
+  const auto distance = static_cast<std::uint16_t>(state.range(0));
+  const auto length = static_cast<std::uint16_t>(state.range(1));
+
+  // the window, followed by space for the copies and their slack
+  constexpr auto kCopiesSize = std::size_t{1} << 16U;
+  auto buffer = make_random(
+      starflate::window_size + kCopiesSize + detail::copy_slack);
+  const auto begin = std::span{buffer}.begin() +
+                     static_cast<std::ptrdiff_t>(starflate::window_size);
+  const auto end = begin + static_cast<std::ptrdiff_t>(kCopiesSize - length);
+
+  auto dst = begin;
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    Copy(distance, dst, length);
+    benchmark::ClobberMemory();
+    dst += length;
+    if (dst > end) {
+      dst = begin;
+    }
+  }
+  state.SetBytesProcessed(
+      state.iterations() * static_cast<std::int64_t>(length));
+}
+
+void BM_DecodeDynamicHuffmanTables(
+    benchmark::State& state, const Headers& headers)
+{
+  auto inflate_state = detail::InflateState{};
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    for (const auto& header : headers) {
+      inflate_state.src_bits = huffman::bit_reader{header};
+      if (detail::decode_dynamic_huffman_tables(inflate_state) !=
+          starflate::DecompressStatus::Success) {
+        state.SkipWithError("failed to decode dynamic block header");
+        return;
+      }
+      benchmark::DoNotOptimize(inflate_state.tables);
+    }
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(headers.size()));
+}
+
+/// Decompresses a single final stored block of `state.range(0)` bytes
+///
+void BM_StoredBlock(benchmark::State& state)
+{
+  const auto size = static_cast<std::uint16_t>(state.range(0));
+  // a final stored block, with the length and its complement
+  auto block = Bytes{
+      std::byte{1},
+      static_cast<std::byte>(size),
+      static_cast<std::byte>(size >> CHAR_BIT),
+      ~static_cast<std::byte>(size),
+      ~static_cast<std::byte>(size >> CHAR_BIT)};
+  const auto data = make_random(size);
+  block.insert(block.end(), data.begin(), data.end());
+  auto dst = Bytes(size);
+
+  state.SetLabel(starflate::Version::full_version_string);
+  for (auto _ : state) {
+    auto inflate_state = detail::InflateState{
+        .src_bits = huffman::bit_reader{huffman::bit_span{block}}};
+    auto output = detail::InflateOutput{.dst = dst};
+    if (detail::inflate(inflate_state, output) !=
+        starflate::DecompressStatus::Success) {
+      state.SkipWithError("failed to decompress stored block");
+      return;
+    }
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(
+      state.iterations() * static_cast<std::int64_t>(size));
+}
+
+using ::starflate::test::read_runfile;
+
+/// Records the dynamic block headers of `compressed`, a stream of `size`
+/// bytes
+///
+auto record_headers(std::span<const std::byte> compressed, std::size_t size)
+    -> Headers
+{
+  auto headers = Headers{};
+  auto dst = Bytes(size);
+  auto state = detail::InflateState{
+      .src_bits = huffman::bit_reader{huffman::bit_span{compressed}}};
+  auto output = detail::InflateOutput{.dst = dst};
+  while (state.step != detail::InflateState::Step::Done) {
+    auto bits = state.src_bits.bits();
+    const auto header = detail::read_header(bits);
+    if (header and header->type == detail::BlockType::DynamicHuffman) {
+      headers.push_back(bits);
+    }
+    if (detail::inflate_to_block_end(state, output) !=
+        starflate::DecompressStatus::Success) {
+      return {};
+    }
+  }
+  return headers;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  const auto html = read_runfile(*argv, "starflate/src/test/starfleet.html");
+
+  // the headers of each level are kept for the duration of the benchmarks
+  constexpr auto levels = std::array<std::uint8_t, 3>{
+      1, starflate::default_compress_level, starflate::max_compress_level};
+  auto headers = std::array<Headers, levels.size()>{};
+  auto compressed = std::array<Bytes, levels.size()>{};
+  for (auto i = 0UZ; i != levels.size(); ++i) {
+    compressed[i].resize(starflate::compress_bound(html.size()));
+    const auto result = starflate::compress(html, compressed[i], levels[i]);
+    compressed[i].resize(result.dst_written);
+    headers[i] = record_headers(compressed[i], html.size());
+    if (result.status != starflate::CompressStatus::Success or
+        headers[i].empty()) {
+      std::cerr << "failed to record dynamic block headers\n";
+      return 1;
+    }
+  }
+
+  benchmark::RegisterBenchmark("BM_ReadHeader", BM_ReadHeader);
+
+  // NOLINTNEXTLINE(readability-magic-numbers)
+  benchmark::RegisterBenchmark("BM_PopBits", BM_PopBits)->DenseRange(1, 13);
+
+  benchmark::RegisterBenchmark(
+      "BM_DecodeSymbol/fixed", BM_DecodeSymbolFixed);
+  benchmark::RegisterBenchmark(
+      "BM_DecodeSymbol/dynamic", BM_DecodeSymbolDynamic, headers[1]);
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  const auto distances =
+      std::vector<std::int64_t>{1, 2, 3, 4, 7, 8, 16, 31, 32, 258, 32768};
+  const auto lengths =
+      std::vector<std::int64_t>{3, 4, 8, 16, 31, 32, 64, 128, 258};
+  // NOLINTEND(readability-magic-numbers)
+  benchmark::RegisterBenchmark(
+      "BM_CopyFromBefore", BM_CopyFromBefore<detail::copy_from_before>)
+      ->ArgsProduct({distances, lengths});
+  benchmark::RegisterBenchmark(
+      "BM_CopyFromBeforeWithSlack",
+      BM_CopyFromBefore<detail::copy_from_before_with_slack>)
+      ->ArgsProduct({distances, lengths});
+
+  for (auto i = 0UZ; i != levels.size(); ++i) {
+    benchmark::RegisterBenchmark(
+        ("BM_DecodeDynamicHuffmanTables/level" + std::to_string(levels[i]))
+            .c_str(),
+        BM_DecodeDynamicHuffmanTables,
+        headers[i]);
+  }
+
+  benchmark::RegisterBenchmark("BM_StoredBlock", BM_StoredBlock)
+      // NOLINTNEXTLINE(readability-magic-numbers)
+      ->RangeMultiplier(16)
+      // NOLINTNEXTLINE(readability-magic-numbers)
+      ->Range(16, 65535);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
+
+// NOLINTEND(clang-analyzer-deadcode.DeadStores,cppcoreguidelines-avoid-non-const-global-variables,cppcoreguidelines-owning-memory,modernize-use-trailing-return-type)
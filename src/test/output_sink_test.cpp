@@ -0,0 +1,128 @@
+#include "src/compress.hpp"
+#include "src/decompress.hpp"
+#include "src/output_sink.hpp"
+#include "src/test/test_util.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+using ::starflate::test::compress_raw;
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  static_assert(OutputSink<SpanSink>);
+  static_assert(OutputSink<VectorSink>);
+  static_assert(OutputSink<ScatterSink>);
+  static_assert(OutputSink<CallbackSink<void (*)(std::span<const std::byte>)>>);
+
+  const auto text = read_runfile(*argv, "starflate/src/test/starfleet.html");
+  const auto data = std::span<const std::byte>{text};
+  auto compressed = compress_raw(data, default_compress_level);
+  const auto stream_size = compressed.size();
+  // bytes following the stream are not read
+  compressed.push_back(std::byte{0xFF});
+
+  test("decompress into a span") = [&] {
+    auto dst = std::vector<std::byte>(data.size());
+    const auto result = decompress(compressed, SpanSink{dst});
+    expect(result.status == DecompressStatus::Success)
+        << "got " << static_cast<int>(result.status);
+    expect(eq(stream_size, result.src_consumed));
+    expect(eq(data.size(), result.dst_written));
+    expect(std::ranges::equal(dst, data));
+
+    // the number of bytes written is known even if dst is too small
+    dst.resize(1000);
+    const auto partial = decompress(compressed, SpanSink{dst});
+    expect(partial.status == DecompressStatus::DstTooSmall);
+    expect(eq(0UZ, partial.src_consumed));
+    expect(eq(dst.size(), partial.dst_written));
+    expect(std::ranges::equal(dst, data.first(dst.size())));
+  };
+
+  test("decompress into a vector that grows") = [&] {
+    for (const auto reserved : {0UZ, 100UZ, data.size(), 2 * data.size()}) {
+      auto dst = std::vector<std::byte>{std::byte{1}, std::byte{2}};
+      dst.reserve(reserved);
+      const auto result = decompress(compressed, VectorSink{dst});
+      expect(result.status == DecompressStatus::Success)
+          << "reserved " << reserved << " got "
+          << static_cast<int>(result.status);
+      expect(eq(stream_size, result.src_consumed));
+      expect(eq(data.size(), result.dst_written));
+      expect(std::ranges::equal(dst, data)) << "reserved " << reserved;
+    }
+  };
+
+  test("decompress into a list of buffers") = [&] {
+    auto buffer = std::vector<std::byte>(data.size());
+    const auto all = std::span{buffer};
+    // parts smaller and larger than the window, and empty parts
+    const auto parts = std::vector<std::span<std::byte>>{
+        all.first(1),
+        all.subspan(1, 0),
+        all.subspan(1, 100),
+        all.subspan(101, 40'000),
+        all.subspan(40'101, 7),
+        all.subspan(40'108, 10'000),
+        all.subspan(50'108)};
+    const auto result = decompress(compressed, ScatterSink{parts});
+    expect(result.status == DecompressStatus::Success)
+        << "got " << static_cast<int>(result.status);
+    expect(eq(stream_size, result.src_consumed));
+    expect(eq(data.size(), result.dst_written));
+    expect(std::ranges::equal(buffer, data));
+
+    const auto partial = decompress(
+        compressed, ScatterSink{std::span{parts}.first(parts.size() - 1)});
+    expect(partial.status == DecompressStatus::DstTooSmall);
+    expect(eq(50'108UZ, partial.dst_written));
+  };
+
+  test("decompress into a callback") = [&] {
+    auto output = std::vector<std::byte>{};
+    auto calls = 0UZ;
+    const auto result = decompress(
+        compressed,
+        CallbackSink{[&output, &calls](std::span<const std::byte> part) {
+          expect(not part.empty());
+          expect(part.size() <= CallbackSink<int>::part_size);
+          output.insert(output.end(), part.begin(), part.end());
+          ++calls;
+        }});
+    expect(result.status == DecompressStatus::Success)
+        << "got " << static_cast<int>(result.status);
+    expect(eq(stream_size, result.src_consumed));
+    expect(eq(data.size(), result.dst_written));
+    expect(std::ranges::equal(output, data));
+    expect(calls > 1UZ);
+  };
+
+  test("decompress into a sink rejects invalid streams") = [&] {
+    auto dst = std::vector<std::byte>{};
+    expect(
+        decompress({}, VectorSink{dst}).status ==
+        DecompressStatus::InvalidBlockHeader);
+
+    const auto truncated =
+        std::span{compressed}.first(stream_size / 2);
+    const auto result = decompress(truncated, VectorSink{dst});
+    expect(result.status != DecompressStatus::Success);
+    expect(eq(0UZ, result.src_consumed));
+  };
+}
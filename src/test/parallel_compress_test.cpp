@@ -0,0 +1,129 @@
+#include "src/decompress.hpp"
+#include "src/gzip.hpp"
+#include "src/parallel_compress.hpp"
+#include "src/test/test_util.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+
+/// Returns several copies of `text`, each followed by a distinct byte, so
+/// that back-references cross chunk boundaries
+///
+auto repeated(std::span<const std::byte> text, std::size_t copies)
+    -> std::vector<std::byte>
+{
+  auto data = std::vector<std::byte>{};
+  for (auto i = 0UZ; i != copies; ++i) {
+    data.insert(data.end(), text.begin(), text.end());
+    data.push_back(static_cast<std::byte>(i));
+  }
+  return data;
+}
+
+auto compress_all(
+    std::span<const std::byte> src,
+    const ::starflate::ParallelCompressOptions& options)
+    -> std::vector<std::byte>
+{
+  auto dst = std::vector<std::byte>(
+      ::starflate::parallel_compress_bound(src.size(), options));
+  const auto result = ::starflate::compress_parallel(src, dst, options);
+  ::boost::ut::expect(
+      ::boost::ut::fatal(result.status == ::starflate::CompressStatus::Success))
+      << "got status: " << static_cast<int>(result.status);
+  dst.resize(result.dst_written);
+  return dst;
+}
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  const auto text = read_runfile(*argv, "starflate/src/test/starfleet.html");
+  const auto src = repeated(text, 4);
+
+  test("compress_parallel output does not depend on threads") = [&src] {
+    for (const auto format : {CompressFormat::Deflate, CompressFormat::Gzip}) {
+      const auto expected = compress_all(src, {.format = format, .threads = 1});
+      for (const auto threads : {2UZ, 3UZ, 8UZ, 0UZ}) {
+        expect(
+            compress_all(src, {.format = format, .threads = threads}) ==
+            expected)
+            << "threads " << threads;
+      }
+    }
+  };
+
+  test("compress_parallel deflate round trips") = [&src] {
+    for (const auto level : {0, 1, 6, 9}) {
+      for (const auto chunk_size :
+           {min_parallel_chunk_size, max_parallel_chunk_size}) {
+        const auto compressed = compress_all(
+            src,
+            {.level = static_cast<std::uint8_t>(level),
+             .chunk_size = chunk_size,
+             .threads = 4});
+        auto dst = std::vector<std::byte>(src.size());
+        expect(decompress(compressed, dst) == DecompressStatus::Success)
+            << "level " << level << " chunk size " << chunk_size;
+        expect(dst == src) << "level " << level << " chunk size " << chunk_size;
+      }
+    }
+  };
+
+  test("compress_parallel gzip round trips") = [&src] {
+    for (const auto size : {0UZ, 1UZ, min_parallel_chunk_size, src.size()}) {
+      const auto part = std::span{src}.first(size);
+      const auto compressed =
+          compress_all(part, {.format = CompressFormat::Gzip, .threads = 4});
+      // the CRC-32 and size are verified against the trailer
+      auto dst = std::vector<std::byte>(size);
+      const auto result = decompress_gzip(compressed, dst);
+      expect(result.status == DecompressStatus::Success)
+          << "size " << size << " got " << static_cast<int>(result.status);
+      expect(eq(compressed.size(), result.src_consumed));
+      expect(std::ranges::equal(dst, part));
+    }
+  };
+
+  test("compress_parallel with a small dst") = [&src] {
+    const auto options =
+        ParallelCompressOptions{.format = CompressFormat::Gzip, .threads = 2};
+    const auto compressed = compress_all(src, options);
+    for (const auto size :
+         {0UZ, compressed.size() / 2, compressed.size() - 1}) {
+      auto dst = std::vector<std::byte>(size);
+      expect(
+          compress_parallel(src, dst, options).status ==
+          CompressStatus::DstTooSmall)
+          << "size " << size;
+    }
+  };
+
+  test("compress_parallel rejects invalid options") = [&src] {
+    auto dst = std::vector<std::byte>(parallel_compress_bound(src.size()));
+    expect(
+        compress_parallel(src, dst, {.level = max_compress_level + 1}).status ==
+        CompressStatus::InvalidLevel);
+    expect(
+        compress_parallel(src, dst, {.chunk_size = min_parallel_chunk_size - 1})
+            .status == CompressStatus::InvalidChunkSize);
+    expect(
+        compress_parallel(src, dst, {.chunk_size = max_parallel_chunk_size + 1})
+            .status == CompressStatus::InvalidChunkSize);
+  };
+}
@@ -0,0 +1,468 @@
+#include "src/compress.hpp"
+#include "src/decompress.hpp"
+#include "src/index.hpp"
+#include "src/parallel_compress.hpp"
+#include "src/parallel_decompress.hpp"
+#include "src/speculative_inflate.hpp"
+#include "src/test/test_util.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+using ::starflate::test::compress_raw;
+
+auto compress_gzip(std::span<const std::byte> src, std::uint8_t level)
+    -> std::vector<std::byte>
+{
+  const auto options = ::starflate::ParallelCompressOptions{
+      .format = ::starflate::CompressFormat::Gzip, .level = level};
+  auto dst = std::vector<std::byte>(
+      ::starflate::parallel_compress_bound(src.size(), options));
+  const auto result = ::starflate::compress_parallel(src, dst, options);
+  ::boost::ut::expect(
+      ::boost::ut::fatal(result.status == ::starflate::CompressStatus::Success))
+      << "got status: " << static_cast<int>(result.status);
+  dst.resize(result.dst_written);
+  return dst;
+}
+
+/// A gzip file of one member per part, and the concatenation of the parts
+///
+struct MultiMember
+{
+  std::vector<std::byte> compressed;
+  std::vector<std::byte> expected;
+  std::vector<std::size_t> member_offsets;
+};
+
+auto compress_members(
+    const std::vector<std::span<const std::byte>>& parts,
+    std::uint8_t level = ::starflate::default_compress_level) -> MultiMember
+{
+  auto file = MultiMember{};
+  for (const auto part : parts) {
+    file.member_offsets.push_back(file.compressed.size());
+    const auto member = compress_gzip(part, level);
+    file.compressed.insert(file.compressed.end(), member.begin(), member.end());
+    file.expected.insert(file.expected.end(), part.begin(), part.end());
+  }
+  return file;
+}
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::fatal;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  const auto text = read_runfile(*argv, "starflate/src/test/starfleet.html");
+  const auto data = std::span{text};
+  // enough blocks for an index of several checkpoints
+  auto repeated = std::vector<std::byte>{};
+  for (auto i = 0; i != 4; ++i) {
+    repeated.insert(repeated.end(), text.begin(), text.end());
+  }
+  const auto large = std::span<const std::byte>{repeated};
+
+  test("decompress_gzip_parallel decompresses every member") = [data] {
+    const auto file = compress_members(
+        {data,
+         data.first(1000),
+         {},
+         data.subspan(5000),
+         data.first(1),
+         data.subspan(100, 70'000)});
+    for (const auto threads : {1UZ, 2UZ, 3UZ, 8UZ, 0UZ}) {
+      auto dst = std::vector<std::byte>(file.expected.size());
+      const auto result =
+          decompress_gzip_parallel(file.compressed, dst, {.threads = threads});
+      expect(result.status == DecompressStatus::Success)
+          << "threads " << threads << " got "
+          << static_cast<int>(result.status);
+      expect(eq(file.compressed.size(), result.src_consumed));
+      expect(eq(file.expected.size(), result.dst_written));
+      expect(dst == file.expected) << "threads " << threads;
+    }
+  };
+
+  test("decompress_gzip_parallel single member") = [data] {
+    const auto file = compress_members({data});
+    auto dst = std::vector<std::byte>(data.size());
+    const auto result = decompress_gzip_parallel(file.compressed, dst);
+    expect(result.status == DecompressStatus::Success);
+    expect(dst == file.expected);
+  };
+
+  test("is_gzip_member_start finds member boundaries") = [data] {
+    const auto file =
+        compress_members({data.first(20'000), data.subspan(20'000)});
+    for (const auto offset : file.member_offsets) {
+      expect(detail::is_gzip_member_start(
+          std::span{file.compressed}.subspan(offset)))
+          << "offset " << offset;
+    }
+
+    // a header followed by data that is not a DEFLATE stream
+    auto rng = std::mt19937{};
+    auto noise = std::vector<std::byte>(1000);
+    for (auto& byte : noise) {
+      byte = static_cast<std::byte>(rng());
+    }
+    std::ranges::copy(
+        std::span{file.compressed}.first(10), noise.begin());
+    expect(not detail::is_gzip_member_start(noise));
+    expect(not detail::is_gzip_member_start(noise = {}));
+  };
+
+  test("decompress_gzip_parallel with a member embedded in data") = [data] {
+    // A stored member containing another gzip file. The embedded members
+    // look like member boundaries, but are part of the data.
+    const auto inner = compress_members({data.first(3000), data.first(2000)});
+    auto payload = std::vector<std::byte>(data.begin(), data.begin() + 500);
+    payload.insert(
+        payload.end(), inner.compressed.begin(), inner.compressed.end());
+    payload.insert(payload.end(), data.begin(), data.begin() + 500);
+
+    const auto file =
+        compress_members({data.first(10'000), payload, data.first(7000)}, 0);
+    for (const auto threads : {1UZ, 4UZ}) {
+      auto dst = std::vector<std::byte>(file.expected.size());
+      const auto result =
+          decompress_gzip_parallel(file.compressed, dst, {.threads = threads});
+      expect(result.status == DecompressStatus::Success)
+          << "threads " << threads << " got "
+          << static_cast<int>(result.status);
+      expect(eq(file.compressed.size(), result.src_consumed));
+      expect(dst == file.expected) << "threads " << threads;
+    }
+  };
+
+  test("decompress_gzip_parallel verifies each member") = [data] {
+    auto file = compress_members(
+        {data.first(10'000), data.first(20'000), data.first(30'000)});
+    // corrupt the CRC-32 in the trailer of the second member
+    const auto trailer = file.member_offsets[2] - 8;
+    file.compressed[trailer] ^= std::byte{1};
+
+    auto dst = std::vector<std::byte>(file.expected.size());
+    const auto result = decompress_gzip_parallel(file.compressed, dst);
+    expect(result.status == DecompressStatus::ChecksumMismatch)
+        << "got " << static_cast<int>(result.status);
+    expect(eq(file.member_offsets[1], result.src_consumed));
+    expect(eq(10'000UZ, result.dst_written));
+  };
+
+  test("decompress_gzip_parallel rejects truncated and trailing data") =
+      [data] {
+        auto file = compress_members({data.first(10'000), data.first(20'000)});
+        auto dst = std::vector<std::byte>(file.expected.size());
+
+        const auto truncated =
+            std::span{file.compressed}.first(file.compressed.size() - 1);
+        auto result = decompress_gzip_parallel(truncated, dst);
+        expect(result.status == DecompressStatus::SrcTooSmall)
+            << "got " << static_cast<int>(result.status);
+        expect(eq(file.member_offsets[1], result.src_consumed));
+
+        file.compressed.push_back(std::byte{});
+        result = decompress_gzip_parallel(file.compressed, dst);
+        expect(result.status != DecompressStatus::Success);
+        expect(eq(file.compressed.size() - 1, result.src_consumed));
+        expect(eq(file.expected.size(), result.dst_written));
+
+        expect(
+            decompress_gzip_parallel({}, dst).status ==
+            DecompressStatus::SrcTooSmall);
+      };
+
+  test("decompress_gzip_parallel with a small dst") = [data] {
+    const auto file = compress_members({data.first(10'000), data});
+    for (const auto size : {0UZ, 10'000UZ, file.expected.size() - 1}) {
+      auto dst = std::vector<std::byte>(size);
+      expect(
+          decompress_gzip_parallel(file.compressed, dst).status ==
+          DecompressStatus::DstTooSmall)
+          << "size " << size;
+    }
+  };
+
+  test("decompress_parallel matches decompress") = [data] {
+    for (const auto level : {0, 1, 6, 9}) {
+      const auto compressed =
+          compress_raw(data, static_cast<std::uint8_t>(level));
+      for (const auto chunk_size : {0UZ, 16'384UZ, 1UZ << 20U}) {
+        for (const auto threads : {1UZ, 2UZ, 4UZ}) {
+          auto dst = std::vector<std::byte>(data.size());
+          const auto result = decompress_parallel(
+              compressed,
+              dst,
+              {.threads = threads, .chunk_size = chunk_size});
+          expect(result.status == DecompressStatus::Success)
+              << "level " << level << " chunk " << chunk_size << " threads "
+              << threads << " got " << static_cast<int>(result.status);
+          expect(eq(compressed.size(), result.src_consumed));
+          expect(eq(data.size(), result.dst_written));
+          expect(std::ranges::equal(dst, data))
+              << "level " << level << " chunk " << chunk_size << " threads "
+              << threads;
+        }
+      }
+    }
+  };
+
+  test("decompress_parallel rejects truncated data and a small dst") =
+      [data] {
+        const auto compressed = compress_raw(data, default_compress_level);
+        auto dst = std::vector<std::byte>(data.size());
+        const auto options = ParallelDecompressOptions{.threads = 4};
+
+        const auto truncated =
+            std::span{compressed}.first(compressed.size() / 2);
+        auto result = decompress_parallel(truncated, dst, options);
+        expect(result.status != DecompressStatus::Success);
+        expect(eq(0UZ, result.src_consumed));
+
+        dst.resize(data.size() - 1);
+        result = decompress_parallel(compressed, dst, options);
+        expect(result.status == DecompressStatus::DstTooSmall)
+            << "got " << static_cast<int>(result.status);
+      };
+
+  test("decompress_parallel with chunks that expand past the limit") = [data] {
+    // runs of a few distinct lines compress far more than the text
+    auto lines = std::vector<std::byte>{};
+    for (auto i = 0UZ; lines.size() < 1'000'000; ++i) {
+      const auto line = data.subspan((i % 7) * 80, 80);
+      for (auto repeat = 0UZ; repeat != 1 + (i % 13); ++repeat) {
+        lines.insert(lines.end(), line.begin(), line.end());
+      }
+    }
+    const auto compressed = compress_raw(lines, default_compress_level);
+    expect(fatal(compressed.size() * 8 < lines.size()));
+
+    auto dst = std::vector<std::byte>(lines.size());
+    const auto result = decompress_parallel(
+        compressed,
+        dst,
+        {.threads = 4, .chunk_size = min_speculative_chunk_size});
+    expect(result.status == DecompressStatus::Success)
+        << "got " << static_cast<int>(result.status);
+    expect(eq(compressed.size(), result.src_consumed));
+    expect(dst == lines);
+  };
+
+  test("decompress_parallel does not read past corrupted input") = [data] {
+    auto compressed = compress_raw(data, default_compress_level);
+    auto file = compress_members({data});
+    auto dst = std::vector<std::byte>(data.size());
+    const auto options = ParallelDecompressOptions{
+        .threads = 4,
+        .speculative = true,
+        .chunk_size = min_speculative_chunk_size};
+
+    // Copies `src` into a buffer of exactly its size, so that any read past
+    // the end of the input is out of bounds.
+    const auto exact_copy = [](std::span<const std::byte> src) {
+      auto buffer = std::make_unique<std::byte[]>(src.size());
+      std::ranges::copy(src, buffer.get());
+      return buffer;
+    };
+
+    for (auto cut = 1UZ; cut != 2 * CHAR_BIT; ++cut) {
+      const auto size = compressed.size() - cut;
+      const auto buffer = exact_copy(std::span{compressed}.first(size));
+      const auto src = std::span<const std::byte>{buffer.get(), size};
+      expect(
+          detail::find_dynamic_block(
+              src, (size - 1) * CHAR_BIT, size * CHAR_BIT) == std::nullopt)
+          << "cut " << cut;
+      const auto result = decompress_parallel(src, dst, options);
+      expect(result.status != DecompressStatus::Success) << "cut " << cut;
+    }
+
+    // flip each bit near the end of a stream and of a gzip member
+    auto rng = std::mt19937{};
+    for (auto i = 0UZ; i != 2 * CHAR_BIT * CHAR_BIT; ++i) {
+      auto& stream = (i % 2 == 0) ? compressed : file.compressed;
+      const auto byte = stream.size() - 1 - (i / (2 * CHAR_BIT));
+      const auto mask = std::byte{1} << (rng() % CHAR_BIT);
+      stream[byte] ^= mask;
+      const auto buffer = exact_copy(stream);
+      const auto src = std::span<const std::byte>{buffer.get(), stream.size()};
+      const auto result = (i % 2 == 0)
+                              ? decompress_parallel(src, dst, options)
+                              : decompress_gzip_parallel(src, dst, options);
+      expect(result.dst_written <= dst.size()) << "byte " << byte;
+      stream[byte] ^= mask;
+    }
+  };
+
+  test("speculative symbols resolve to the output") = [data] {
+    const auto compressed = compress_raw(data, default_compress_level);
+    const auto src_bits = compressed.size() * CHAR_BIT;
+    const auto found =
+        detail::find_dynamic_block(compressed, src_bits / 2, src_bits);
+    expect(fatal(found.has_value()));
+    expect(eq(
+        std::optional<std::size_t>{0},
+        detail::find_dynamic_block(compressed, 0, CHAR_BIT)));
+
+    // the blocks before the candidate, decompressed from the start
+    auto before = std::vector<detail::Symbol>{};
+    const auto head = detail::inflate_symbols(
+        compressed, 0, *found, 0, data.size(), before);
+    expect(fatal(head.status == DecompressStatus::Success));
+    expect(eq(*found, head.end_bit));
+    expect(not head.final);
+    const auto head_size = before.size() - window_size;
+    expect(detail::markers_within(
+        std::span{before}.subspan(window_size), 0));
+
+    // the blocks after it, decompressed without the window
+    auto after = std::vector<detail::Symbol>{};
+    const auto tail = detail::inflate_symbols(
+        compressed,
+        *found,
+        src_bits,
+        window_size,
+        data.size(),
+        after);
+    expect(fatal(tail.status == DecompressStatus::Success));
+    expect(tail.final);
+    expect(eq(data.size() - head_size, after.size() - window_size));
+
+    auto dst = std::vector<std::byte>(data.size());
+    detail::resolve_symbols(
+        std::span{before}.subspan(window_size),
+        {},
+        std::span{dst}.first(head_size));
+    detail::resolve_symbols(
+        std::span{after}.subspan(window_size),
+        std::span{dst}.first(head_size),
+        std::span{dst}.subspan(head_size));
+    expect(std::ranges::equal(dst, data));
+  };
+
+  test("inflate_symbols keeps complete blocks when the output is limited") =
+      [data] {
+        const auto compressed = compress_raw(data, default_compress_level);
+        const auto src_bits = compressed.size() * CHAR_BIT;
+
+        // the first block alone
+        auto first = std::vector<detail::Symbol>{};
+        const auto block =
+            detail::inflate_symbols(compressed, 0, 1, 0, data.size(), first);
+        expect(fatal(block.status == DecompressStatus::Success));
+        expect(fatal(not block.final));
+
+        auto limited = std::vector<detail::Symbol>{};
+        const auto result = detail::inflate_symbols(
+            compressed, 0, src_bits, 0, first.size() - window_size, limited);
+        expect(result.status == DecompressStatus::DstTooSmall)
+            << "got " << static_cast<int>(result.status);
+        expect(eq(block.end_bit, result.end_bit));
+        expect(not result.final);
+        expect(limited == first);
+      };
+
+  test("decompress_gzip_parallel decompresses a member speculatively") =
+      [data] {
+        auto file = compress_members({data});
+        const auto options = ParallelDecompressOptions{
+            .threads = 4, .speculative = true, .chunk_size = 16'384};
+        auto dst = std::vector<std::byte>(data.size());
+        auto result = decompress_gzip_parallel(file.compressed, dst, options);
+        expect(result.status == DecompressStatus::Success)
+            << "got " << static_cast<int>(result.status);
+        expect(eq(file.compressed.size(), result.src_consumed));
+        expect(dst == file.expected);
+
+        // corrupt the CRC-32 in the trailer
+        file.compressed[file.compressed.size() - 8] ^= std::byte{1};
+        result = decompress_gzip_parallel(file.compressed, dst, options);
+        expect(result.status == DecompressStatus::ChecksumMismatch)
+            << "got " << static_cast<int>(result.status);
+      };
+
+  test("decompress_parallel with an index matches decompress") = [large] {
+    for (const auto level : {0, 1, 6}) {
+      const auto compressed =
+          compress_raw(large, static_cast<std::uint8_t>(level));
+      for (const auto spacing : {0UZ, 16'384UZ, 1UZ << 20U}) {
+        const auto index = build_index(compressed, spacing);
+        expect(fatal(index.has_value()));
+        for (const auto threads : {1UZ, 4UZ, 0UZ}) {
+          auto dst = std::vector<std::byte>(large.size());
+          const auto result = decompress_parallel(
+              compressed, *index, dst, {.threads = threads});
+          expect(result.status == DecompressStatus::Success)
+              << "level " << level << " spacing " << spacing << " threads "
+              << threads << " got " << static_cast<int>(result.status);
+          expect(eq(compressed.size(), result.src_consumed));
+          expect(eq(large.size(), result.dst_written));
+          expect(std::ranges::equal(dst, large))
+              << "level " << level << " spacing " << spacing << " threads "
+              << threads;
+        }
+      }
+    }
+  };
+
+  test("decompress_parallel rejects an index of another stream") = [large] {
+    const auto compressed = compress_raw(large, default_compress_level);
+    const auto index = build_index(compressed, 16'384);
+    expect(fatal(index.has_value() and index->checkpoints.size() > 3));
+    auto dst = std::vector<std::byte>(large.size());
+
+    // a window that differs from the output preceding its checkpoint
+    auto modified = *index;
+    auto& checkpoint = modified.checkpoints[2];
+    checkpoint.window.back() ^= std::byte{1};
+    auto result = decompress_parallel(compressed, modified, dst);
+    expect(result.status == DecompressStatus::InvalidIndex)
+        << "got " << static_cast<int>(result.status);
+    expect(eq(checkpoint.dst_offset, result.dst_written));
+    expect(eq(0UZ, result.src_consumed));
+
+    // a checkpoint that is not a block boundary
+    modified = *index;
+    ++modified.checkpoints[2].src_bit;
+    result = decompress_parallel(compressed, modified, dst);
+    expect(result.status != DecompressStatus::Success);
+
+    // the same size of output from different input
+    const auto other = compress_raw(large, 1);
+    result = decompress_parallel(other, *index, dst);
+    expect(result.status != DecompressStatus::Success);
+
+    modified = *index;
+    modified.checkpoints.clear();
+    expect(
+        decompress_parallel(compressed, modified, dst).status ==
+        DecompressStatus::InvalidIndex);
+    expect(
+        decompress_parallel(
+            std::span{compressed}.first(compressed.size() - 1), *index, dst)
+            .status == DecompressStatus::SrcTooSmall);
+    expect(
+        decompress_parallel(
+            compressed, *index, std::span{dst}.first(large.size() - 1))
+            .status == DecompressStatus::DstTooSmall);
+  };
+}
@@ -0,0 +1,58 @@
+#include "src/test/test_util.hpp"
+
+#include "src/compress.hpp"
+#include "tools/cpp/runfiles/runfiles.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+
+namespace starflate::test {
+
+auto read_runfile(const char* argv0, const std::string& path)
+    -> std::vector<std::byte>
+{
+  using ::bazel::tools::cpp::runfiles::Runfiles;
+  std::string error;
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv0, &error));
+  if (runfiles == nullptr) {
+    std::cerr << "failed to create runfiles: " << error << '\n';
+    std::exit(EXIT_FAILURE);
+  }
+
+  const std::string abs_path{runfiles->Rlocation(path)};
+
+  std::ifstream file{abs_path, std::ios::binary};
+  if (not file.is_open()) {
+    std::cerr << "failed to open file: " << abs_path << '\n';
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::vector<char> chars(
+      (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+  return {
+      reinterpret_cast<std::byte*>(chars.data()),
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      reinterpret_cast<std::byte*>(chars.data() + chars.size())};
+  // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+}
+
+auto compress_raw(std::span<const std::byte> src, std::uint8_t level)
+    -> std::vector<std::byte>
+{
+  auto dst = std::vector<std::byte>(compress_bound(src.size()));
+  const auto result = compress(src, dst, level);
+  if (result.status != CompressStatus::Success) {
+    std::cerr << "failed to compress, got status: "
+              << static_cast<int>(result.status) << '\n';
+    std::exit(EXIT_FAILURE);
+  }
+  dst.resize(result.dst_written);
+  return dst;
+}
+
+}  // namespace starflate::test
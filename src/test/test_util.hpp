@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace starflate::test {
+
+/// Returns the contents of a data file of a test or benchmark
+///
+/// Exits with a failure status if the file cannot be read, since nothing can
+/// be tested without it.
+///
+/// @param argv0 The path of the executable, `argv[0]`.
+/// @param path The path of the file in the runfiles, e.g.
+///     "starflate/src/test/starfleet.html".
+///
+auto read_runfile(const char* argv0, const std::string& path)
+    -> std::vector<std::byte>;
+
+/// Returns `src` compressed into a DEFLATE stream with `compress`
+///
+/// Exits with a failure status if compression fails.
+///
+auto compress_raw(std::span<const std::byte> src, std::uint8_t level)
+    -> std::vector<std::byte>;
+
+}  // namespace starflate::test
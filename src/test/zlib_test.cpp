@@ -0,0 +1,120 @@
+#include "huffman/src/utility.hpp"
+#include "src/test/test_util.hpp"
+#include "src/zlib.hpp"
+
+#include <boost/ut.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using ::starflate::test::read_runfile;
+
+auto as_bytes(std::string_view str) -> std::vector<std::byte>
+{
+  auto bytes = std::vector<std::byte>{};
+  std::ranges::transform(str, std::back_inserter(bytes), [](char c) {
+    return static_cast<std::byte>(c);
+  });
+  return bytes;
+}
+
+}  // namespace
+
+auto main(int, char* argv[]) -> int
+{
+  using ::boost::ut::eq;
+  using ::boost::ut::expect;
+  using ::boost::ut::test;
+  using namespace starflate;
+
+  test("read_zlib_header") = [] {
+    // 32 KiB window, default level, no dictionary
+    const auto header = read_zlib_header(huffman::byte_array(0x78, 0x9C));
+    expect(header.has_value())
+        << "got error: " << static_cast<int>(header.error());
+    expect(eq(15U, unsigned{header->window_bits}));
+    expect(eq(2U, unsigned{header->level}));
+    expect(not header->dictionary_id.has_value());
+    expect(eq(2UZ, header->size));
+
+    const auto with_dictionary = read_zlib_header(
+        huffman::byte_array(0x78, 0xF9, 0x26, 0x75, 0x0F, 0x08));
+    expect(with_dictionary.has_value());
+    expect(eq(0x2675'0F08U, with_dictionary->dictionary_id.value_or(0)));
+    expect(eq(6UZ, with_dictionary->size));
+
+    expect(
+        read_zlib_header(huffman::byte_array(0x78, 0xF9, 0x26)).error() ==
+        DecompressStatus::SrcTooSmall);
+  };
+
+  test("read_zlib_header rejects invalid headers") = [] {
+    for (const auto& bytes : {
+             huffman::byte_array(0x78, 0x9D),  // FCHECK
+             huffman::byte_array(0x79, 0xDA),  // CM
+             huffman::byte_array(0x88, 0x98),  // CINFO
+         }) {
+      const auto header = read_zlib_header(bytes);
+      expect(not header.has_value() and
+             header.error() == DecompressStatus::InvalidZlibHeader);
+    }
+  };
+
+  test("decompress_zlib") = [argv] {
+    auto src = read_runfile(*argv, "starflate/src/test/starfleet.html.zlib");
+    const auto expected =
+        read_runfile(*argv, "starflate/src/test/starfleet.html");
+    const auto size = src.size();
+    src.push_back(std::byte{0xAA});
+
+    auto dst = std::vector<std::byte>(expected.size());
+    const auto result = decompress_zlib(src, dst);
+    expect(result.status == DecompressStatus::Success)
+        << "got error code: " << static_cast<int>(result.status);
+    expect(eq(size, result.src_consumed));
+    expect(eq(expected.size(), result.dst_written));
+    expect(std::ranges::equal(dst, expected));
+
+    auto bad_checksum = src;
+    bad_checksum[size - 1] ^= std::byte{1};
+    expect(
+        decompress_zlib(bad_checksum, dst).status ==
+        DecompressStatus::ChecksumMismatch);
+
+    expect(
+        decompress_zlib(std::span{src}.first(size - 1), dst).status ==
+        DecompressStatus::SrcTooSmall);
+  };
+
+  test("decompress_zlib with a preset dictionary") = [] {
+    const auto dictionary = as_bytes("starflate decompresses deflate streams");
+    const auto expected =
+        as_bytes("deflate streams: starflate decompresses them");
+    // compressed with the dictionary, mostly into back-references to it
+    // clang-format off
+    constexpr auto src = huffman::byte_array(
+        0x78, 0xF9, 0x26, 0x75, 0x0F, 0x08, 0x43, 0xE3, 0x5A, 0x01, 0x19, 0x58,
+        0xB5, 0x95, 0x64, 0xA4, 0xE6, 0x02, 0x00, 0x7D, 0x9F, 0x11, 0x10);
+    // clang-format on
+
+    auto dst = std::vector<std::byte>(expected.size());
+    const auto result = decompress_zlib(src, dst, dictionary);
+    expect(result.status == DecompressStatus::Success)
+        << "got error code: " << static_cast<int>(result.status);
+    expect(eq(src.size(), result.src_consumed));
+    expect(std::ranges::equal(dst, expected));
+
+    expect(
+        decompress_zlib(src, dst).status ==
+        DecompressStatus::DictionaryMismatch);
+    expect(
+        decompress_zlib(src, dst, std::span{dictionary}.first(10)).status ==
+        DecompressStatus::DictionaryMismatch);
+  };
+}
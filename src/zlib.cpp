@@ -0,0 +1,128 @@
+#include "zlib.hpp"
+
+#include "src/checksum.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+namespace starflate {
+namespace {
+
+constexpr std::uint8_t zlib_cm_deflate = 8;
+constexpr std::uint8_t zlib_min_window_bits = 8;
+constexpr std::uint8_t zlib_fdict = 1U << 5U;
+// (CMF * 256 + FLG) is a multiple of this
+constexpr unsigned zlib_fcheck_divisor = 31;
+
+constexpr std::size_t zlib_fixed_header_size = 2;
+constexpr std::size_t zlib_dictid_size = 4;
+// ADLER32
+constexpr std::size_t zlib_trailer_size = 4;
+
+/// Reads a big-endian 32-bit integer from the start of `bytes`
+///
+auto load_be32(std::span<const std::byte> bytes) -> std::uint32_t
+{
+  assert(bytes.size() >= sizeof(std::uint32_t));
+  auto value = std::uint32_t{};
+  for (auto i = 0UZ; i != sizeof(std::uint32_t); ++i) {
+    value = (value << CHAR_BIT) | std::to_integer<std::uint32_t>(bytes[i]);
+  }
+  return value;
+}
+
+}  // namespace
+
+auto read_zlib_header(std::span<const std::byte> src)
+    -> std::expected<ZlibHeader, DecompressStatus>
+{
+  constexpr auto kNibbleBits = 4U;
+  constexpr auto kNibbleMask = 0xFU;
+  constexpr auto kLevelShift = 6U;
+
+  if (src.size() < zlib_fixed_header_size) {
+    return std::unexpected{DecompressStatus::SrcTooSmall};
+  }
+  const auto cmf = std::to_integer<unsigned>(src[0]);
+  const auto flg = std::to_integer<unsigned>(src[1]);
+  const auto window_bits = (cmf >> kNibbleBits) + zlib_min_window_bits;
+  if ((cmf & kNibbleMask) != zlib_cm_deflate or
+      (std::size_t{1} << window_bits) > window_size or
+      ((cmf << CHAR_BIT) | flg) % zlib_fcheck_divisor != 0) {
+    return std::unexpected{DecompressStatus::InvalidZlibHeader};
+  }
+
+  auto header = ZlibHeader{
+      .window_bits = static_cast<std::uint8_t>(window_bits),
+      .level = static_cast<std::uint8_t>(flg >> kLevelShift),
+      .dictionary_id = std::nullopt,
+      .size = zlib_fixed_header_size};
+  if ((flg & zlib_fdict) != 0) {
+    if (src.size() < zlib_fixed_header_size + zlib_dictid_size) {
+      return std::unexpected{DecompressStatus::SrcTooSmall};
+    }
+    header.dictionary_id = load_be32(src.subspan(zlib_fixed_header_size));
+    header.size += zlib_dictid_size;
+  }
+  return header;
+}
+
+auto decompress_zlib(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    std::span<const std::byte> dictionary) -> DecompressResult
+{
+  const auto header = read_zlib_header(src);
+  if (not header) {
+    return {.status = header.error(), .src_consumed = 0, .dst_written = 0};
+  }
+  if (not header->dictionary_id) {
+    dictionary = {};
+  } else if (adler32(dictionary) != *header->dictionary_id) {
+    return {
+        .status = DecompressStatus::DictionaryMismatch,
+        .src_consumed = 0,
+        .dst_written = 0};
+  }
+
+  const auto compressed = src.subspan(header->size);
+  auto state = detail::InflateState{
+      .src_bits = huffman::bit_reader{huffman::bit_span{compressed}}};
+  // back-references may refer to the end of the preset dictionary
+  auto output = detail::InflateOutput{
+      .dst = dst,
+      .history = dictionary.last(std::min(dictionary.size(), window_size))};
+
+  auto adler = adler32({});
+  const auto status = detail::inflate_in_parts(
+      state, output, [&adler](std::span<const std::byte> part) {
+        adler = adler32(part, adler);
+      });
+  if (status != DecompressStatus::Success) {
+    return {.status = status, .src_consumed = 0, .dst_written = output.written};
+  }
+
+  // the trailer starts at the byte following the compressed data
+  state.src_bits.unbuffer();
+  const auto trailer_offset =
+      static_cast<std::size_t>(state.src_bits.next_byte() - src.data());
+  if (src.size() - trailer_offset < zlib_trailer_size) {
+    return {
+        .status = DecompressStatus::SrcTooSmall,
+        .src_consumed = 0,
+        .dst_written = output.written};
+  }
+  if (load_be32(src.subspan(trailer_offset)) != adler) {
+    return {
+        .status = DecompressStatus::ChecksumMismatch,
+        .src_consumed = 0,
+        .dst_written = output.written};
+  }
+  return {
+      .status = DecompressStatus::Success,
+      .src_consumed = trailer_offset + zlib_trailer_size,
+      .dst_written = output.written};
+}
+
+}  // namespace starflate
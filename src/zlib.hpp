@@ -0,0 +1,64 @@
+#pragma once
+
+#include "src/decompress.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+
+namespace starflate {
+
+/// Header of a zlib stream, RFC 1950 2.2
+///
+struct ZlibHeader
+{
+  /// Base-2 logarithm of the window size used by the compressor, 8 to 15
+  std::uint8_t window_bits;
+  /// FLEVEL, the compression level used by the compressor
+  std::uint8_t level;
+  /// DICTID, the Adler-32 of the preset dictionary, if one is used
+  std::optional<std::uint32_t> dictionary_id;
+  /// Number of bytes in the header, i.e. the offset of the compressed data
+  std::size_t size;
+};
+
+/// Reads the header of a zlib stream
+///
+/// @param src The stream, starting with its first byte.
+/// @return The header, or a status of:
+///     * `SrcTooSmall` if `src` ends before the end of the header.
+///     * `InvalidZlibHeader` if the header does not specify DEFLATE with a
+///       window of at most `window_size` bytes, or its check bits are wrong.
+///
+auto read_zlib_header(std::span<const std::byte> src)
+    -> std::expected<ZlibHeader, DecompressStatus>;
+
+/// Decompresses a zlib stream, RFC 1950
+///
+/// The Adler-32 of the output is verified against the trailer of the stream.
+/// The output is checksummed while it is decompressed, a part at a time while
+/// that part is still in cache, instead of in a separate pass.
+///
+/// @param src The stream, starting with its first byte. Bytes following the
+///     stream are not read.
+/// @param dst The destination buffer. Bytes following the decompressed data
+///     may be overwritten.
+/// @param dictionary The preset dictionary, if the stream was compressed with
+///     one. Ignored otherwise.
+/// @return The size of the stream and the number of bytes written to `dst`,
+///     with a status of:
+///     * `Success` if the stream was decompressed and verified.
+///     * `DictionaryMismatch` if the stream requires a preset dictionary and
+///       `dictionary` does not match its DICTID.
+///     * `ChecksumMismatch` if the output does not match the trailer.
+///     * another status as for `read_zlib_header` and `decompress`.
+///     `src_consumed` is zero unless the status is `Success`.
+///
+auto decompress_zlib(
+    std::span<const std::byte> src,
+    std::span<std::byte> dst,
+    std::span<const std::byte> dictionary = {}) -> DecompressResult;
+
+}  // namespace starflate
@@ -5,7 +5,8 @@ Compresses a DEFLATE compressed file with a fixed or dynamic Huffman tree.
 def compressed_file(
         name,
         src,
-        strategy = "fixed"):
+        strategy = "fixed",
+        format = "raw"):
     """
     Compresses a file with the DEFLATE algorithm and a fixed or dynamic Huffman tree.
 
@@ -19,9 +20,16 @@ def compressed_file(
 
         Determines if compression should use a fixed Huffman tree or a dynamic
         Huffman tree.
+      format: string
+        one of [`raw`, `gzip`, `zlib`].
+
+        Determines if the DEFLATE compressed data is written as is, wrapped in
+        a gzip member or wrapped in a zlib stream.
     """
     if strategy not in ["fixed", "dynamic"]:
         fail()
+    if format not in ["raw", "gzip", "zlib"]:
+        fail()
 
     tools = ["//tools:deflate_compress"]
 
@@ -30,8 +38,9 @@ def compressed_file(
         srcs = [src],
         outs = [name],
         tools = tools,
-        cmd = "$(execpath {tool}) --src $< {strat} > $@".format(
+        cmd = "$(execpath {tool}) --src $< {strat} --format {format} > $@".format(
             tool = tools[0],
             strat = "--fixed" if strategy == "fixed" else "",
+            format = format,
         ),
     )
@@ -6,11 +6,15 @@ import zlib
 
 def main(args):
     strategy = zlib.Z_FIXED if args.fixed else zlib.Z_DEFAULT_STRATEGY
-    compression = zlib.compressobj(
+    wbits = {
         # negative means no header or trailing checksum.
         # basically raw DEFLATE instead of zlib format.
-        wbits=-zlib.MAX_WBITS,
-        strategy=strategy)
+        "raw": -zlib.MAX_WBITS,
+        # adding 16 means a gzip header and trailer.
+        "gzip": 16 + zlib.MAX_WBITS,
+        "zlib": zlib.MAX_WBITS,
+    }[args.format]
+    compression = zlib.compressobj(wbits=wbits, strategy=strategy)
     with open(args.src, "rb") as src:
         data = src.read()
     compressed = compression.compress(data)
@@ -25,6 +29,12 @@ parser = argparse.ArgumentParser(
 
 parser.add_argument("--src", help="path to input file", required=True)
 parser.add_argument("--fixed", help="use fixed strategy", action="store_true")
+parser.add_argument(
+    "--format",
+    help="container format of the output",
+    choices=["raw", "gzip", "zlib"],
+    default="raw",
+)
 
 if __name__ == "__main__":
     main(parser.parse_args())
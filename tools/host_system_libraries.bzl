@@ -5,7 +5,12 @@ Repository rule used to determine if a library is installed in the host system.
 def _host_system_libraries_impl(rctx):
     rctx.file("BUILD.bazel", executable = False)
 
-    system_libs = rctx.execute(["ldconfig", "-p"]).stdout
+    # `ldconfig -p` lists a library per line, as `<name> (<flags>) => <path>`,
+    # after a summary line
+    system_libs = [
+        line.strip().split(" ")[0]
+        for line in rctx.execute(["ldconfig", "-p"]).stdout.splitlines()[1:]
+    ]
 
     found = [
         '"' + lib + '"'
@@ -25,8 +30,9 @@ host_system_libraries = repository_rule(
         "find": attr.string_list(
             mandatory = True,
             doc = """
-            List of libraries to detect. Each library is added to `HOST_SYSTEM_LIBRARIES`
-            if found.
+            List of libraries to detect, by file name. Each library is added to
+            `HOST_SYSTEM_LIBRARIES` if found. Unversioned names, e.g. `libz.so`,
+            are usually only installed with the library's development files.
             """,
         ),
     },